@@ -113,6 +113,42 @@ GLuint TextureManager::LoadFromFile(const char* pFilePath, bool bFlipVertically)
 	return textureId;
 }
 
+Task<GLuint> TextureManager::LoadFromFileAsync(IoLane& ioLane, std::string filePath, bool bFlipVertically, TaskPriority priority)
+{
+	IoReadResult file = co_await ioLane.ReadFileAsync(filePath, priority);
+	if(!file.IsOk())
+	{
+		LOG_ERROR("LoadFromFileAsync: couldn't read '%s'", filePath.c_str());
+		co_return 0;
+	}
+
+	// Resumed on a pool worker, decode here
+	stbi_set_flip_vertically_on_load_thread(bFlipVertically);
+
+	i32 width, height, channels;
+	u8* pData = stbi_load_from_memory(file.data.data(), (i32)file.data.size(), &width, &height, &channels, 0);
+	if(!pData)
+	{
+		LOG_ERROR("LoadFromFileAsync: failed for '%s': %s", filePath.c_str(), stbi_failure_reason());
+		co_return 0;
+	}
+
+	// GL context lives on the main thread
+	co_await SwitchToMainThread(ioLane.GetThreadPool());
+
+	GLuint textureId = CreateTexture(pData, static_cast<u32>(width), static_cast<u32>(height), static_cast<u8>(channels));
+
+	stbi_image_free(pData);
+
+	if(textureId != 0)
+	{
+		m_pTextures[textureId].m_filePath = filePath;
+		LOG_INFO("Successfully loaded texture '%d' from '%s'", textureId, filePath.c_str());
+	}
+
+	co_return textureId;
+}
+
 Spritesheet TextureManager::LoadSpritesheet(const char* pFilePath, u32 tileWidth, u32 tileHeight, bool bFlipVertically)
 {
 	GLuint textureId = LoadFromFile(pFilePath, bFlipVertically);
@@ -124,6 +160,19 @@ Spritesheet TextureManager::LoadSpritesheet(const char* pFilePath, u32 tileWidth
 	return CreateSpritesheet(textureId, tileWidth, tileHeight);
 }
 
+Task<Spritesheet> TextureManager::LoadSpritesheetAsync(IoLane& ioLane, std::string filePath, u32 tileWidth, u32 tileHeight,
+	bool bFlipVertically, TaskPriority priority)
+{
+	// Resumes on the main thread, right after the upload
+	GLuint textureId = co_await LoadFromFileAsync(ioLane, filePath, bFlipVertically, priority);
+	if (textureId == 0)
+	{
+		LOG_ERROR("Failed to load texture for spritesheet: '%s'", filePath.c_str());
+		co_return Spritesheet{};
+	}
+	co_return CreateSpritesheet(textureId, tileWidth, tileHeight);
+}
+
 Spritesheet TextureManager::CreateSpritesheet(GLuint textureId, u32 tileWidth, u32 tileHeight)
 {
 	if (!IsValidTexture(textureId))
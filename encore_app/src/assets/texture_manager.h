@@ -9,6 +9,8 @@
 #include <string>
 
 #include "sprite_sheet.h"
+#include "tasks/io_lane.h"
+#include "tasks/task_coroutine.h"
 
 class TextureManager
 {
@@ -19,9 +21,17 @@ public:
 	GLuint CreateTexture(const u8* pData, u32 width, u32 height, u8 channels);
 	GLuint LoadFromFile(const char* pFilePath, bool bFlipVertically = false);
 
+	// Reads the file on the IO lane, decodes it on a pool worker, then resumes on the main thread lane for the GL upload
+	Task<GLuint> LoadFromFileAsync(IoLane& ioLane, std::string filePath, bool bFlipVertically = false,
+		TaskPriority priority = TaskPriority::Normal);
+
 	// Load spritesheet from file
 	Spritesheet LoadSpritesheet(const char* pFilePath, u32 tileWidth, u32 tileHeight, bool bFlipVertically = false);
 
+	// Same as LoadSpritesheet, without blocking the main thread on the disk or the decode
+	Task<Spritesheet> LoadSpritesheetAsync(IoLane& ioLane, std::string filePath, u32 tileWidth, u32 tileHeight,
+		bool bFlipVertically = false, TaskPriority priority = TaskPriority::Normal);
+
 	// Create spritesheet from existing texture
 	Spritesheet CreateSpritesheet(GLuint textureId, u32 tileWidth, u32 tileHeight);
 
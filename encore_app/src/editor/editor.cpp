@@ -6,19 +6,21 @@
 #include "gfx/rendering_engine.h"
 #include "gfx/types.h"
 #include "profiler/profiler_section.h"
+#include "widgets/flame_graph_widget.h"
 #include "widgets/gpu_stats_widget.h"
 #include "widgets/memory_monitor_widget.h"
 #include "widgets/performance_monitor_mini_widget.h"
 #include "widgets/performance_monitor_widget.h"
 #include "widgets/profiler_widget.h"
 #include "widgets/scene_viewport_widget.h"
+#include "widgets/task_graph_widget.h"
 #include "widgets/texture_manager_widget.h"
 
 #define ADD_WIDGET_WITH_OPTION(T, M, B)		\
 	m_editorWidgets.push_back(new T());		\
 	m_editorWidgets.back()->WithMenu(M, B)
 
-void Editor::Init(GameState* pGameState, RenderingEngine* pRenderingEngine)
+void Editor::Init(GameState* pGameState, RenderingEngine* pRenderingEngine, TaskSchedulerSystem* pTaskScheduler)
 {
 	m_pGameState = pGameState;
 	Assert(m_pGameState);
@@ -31,8 +33,13 @@ void Editor::Init(GameState* pGameState, RenderingEngine* pRenderingEngine)
 
 	ADD_WIDGET_WITH_OPTION(MemoryMonitorWidget, "Windows", &m_pGameState->widgets.bMemoryMonitor);
 	ADD_WIDGET_WITH_OPTION(ProfilerWidget, "Windows", &m_pGameState->widgets.bProfiler);
+	ADD_WIDGET_WITH_OPTION(FlameGraphWidget, "Windows", &m_pGameState->widgets.bFlameGraph);
 	ADD_WIDGET_WITH_OPTION(PerformanceMonitorWidget, "Windows", &m_pGameState->widgets.bPerformanceMonitor);
 
+	Assert(pTaskScheduler);
+	m_editorWidgets.push_back(new TaskGraphWidget(pTaskScheduler));
+	m_editorWidgets.back()->WithMenu("Windows", &m_pGameState->widgets.bTaskGraph);
+
 	m_editorWidgets.push_back(new PerformanceMonitorMiniWidget());
 	m_editorWidgets.push_back(new TextureManagerWidget());
 
@@ -133,6 +140,15 @@ void Editor::RenderEditor()
 			}
 		}
 
+		if(ImGui::BeginMenu("Engine"))
+		{
+			const u32 minDepth = 1;
+			const u32 maxDepth = RenderingEngine::MAX_PIPELINE_DEPTH;
+			ImGui::SliderScalar("Pipeline Depth", ImGuiDataType_U32, &m_pGameState->pipelineDepth, &minDepth, &maxDepth);
+			ImGui::SetItemTooltip("1: simulate then render. 2: simulate frame N+1 while rendering frame N.");
+			ImGui::EndMenu();
+		}
+
 		if(ImGui::BeginMenu("Help"))
 		{
 			ImGui::MenuItem("Toggle In-Game ImGui", nullptr, &m_pGameState->bShowInGameImGui);
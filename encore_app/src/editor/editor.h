@@ -11,12 +11,13 @@
 
 struct GameState;
 class RenderingEngine;
+class TaskSchedulerSystem;
 class EditorWidget;
 
 class Editor
 {
 public:
-	void Init(GameState* pGameState, RenderingEngine* pRenderingEngine);
+	void Init(GameState* pGameState, RenderingEngine* pRenderingEngine, TaskSchedulerSystem* pTaskScheduler);
 	void Shutdown();
 
 	void HandleInput(const SDL_Event& event);
@@ -0,0 +1,387 @@
+#pragma once
+
+#include "core/core_minimal.h"
+
+#include "editor/editor_widget.h"
+
+#include "game_state.h"
+#include "debug/extension_imgui.h"
+#include "imgui/imgui.h"
+#include "profiler/profiler.h"
+#include "profiler/profiler_call_tree.h"
+#include "profiler/profiler_section.h"
+#include "utils/string_factory.h"
+#include "utils/utils_math.h"
+
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Merged call tree of the last frame or the last N history frames, drawn as an icicle graph (root on
+// top, callees below, width = inclusive time) with a tree table of inclusive / exclusive times.
+// Click a bar to zoom into it, right click to go back up.
+class FlameGraphWidget : public EditorWidget
+{
+public:
+	virtual void DrawMenu() override
+	{
+		ImGui::MenuItem("Flame Graph", nullptr, m_pOpenPanel);
+	}
+
+	virtual void Run(GameState& rGameState) override
+	{
+		if(!rGameState.widgets.bFlameGraph)
+		{
+			return;
+		}
+
+		PROFILE_SCOPE("FlameGraph");
+
+		if(ImGui::Begin("Profiler - Flame Graph"))
+		{
+			DrawControls();
+
+			if(!m_options.bPaused)
+			{
+				Refresh();
+			}
+
+			const u32 zoomNode = ResolveZoomPath();
+			DrawBreadcrumbs(zoomNode);
+
+			if(ImGui::CollapsingHeader("Icicle", ImGuiTreeNodeFlags_DefaultOpen))
+			{
+				DrawIcicle(zoomNode);
+			}
+
+			if(ImGui::CollapsingHeader("Call Tree", ImGuiTreeNodeFlags_DefaultOpen))
+			{
+				DrawTreeTable(zoomNode);
+			}
+		}
+		ImGui::End();
+	}
+
+private:
+	static constexpr f32 ROW_HEIGHT = 18.0f;
+	static constexpr f32 MIN_LABEL_WIDTH = 40.0f;
+	static constexpr u32 MAX_DRAW_DEPTH = 64;
+
+	using Node = ProfilerCallTree::Node;
+
+	void DrawControls()
+	{
+		if(ImGui::Button(m_options.bPaused ? "Resume" : "Pause"))
+		{
+			m_options.bPaused = !m_options.bPaused;
+		}
+
+		ImGui::SameLine();
+		m_bDirty |= ImGui::Checkbox("History", &m_options.bUseHistory);
+		if(m_options.bUseHistory)
+		{
+			ImGui::SameLine();
+			ImGui::SetNextItemWidth(80.0f);
+			m_bDirty |= ImGui::DragInt("Frames", &m_options.historyFrames, 1.0f, 1, (i32)Profiler::GetInstance().GetHistorySize());
+		}
+
+		ImGui::SameLine(); m_bDirty |= ImGui::Checkbox("Merge Threads", &m_options.bMergeThreads);
+		ImGui::SameLine(); ImGui::Checkbox("Per Frame", &m_options.bPerFrame);
+
+		ImGui::SameLine();
+		ImGui::TextDisabled("%u frames, %zu nodes", m_tree.numFrames, m_tree.nodes.size() - 1);
+	}
+
+	// Merging a long history every frame would cost more than the frame, it refreshes a few times a second
+	void Refresh()
+	{
+		Profiler& rProfiler = Profiler::GetInstance();
+		const u32 numHistoryFrames = rProfiler.GetNumHistoryFrames();
+
+		if(m_options.bUseHistory && numHistoryFrames > 0)
+		{
+			const u64 newestFrame = rProfiler.GetHistoryFrame(numHistoryFrames - 1).frameIndex;
+			if(!m_bDirty && m_bBuiltFromHistory && newestFrame < m_lastBuiltFrame + HISTORY_REFRESH_FRAMES)
+			{
+				return;
+			}
+
+			const u32 numFrames = utils::Min((u32)utils::Max(1, m_options.historyFrames), numHistoryFrames);
+			m_tree.Clear();
+			for(u32 i = numHistoryFrames - numFrames; i < numHistoryFrames; i++)
+			{
+				m_tree.AddFrame(rProfiler.GetHistoryFrame(i).entries, m_options.bMergeThreads);
+			}
+			m_lastBuiltFrame = newestFrame;
+			m_bBuiltFromHistory = true;
+		}
+		else
+		{
+			m_tree.Clear();
+			m_tree.AddFrame(rProfiler.GetAllThreadsEntries(), m_options.bMergeThreads);
+			m_bBuiltFromHistory = false;
+		}
+
+		m_tree.Finish();
+		m_bDirty = false;
+	}
+
+	f32 ToDisplayMs(u64 ns) const
+	{
+		const f32 ms = NS_TO_MS((f32)ns);
+		return m_options.bPerFrame && m_tree.numFrames > 0 ? ms / (f32)m_tree.numFrames : ms;
+	}
+
+	const char* GetNodeLabel(const Node& node) const
+	{
+		if(node.name)
+		{
+			return node.name;
+		}
+		if(node.parent == ProfilerCallTree::INVALID_NODE)
+		{
+			return "All";
+		}
+		return node.threadIndex == ProfilerCallTree::ALL_THREADS ? "All Threads" : Profiler::GetInstance().GetThreadName(node.threadIndex);
+	}
+
+	// Tree indices change on every rebuild, the zoom is kept as a path of labels
+	u32 ResolveZoomPath()
+	{
+		u32 node = ProfilerCallTree::ROOT_NODE;
+		u64 depth = 0;
+		for(; depth < m_zoomPath.size(); depth++)
+		{
+			u32 match = ProfilerCallTree::INVALID_NODE;
+			for(u32 child = m_tree.GetNode(node).firstChild; child != ProfilerCallTree::INVALID_NODE; child = m_tree.GetNode(child).nextSibling)
+			{
+				if(std::strcmp(GetNodeLabel(m_tree.GetNode(child)), m_zoomPath[depth].c_str()) == 0)
+				{
+					match = child;
+					break;
+				}
+			}
+
+			if(match == ProfilerCallTree::INVALID_NODE)
+			{
+				break;
+			}
+			node = match;
+		}
+
+		m_zoomPath.resize(depth);
+		return node;
+	}
+
+	void ZoomTo(u32 node)
+	{
+		m_zoomPath.clear();
+		for(; node != ProfilerCallTree::ROOT_NODE && node != ProfilerCallTree::INVALID_NODE; node = m_tree.GetNode(node).parent)
+		{
+			m_zoomPath.insert(m_zoomPath.begin(), GetNodeLabel(m_tree.GetNode(node)));
+		}
+	}
+
+	void DrawBreadcrumbs(u32 zoomNode)
+	{
+		if(ImGui::SmallButton("All"))
+		{
+			m_zoomPath.clear();
+		}
+
+		std::vector<u32> path;
+		for(u32 node = zoomNode; node != ProfilerCallTree::ROOT_NODE; node = m_tree.GetNode(node).parent)
+		{
+			path.insert(path.begin(), node);
+		}
+
+		for(u32 node : path)
+		{
+			ImGui::SameLine(); ImGui::TextDisabled(">");
+			ImGui::SameLine();
+			ImGui::PushID((i32)node);
+			if(ImGui::SmallButton(GetNodeLabel(m_tree.GetNode(node))))
+			{
+				ZoomTo(node);
+			}
+			ImGui::PopID();
+		}
+	}
+
+	void DrawIcicle(u32 zoomNode)
+	{
+		const Node& zoom = m_tree.GetNode(zoomNode);
+
+		u32 maxDepth = 0;
+		for(const Node& node : m_tree.nodes)
+		{
+			maxDepth = utils::Max(maxDepth, node.depth);
+		}
+		const u32 numRows = utils::Min(maxDepth - zoom.depth + 1, MAX_DRAW_DEPTH);
+
+		const ImVec2 canvasStart = ImGui::GetCursorScreenPos();
+		const ImVec2 canvasSize(ImGui::GetContentRegionAvail().x, ROW_HEIGHT * (f32)numRows);
+		ImGui::InvisibleButton("##Icicle", ImVec2(canvasSize.x, utils::Max(canvasSize.y, 1.0f)));
+		const bool bCanvasHovered = ImGui::IsItemHovered();
+
+		ImDrawList* pDrawList = ImGui::GetWindowDrawList();
+		pDrawList->AddRectFilled(canvasStart, ImVec2(canvasStart.x + canvasSize.x, canvasStart.y + canvasSize.y), ImGui::WithAlpha(ImGui::PASTEL_LIGHT_BLUE, 40));
+
+		if(zoom.inclusiveNs == 0)
+		{
+			return;
+		}
+
+		m_hoveredNode = ProfilerCallTree::INVALID_NODE;
+		DrawIcicleNode(*pDrawList, zoomNode, zoom.depth, canvasStart.x, canvasSize.x, canvasStart.y, (f32)canvasSize.x / (f32)zoom.inclusiveNs);
+
+		if(bCanvasHovered && m_hoveredNode != ProfilerCallTree::INVALID_NODE)
+		{
+			ShowNodeTooltip(m_tree.GetNode(m_hoveredNode), zoom);
+
+			if(ImGui::IsMouseClicked(ImGuiMouseButton_Left))
+			{
+				ZoomTo(m_hoveredNode);
+			}
+		}
+
+		if(bCanvasHovered && ImGui::IsMouseClicked(ImGuiMouseButton_Right) && zoomNode != ProfilerCallTree::ROOT_NODE)
+		{
+			ZoomTo(zoom.parent);
+		}
+	}
+
+	void DrawIcicleNode(ImDrawList& rDrawList, u32 index, u32 zoomDepth, f32 x, f32 width, f32 top, f32 pixelsPerNs)
+	{
+		const Node& node = m_tree.GetNode(index);
+		const u32 row = node.depth - zoomDepth;
+		if(width < 1.0f || row >= MAX_DRAW_DEPTH)
+		{
+			return;
+		}
+
+		const ImVec2 rectMin(x, top + ROW_HEIGHT * (f32)row);
+		const ImVec2 rectMax(x + width - 1.0f, rectMin.y + ROW_HEIGHT - 1.0f);
+
+		const char* label = GetNodeLabel(node);
+		const ImU32 color = ImGui::GetPastelColor(std::hash<std::string_view>{}(label), 160);
+		rDrawList.AddRectFilled(rectMin, rectMax, color);
+
+		if(width > MIN_LABEL_WIDTH)
+		{
+			rDrawList.PushClipRect(rectMin, rectMax, true);
+			rDrawList.AddText(ImVec2(rectMin.x + 3.0f, rectMin.y + 2.0f), IM_COL32(255, 255, 255, 255), label);
+			rDrawList.PopClipRect();
+		}
+
+		if(ImGui::IsMouseHoveringRect(rectMin, rectMax))
+		{
+			m_hoveredNode = index;
+		}
+
+		f32 childX = x;
+		for(u32 child = node.firstChild; child != ProfilerCallTree::INVALID_NODE; child = m_tree.GetNode(child).nextSibling)
+		{
+			const f32 childWidth = (f32)m_tree.GetNode(child).inclusiveNs * pixelsPerNs;
+			DrawIcicleNode(rDrawList, child, zoomDepth, childX, childWidth, top, pixelsPerNs);
+			childX += childWidth;
+		}
+	}
+
+	void ShowNodeTooltip(const Node& node, const Node& zoom) const
+	{
+		ImGui::BeginTooltip();
+		ImGui::Text("%s", GetNodeLabel(node));
+		if(node.name)
+		{
+			ImGui::Text("Thread: %s", node.threadIndex == ProfilerCallTree::ALL_THREADS ? "All Threads" : Profiler::GetInstance().GetThreadName(node.threadIndex));
+			ImGui::Text("Calls: %llu%s", (unsigned long long)node.calls, m_tree.numFrames > 1 ? StringFactory::TempFormat(" (%.1f / frame)", (f32)node.calls / (f32)m_tree.numFrames) : "");
+		}
+		ImGui::Text("Inclusive: %.3f ms (%.1f%%)", ToDisplayMs(node.inclusiveNs), zoom.inclusiveNs > 0 ? 100.0f * (f32)node.inclusiveNs / (f32)zoom.inclusiveNs : 0.0f);
+		ImGui::Text("Exclusive: %.3f ms", ToDisplayMs(node.exclusiveNs));
+		ImGui::EndTooltip();
+	}
+
+	void DrawTreeTable(u32 zoomNode)
+	{
+		const ImGuiTableFlags flags = ImGuiTableFlags_ScrollY | ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable;
+		if(!ImGui::BeginTable("CALL_TREE", 5, flags, ImVec2(0.0f, 300.0f)))
+		{
+			return;
+		}
+
+		ImGui::TableSetupScrollFreeze(0, 1);
+		ImGui::TableSetupColumn("Section", ImGuiTableColumnFlags_WidthStretch);
+		ImGui::TableSetupColumn("Calls", ImGuiTableColumnFlags_WidthFixed, 60.0f);
+		ImGui::TableSetupColumn("Inclusive", ImGuiTableColumnFlags_WidthFixed, 80.0f);
+		ImGui::TableSetupColumn("Exclusive", ImGuiTableColumnFlags_WidthFixed, 80.0f);
+		ImGui::TableSetupColumn("%", ImGuiTableColumnFlags_WidthFixed, 50.0f);
+		ImGui::TableHeadersRow();
+
+		const Node& zoom = m_tree.GetNode(zoomNode);
+		for(u32 child = zoom.firstChild; child != ProfilerCallTree::INVALID_NODE; child = m_tree.GetNode(child).nextSibling)
+		{
+			DrawTreeRow(child, zoom.inclusiveNs);
+		}
+
+		ImGui::EndTable();
+	}
+
+	void DrawTreeRow(u32 index, u64 totalNs)
+	{
+		const Node& node = m_tree.GetNode(index);
+		const bool bLeaf = node.firstChild == ProfilerCallTree::INVALID_NODE;
+
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+
+		ImGui::PushID((i32)index);
+		ImGuiTreeNodeFlags treeFlags = ImGuiTreeNodeFlags_SpanFullWidth | (node.depth <= 2 ? ImGuiTreeNodeFlags_DefaultOpen : 0);
+		if(bLeaf)
+		{
+			treeFlags |= ImGuiTreeNodeFlags_Leaf | ImGuiTreeNodeFlags_NoTreePushOnOpen;
+		}
+		const bool bOpen = ImGui::TreeNodeEx(GetNodeLabel(node), treeFlags);
+		ImGui::PopID();
+
+		ImGui::TableNextColumn();
+		ImGui::Text("%llu", (unsigned long long)node.calls);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f ms", ToDisplayMs(node.inclusiveNs));
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f ms", ToDisplayMs(node.exclusiveNs));
+		ImGui::TableNextColumn();
+		ImGui::Text("%.1f", totalNs > 0 ? 100.0f * (f32)node.inclusiveNs / (f32)totalNs : 0.0f);
+
+		if(bOpen && !bLeaf)
+		{
+			for(u32 child = node.firstChild; child != ProfilerCallTree::INVALID_NODE; child = m_tree.GetNode(child).nextSibling)
+			{
+				DrawTreeRow(child, totalNs);
+			}
+			ImGui::TreePop();
+		}
+	}
+
+private:
+	static constexpr u64 HISTORY_REFRESH_FRAMES = 15;
+
+	ProfilerCallTree m_tree;
+	std::vector<std::string> m_zoomPath;
+	u32 m_hoveredNode = ProfilerCallTree::INVALID_NODE;
+
+	u64 m_lastBuiltFrame = 0;
+	bool m_bBuiltFromHistory = false;
+	bool m_bDirty = false;
+
+	struct Options
+	{
+		i32 historyFrames = 120;
+		bool bUseHistory = false;
+		bool bMergeThreads = false;
+		bool bPerFrame = true;
+		bool bPaused = false;
+	} m_options;
+};
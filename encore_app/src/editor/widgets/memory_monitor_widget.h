@@ -2,11 +2,9 @@
 
 #include "core/core_minimal.h"
 
-#include "components/move_component.h"
-#include "components/sprite2d_component.h"
 #include "debug/extension_imgui.h"
 #include "editor/editor_widget.h"
-#include "memory/base_pool.h"
+#include "game_state.h"
 #include "profiler/profiler.h"
 #include "utils/string_factory.h"
 
@@ -32,7 +30,7 @@ public:
 					u32 currentTotalUsage = 0;
 					for(int i = 0; i < AT_COUNT; i++)
 					{
-						ArenaStats stats = arena_get_stats(&rGameState.arenas[i]);
+						const ArenaStats& stats = rGameState.memory.arenas[i];
 						totalUsageReserved += stats.totalSize;
 						currentTotalUsage += stats.usedBytes;
 					}
@@ -50,15 +48,15 @@ public:
 				}
 				if(ImGui::CollapsingHeader("Arenas", ImGuiTreeNodeFlags_DefaultOpen))
 				{
-					DrawMemoryStats(rGameState.arenas[AT_GLOBAL], "Global");
-					DrawMemoryStats(rGameState.arenas[AT_COMPONENTS], "Components");
-					DrawMemoryStats(rGameState.arenas[AT_FRAME], "Frame");
+					DrawMemoryStats(rGameState.memory.arenas[AT_GLOBAL], "Global");
+					DrawMemoryStats(rGameState.memory.arenas[AT_COMPONENTS], "Components");
+					DrawMemoryStats(rGameState.memory.arenas[AT_FRAME], "Frame");
 				}
 				if(ImGui::CollapsingHeader("Pools", ImGuiTreeNodeFlags_DefaultOpen))
 				{
-					DrawPoolUsageWidget("Move Component", MoveComponent::GetPool());
-					DrawPoolUsageWidget("Sprite2D Component", Sprite2DComponent::GetPool());
-					DrawPoolUsageWidget("AnimatedSprite Component", AnimatedSpriteComponent::GetPool());
+					DrawPoolUsageWidget("Move Component", rGameState.memory.moveComponents);
+					DrawPoolUsageWidget("Sprite2D Component", rGameState.memory.sprite2DComponents);
+					DrawPoolUsageWidget("AnimatedSprite Component", rGameState.memory.animatedSpriteComponents);
 				}
 			}
 			ImGui::End();
@@ -66,10 +64,8 @@ public:
 	}
 
 private:
-	void DrawMemoryStats(Arena& arena, const char* name)
+	void DrawMemoryStats(const ArenaStats& stats, const char* name)
 	{
-		ArenaStats stats = arena_get_stats(&arena);
-
 		const char* str = StringFactory::TempFormat("%.2f%% ( %.2f MB / %.2f MB )",
 			stats.usageRatio,
 			(f32)BYTES_TO_MB(stats.usedBytes),
@@ -80,18 +76,12 @@ private:
 		ImGui::Text("%s", name);
 	}
 
-	template<typename T>
-	void DrawPoolUsageWidget(const char* pPoolName, Pool<T>* pPool, bool bShowDetails = true)
+	void DrawPoolUsageWidget(const char* pPoolName, const PoolUsage& usage)
 	{
-		u32 capacity = pPool->GetCapacity();
-		u32 activeCount = pPool->GetActiveCount();
-		u32 freeCount = pPool->GetFreeCount();
-		float usagePercent = pPool->GetUsagePercentage();
-
 		const char* str = StringFactory::TempFormat("%.2f%% ( %lu / %lu )",
-			usagePercent, activeCount, capacity);
+			usage.usagePercent, usage.activeCount, usage.capacity);
 
-		ImGui::UsageProgressBar(str, usagePercent, ImVec2(0.0f, 15.0f)); ImGui::SameLine();
+		ImGui::UsageProgressBar(str, usage.usagePercent, ImVec2(0.0f, 15.0f)); ImGui::SameLine();
 		ImGui::Text("%s", pPoolName);
 	}
 };
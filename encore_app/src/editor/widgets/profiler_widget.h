@@ -13,7 +13,9 @@
 #include "utils/utils_time.h"
 
 #include <algorithm>
-#include <thread>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
 
 class ProfilerWidget : public EditorWidget
 {
@@ -33,12 +35,29 @@ public:
 		PROFILE_SCOPE("Profiler");
 
 		m_frameEntries.clear();
+		m_frameCounterSamples.clear();
+		m_frameJobs.clear();
 
 		if(ImGui::Begin("Profiler"))
 		{
-			if(m_options.bPaused)
+			const ProfilerFrame* pSelectedFrame = m_history.bHasSelection ? Profiler::GetInstance().FindHistoryFrame(m_history.selectedFrame) : nullptr;
+			m_history.bHasSelection = pSelectedFrame != nullptr;
+
+			if(pSelectedFrame)
+			{
+				m_frameEntries = pSelectedFrame->entries;
+				m_frameCounterSamples = pSelectedFrame->counterSamples;
+				m_frameJobs = pSelectedFrame->jobs;
+				if(!m_options.bShowAllThreads && m_options.bHasSelectedThread)
+				{
+					std::erase_if(m_frameEntries, [this](const ProfilerEntry& entry) { return entry.threadIndex != selectedThreadIndex; });
+				}
+			}
+			else if(m_options.bPaused)
 			{
 				m_frameEntries = frozenEntries;
+				m_frameCounterSamples = frozenCounterSamples;
+				m_frameJobs = frozenJobs;
 			}
 			else if(m_options.bShowAllThreads)
 			{
@@ -46,23 +65,33 @@ public:
 			}
 			else if(m_options.bHasSelectedThread)
 			{
-				m_frameEntries = Profiler::GetInstance().GetThreadEntries(selectedThreadId);
+				m_frameEntries = Profiler::GetInstance().GetThreadEntries(selectedThreadIndex);
 			}
 			else
 			{
 				m_frameEntries = Profiler::GetInstance().GetCurrentThreadEntries();
 			}
 
+			if(!pSelectedFrame && !m_options.bPaused)
+			{
+				m_frameCounterSamples = Profiler::GetInstance().GetAllThreadsCounterSamples();
+				m_frameJobs = Profiler::GetInstance().GetAllThreadsJobs();
+			}
+
 			// If we're transitioning to paused, capture the current frame
 			if(m_options.bPaused && frozenEntries.empty())
 			{
 				frozenEntries = m_options.bShowAllThreads ? Profiler::GetInstance().GetAllThreadsEntries() : Profiler::GetInstance().GetCurrentThreadEntries();
+				frozenCounterSamples = Profiler::GetInstance().GetAllThreadsCounterSamples();
+				frozenJobs = Profiler::GetInstance().GetAllThreadsJobs();
 			}
 
 			// If unpausing, clear frozen data
 			if(!m_options.bPaused && !frozenEntries.empty())
 			{
 				frozenEntries.clear();
+				frozenCounterSamples.clear();
+				frozenJobs.clear();
 			}
 
 			u64 totalDuration = 0;
@@ -71,16 +100,16 @@ public:
 			u8 maxDepth = 0;
 
 			// Group m_frameEntries by thread for better analysis
-			std::unordered_map<std::thread::id, std::vector<ProfilerEntry>> threadGroups;
-			std::unordered_map<std::thread::id, u64> threadDurations;
+			std::unordered_map<u8, std::vector<ProfilerEntry>> threadGroups;
+			std::unordered_map<u8, u64> threadDurations;
 
 			for(const auto& entry : m_frameEntries)
 			{
-				threadGroups[entry.threadId].push_back(entry);
+				threadGroups[entry.threadIndex].push_back(entry);
 
 				if(entry.depth == 0)
 				{
-					threadDurations[entry.threadId] += entry.duration;
+					threadDurations[entry.threadIndex] += entry.duration;
 					totalDuration += entry.duration;
 				}
 
@@ -104,6 +133,7 @@ public:
 				ImGui::DragFloat("Side Margin", &m_options.sideMargin, 0.1f, 0.0f, 20.0f);
 				ImGui::DragFloat("Top Margin", &m_options.topMargin, 0.1f, 0.0f, 50.0f);
 				ImGui::DragFloat("Thread Separator Height", &m_options.threadSeparatorHeight, 0.1f, 0.0f, 30.0f);
+				ImGui::DragFloat("Counter Track Height", &m_options.counterTrackHeight, 0.1f, 10.0f, 100.0f);
 				ImGui::DragInt("Entry Background Opacity", &m_options.entryBackgroundOpacity, 1, 0, 255);
 				ImGui::DragInt("Entry Border Opacity", &m_options.entryBorderOpacity, 1, 0, 255);
 			}
@@ -115,27 +145,62 @@ public:
 				if(m_options.bPaused)
 				{
 					frozenEntries = m_options.bShowAllThreads ? Profiler::GetInstance().GetAllThreadsEntries() : Profiler::GetInstance().GetCurrentThreadEntries();
+					frozenCounterSamples = Profiler::GetInstance().GetAllThreadsCounterSamples();
+					frozenJobs = Profiler::GetInstance().GetAllThreadsJobs();
 				}
 			}
 
 			ImGui::SameLine(); ImGui::Checkbox("Show Tooltips", &m_options.bShowTooltips);
 			ImGui::SameLine(); ImGui::Checkbox("Group by Threads", &m_options.bGroupByThreads);
 			ImGui::SameLine(); ImGui::Checkbox("Show All Threads", &m_options.bShowAllThreads);
+			ImGui::SameLine(); ImGui::Checkbox("Job Flows", &m_options.bShowJobFlows);
+
+			DrawTraceCapture();
+
+			if(ImGui::CollapsingHeader("History"))
+			{
+				DrawHistory();
+			}
+
+			if(ImGui::CollapsingHeader("Statistics"))
+			{
+				DrawSectionStats();
+			}
+
+			if(ImGui::CollapsingHeader("Counters"))
+			{
+				DrawCounters();
+			}
+
+			if(ImGui::CollapsingHeader("Hardware Counters"))
+			{
+				DrawHwCounters();
+			}
+
+			if(ImGui::CollapsingHeader("Locks"))
+			{
+				DrawLocks();
+			}
+
+			if(ImGui::CollapsingHeader("Jobs"))
+			{
+				DrawJobs();
+			}
 
 			// Thread selection dropdown
 			if(!m_options.bShowAllThreads)
 			{
 				ImGui::SameLine();
-				if(ImGui::BeginCombo("Thread", m_options.bHasSelectedThread ? Profiler::GetInstance().GetThreadName(selectedThreadId) : "Select Thread"))
+				if(ImGui::BeginCombo("Thread", m_options.bHasSelectedThread ? Profiler::GetInstance().GetThreadName(selectedThreadIndex) : "Select Thread"))
 				{
-					for(const auto& [threadId, entries] : threadGroups)
+					for(const auto& [threadIndex, entries] : threadGroups)
 					{
-						bool isSelected = (m_options.bHasSelectedThread && selectedThreadId == threadId);
-						std::string threadName = Profiler::GetInstance().GetThreadName(threadId);
+						bool isSelected = (m_options.bHasSelectedThread && selectedThreadIndex == threadIndex);
+						std::string threadName = Profiler::GetInstance().GetThreadName(threadIndex);
 
 						if(ImGui::Selectable(threadName.c_str(), isSelected))
 						{
-							selectedThreadId = threadId;
+							selectedThreadIndex = threadIndex;
 							m_options.bHasSelectedThread = true;
 						}
 
@@ -163,7 +228,7 @@ public:
 					{
 						// Calculate height per thread group
 						float totalHeight = 0;
-						for(const auto& [threadId, entries] : threadGroups)
+						for(const auto& [threadIndex, entries] : threadGroups)
 						{
 							u8 threadMaxDepth = 2;
 							for(const auto& entry : entries)
@@ -175,6 +240,18 @@ public:
 						graphHeight += totalHeight;
 					}
 
+					// Counter tracks go under the scopes, one per name
+					std::sort(m_frameCounterSamples.begin(), m_frameCounterSamples.end(), [](const ProfilerCounterSample& a, const ProfilerCounterSample& b) {
+						const i32 order = std::strcmp(a.name, b.name);
+						return order != 0 ? order < 0 : a.timestamp < b.timestamp;
+					});
+					u32 numCounterTracks = 0;
+					for(u64 i = 0; i < m_frameCounterSamples.size(); i++)
+					{
+						numCounterTracks += (i == 0 || std::strcmp(m_frameCounterSamples[i].name, m_frameCounterSamples[i - 1].name) != 0) ? 1 : 0;
+					}
+					graphHeight += numCounterTracks * (m_options.counterTrackHeight + m_options.barSpacing);
+
 					canvas_sz.y = std::max(canvas_sz.y, graphHeight);
 					ImVec2 canvas_p1 = ImVec2(canvas_p0.x + canvas_sz.x, canvas_p0.y + canvas_sz.y);
 
@@ -205,18 +282,22 @@ public:
 					// Reset Hover each Frame.
 					pHoveredEntry = nullptr;
 
+					// Top of each thread's first row, where job flows start and end
+					std::unordered_map<u8, float> threadLaneY;
+
 					if(m_options.bShowAllThreads && threadGroups.size() > 1)
 					{
-						for(auto& [threadId, entries] : threadGroups)
+						for(auto& [threadIndex, entries] : threadGroups)
 						{
-							const u64 threadDuration = threadDurations[threadId];
-							std::string threadLabel = Profiler::GetInstance().GetThreadName(threadId);
+							const u64 threadDuration = threadDurations[threadIndex];
+							std::string threadLabel = Profiler::GetInstance().GetThreadName(threadIndex);
 
-							const char* threadInfoStr = StringFactory::TempFormat("%s - Duration: %u ms", threadLabel.c_str(), US_TO_MS(threadDuration));
+							const char* threadInfoStr = StringFactory::TempFormat("%s - Duration: %u ms", threadLabel.c_str(), NS_TO_MS(threadDuration));
 
 							ImU32 threadLabelColor = ImGui::WithAlpha(ImGui::PASTEL_LEMON_CHIFFON, 160);
 							pDrawList->AddText(ImVec2(canvas_p0.x + m_options.sideMargin, currentY), threadLabelColor, threadInfoStr);
 							currentY += 20.0f;
+							threadLaneY[threadIndex] = currentY;
 
 							for(auto& entry : entries)
 							{
@@ -234,6 +315,11 @@ public:
 
 							currentY += (threadMaxDepth + 1) * (m_options.barHeight + m_options.barSpacing) + m_options.threadSeparatorHeight;
 						}
+
+						if(m_options.bShowJobFlows)
+						{
+							DrawJobFlows(*pDrawList, threadLaneY, canvas_p0, canvas_sz, minTimestamp, timeRange, virtualCanvasWidth, panOffsetPixels);
+						}
 					}
 					else
 					{
@@ -244,8 +330,13 @@ public:
 								minTimestamp, timeRange, virtualCanvasWidth, panOffsetPixels, visibleStartTime, visibleEndTime,
 								totalDuration, mousePos);
 						}
+						currentY += (maxDepth + 1) * (m_options.barHeight + m_options.barSpacing) + m_options.threadSeparatorHeight;
 					}
 
+					currentY = DrawCounterTracks(*pDrawList, canvas_p0, canvas_sz, currentY, minTimestamp, timeRange,
+						virtualCanvasWidth, panOffsetPixels, mousePos);
+					graphHeight = std::max(graphHeight, currentY - canvas_p0.y);
+
 					// Show tooltip for hovered entry
 					ShowTooltip(pHoveredEntry, totalDuration);
 
@@ -258,18 +349,18 @@ public:
 				{
 
 					// Display frame time and thread breakdown
-					ImGui::Text("FrameTime: %.3f ms", US_TO_MS((f32)totalDuration));
+					ImGui::Text("FrameTime: %.3f ms", NS_TO_MS((f32)totalDuration));
 
 					if(m_options.bShowAllThreads && threadDurations.size() > 1)
 					{
 						ImGui::Text("Threads: %zu", threadDurations.size());
 
 						// Show thread time breakdown
-						for(const auto& [threadId, duration] : threadDurations)
+						for(const auto& [threadIndex, duration] : threadDurations)
 						{
 							ImGui::Text("  %s: %.2f ms (%.1f%%)",
-								Profiler::GetInstance().GetThreadName(threadId),
-								US_TO_MS((f32)duration),
+								Profiler::GetInstance().GetThreadName(threadIndex),
+								NS_TO_MS((f32)duration),
 								totalDuration > 0 ? (f32)duration / totalDuration * 100.0f : 0.0f);
 						}
 						ImGui::Separator();
@@ -297,7 +388,7 @@ public:
 						if(m_options.bGroupByThreads && m_options.bShowAllThreads && threadGroups.size() > 1)
 						{
 							// Display grouped by thread
-							for(const auto& [threadId, threadEntries] : threadGroups)
+							for(const auto& [threadIndex, threadEntries] : threadGroups)
 							{
 								// Thread header row
 								ImGui::TableNextRow();
@@ -305,18 +396,18 @@ public:
 
 								ImU32 headerColor = ImGui::GetColorU32(ImGuiCol_HeaderActive);
 								ImGui::TableSetBgColor(ImGuiTableBgTarget_RowBg0, headerColor);
-								ImGui::Text("%s", Profiler::GetInstance().GetThreadName(threadId));
+								ImGui::Text("%s", Profiler::GetInstance().GetThreadName(threadIndex));
 
 								ImGui::TableNextColumn();
 								ImGui::Text("Thread");
 								ImGui::TableNextColumn();
-								ImGui::Text("%.2f ms", US_TO_MS((f32)threadDurations[threadId]));
+								ImGui::Text("%.2f ms", NS_TO_MS((f32)threadDurations[threadIndex]));
 
 								// Sort thread m_frameEntries
 								std::vector<ProfilerEntry> sortedThreadEntries = threadEntries;
 								std::sort(sortedThreadEntries.begin(), sortedThreadEntries.end(),
 									[](const ProfilerEntry& a, const ProfilerEntry& b) {
-										return a.threadId > b.threadId;
+										return a.threadIndex > b.threadIndex;
 									});
 
 								// Display m_frameEntries for this thread
@@ -327,13 +418,13 @@ public:
 
 									// Indent based on depth
 									std::string indent(entry.depth * 2, ' ');
-									ImGui::Text("%s%s", indent.c_str(), entry.section);
+									ImGui::Text("%s%s", indent.c_str(), entry.GetName());
 
 									ImGui::TableNextColumn();
-									ImGui::Text("%s", Profiler::GetInstance().GetThreadName(entry.threadId));
+									ImGui::Text("%s", Profiler::GetInstance().GetThreadName(entry.threadIndex));
 
 									ImGui::TableNextColumn();
-									const char* str = StringFactory::TempFormat("%.3f ms", US_TO_MS((f32)entry.duration));
+									const char* str = StringFactory::TempFormat("%.3f ms", NS_TO_MS((f32)entry.duration));
 									const float percentage = totalDuration > 0 ? (float)entry.duration / totalDuration : 0.0f;
 									ImGui::UsageProgressBar(str, percentage, ImVec2(-1.0f, 15.0f));
 								}
@@ -349,17 +440,17 @@ public:
 
 								// Indent based on depth
 								std::string indent(entry.depth * 2, ' ');
-								ImGui::Text("%s%s", indent.c_str(), entry.section);
+								ImGui::Text("%s%s", indent.c_str(), entry.GetName());
 
 								if(m_options.bGroupByThreads && m_options.bShowAllThreads)
 								{
 									ImGui::TableNextColumn();
-									ImGui::Text("%s", Profiler::GetInstance().GetThreadName(entry.threadId));
+									ImGui::Text("%s", Profiler::GetInstance().GetThreadName(entry.threadIndex));
 								}
 
 								ImGui::TableNextColumn();
 
-								const char* str = StringFactory::TempFormat("%.3f ms", US_TO_MS((f32)entry.duration));
+								const char* str = StringFactory::TempFormat("%.3f ms", NS_TO_MS((f32)entry.duration));
 								const float percentage = totalDuration > 0 ? (float)entry.duration / totalDuration : 0.0f;
 								ImGui::UsageProgressBar(str, percentage, ImVec2(-1.0f, 15.0f));
 							}
@@ -384,7 +475,7 @@ public:
 							{
 								ImGui::Text("Heaviest Thread: %s (%.2f ms)",
 									Profiler::GetInstance().GetThreadName(heaviestThread->first),
-									US_TO_MS((f32)heaviestThread->second));
+									NS_TO_MS((f32)heaviestThread->second));
 							}
 						}
 					}
@@ -437,7 +528,11 @@ private:
 		const ImVec2 rectMin(startX, y);
 		const ImVec2 rectMax(endX, y + m_options.barHeight);
 
-		const ImU32 backgroundColor = ImGui::GetPastelColor(entry.depth + std::hash<std::thread::id>{}(entry.threadId), m_options.entryBackgroundOpacity);
+		// PROFILE_SCOPE_COLOR scopes keep their color
+		const u32 scopeColor = entry.GetScope().color;
+		const ImU32 backgroundColor = scopeColor != 0
+			? ImGui::WithAlpha(scopeColor, m_options.entryBackgroundOpacity)
+			: ImGui::GetPastelColor(entry.depth + entry.threadIndex, m_options.entryBackgroundOpacity);
 
 		// Draw rectangle
 		rDrawList.AddRectFilled(rectMin, rectMax, backgroundColor);
@@ -456,7 +551,7 @@ private:
 		float rectWidth = endX - startX;
 		if(rectWidth > minSizeForText)
 		{
-			std::string text = entry.section;
+			std::string text = entry.GetName();
 			ImVec2 textSize = ImGui::CalcTextSize(text.c_str());
 
 			// Truncate text if needed
@@ -537,6 +632,760 @@ private:
 		}
 	}
 
+	// Frame time strip over the Profiler history. Click selects the frame shown below, Ctrl+Click picks
+	// a second frame to diff against.
+	void DrawHistory()
+	{
+		Profiler& rProfiler = Profiler::GetInstance();
+		const u32 numFrames = rProfiler.GetNumHistoryFrames();
+
+		// Resizing clears the history: applied once the drag is released, not on every tick of it
+		if(!m_history.bEditingSize)
+		{
+			m_history.editedSize = (i32)rProfiler.GetHistorySize();
+		}
+		ImGui::SetNextItemWidth(80.0f);
+		ImGui::DragInt("Frames Kept", &m_history.editedSize, 1.0f, 0, 3000);
+		m_history.bEditingSize = ImGui::IsItemActive();
+		if(ImGui::IsItemDeactivatedAfterEdit())
+		{
+			rProfiler.SetHistorySize((u32)utils::Max(0, m_history.editedSize));
+			m_history.bHasSelection = false;
+			m_history.bHasCompare = false;
+			return;
+		}
+
+		f32 spikeFactor = rProfiler.GetSpikeFactor();
+		ImGui::SameLine();
+		ImGui::SetNextItemWidth(80.0f);
+		if(ImGui::DragFloat("Spike Factor", &spikeFactor, 0.01f, 1.05f, 10.0f, "%.2fx"))
+		{
+			rProfiler.SetSpikeFactor(spikeFactor);
+		}
+
+		if(numFrames == 0)
+		{
+			return;
+		}
+
+		u64 maxDurationNs = 1;
+		u32 numSpikes = 0;
+		for(u32 i = 0; i < numFrames; i++)
+		{
+			const ProfilerFrame& frame = rProfiler.GetHistoryFrame(i);
+			maxDurationNs = utils::Max(maxDurationNs, frame.durationNs);
+			numSpikes += frame.bSpike ? 1 : 0;
+		}
+
+		ImGui::SameLine();
+		if(ImGui::Button("Live"))
+		{
+			m_history.bHasSelection = false;
+			m_history.bHasCompare = false;
+		}
+		ImGui::SameLine();
+		if(ImGui::ArrowButton("##PrevSpike", ImGuiDir_Left))
+		{
+			SelectSpike(-1);
+		}
+		ImGui::SameLine();
+		if(ImGui::ArrowButton("##NextSpike", ImGuiDir_Right))
+		{
+			SelectSpike(1);
+		}
+		ImGui::SameLine();
+		ImGui::Text("%u spikes in %u frames", numSpikes, numFrames);
+
+		// Frame strip, newest on the right
+		const ImVec2 canvasStart = ImGui::GetCursorScreenPos();
+		const ImVec2 canvasSize(ImGui::GetContentRegionAvail().x, 60.0f);
+		ImGui::InvisibleButton("##FrameStrip", canvasSize);
+		const bool bHovered = ImGui::IsItemHovered();
+
+		ImDrawList* pDrawList = ImGui::GetWindowDrawList();
+		pDrawList->AddRectFilled(canvasStart, ImVec2(canvasStart.x + canvasSize.x, canvasStart.y + canvasSize.y), ImGui::WithAlpha(ImGui::PASTEL_LIGHT_BLUE, 40));
+
+		const u32 historySizeFrames = utils::Max(1u, rProfiler.GetHistorySize());
+		const f32 barWidth = canvasSize.x / (f32)historySizeFrames;
+		const f32 firstX = canvasStart.x + canvasSize.x - barWidth * (f32)numFrames;
+
+		for(u32 i = 0; i < numFrames; i++)
+		{
+			const ProfilerFrame& frame = rProfiler.GetHistoryFrame(i);
+			const f32 x = firstX + barWidth * (f32)i;
+			const f32 height = canvasSize.y * (f32)frame.durationNs / (f32)maxDurationNs;
+
+			ImU32 color = frame.bSpike ? ImGui::PASTEL_LIGHT_PINK : ImGui::PASTEL_LIGHT_GREEN;
+			if(m_history.bHasSelection && frame.frameIndex == m_history.selectedFrame)
+			{
+				color = ImGui::PASTEL_LEMON_CHIFFON;
+			}
+			else if(m_history.bHasCompare && frame.frameIndex == m_history.compareFrame)
+			{
+				color = ImGui::PASTEL_LAVENDER;
+			}
+
+			pDrawList->AddRectFilled(ImVec2(x, canvasStart.y + canvasSize.y - height),
+				ImVec2(x + utils::Max(1.0f, barWidth - 1.0f), canvasStart.y + canvasSize.y), color);
+		}
+
+		if(bHovered)
+		{
+			const f32 mouseX = ImGui::GetMousePos().x;
+			const i64 hoveredIndex = (i64)((mouseX - firstX) / barWidth);
+			if(hoveredIndex >= 0 && hoveredIndex < (i64)numFrames)
+			{
+				const ProfilerFrame& frame = rProfiler.GetHistoryFrame((u32)hoveredIndex);
+				ImGui::SetTooltip("Frame %llu: %.3f ms%s", (unsigned long long)frame.frameIndex, NS_TO_MS((f32)frame.durationNs),
+					frame.bSpike ? " (spike)" : "");
+
+				if(ImGui::IsMouseClicked(ImGuiMouseButton_Left))
+				{
+					if(ImGui::GetIO().KeyCtrl && m_history.bHasSelection)
+					{
+						m_history.compareFrame = frame.frameIndex;
+						m_history.bHasCompare = true;
+					}
+					else
+					{
+						m_history.selectedFrame = frame.frameIndex;
+						m_history.bHasSelection = true;
+					}
+				}
+			}
+		}
+
+		const ProfilerFrame* pSelected = m_history.bHasSelection ? rProfiler.FindHistoryFrame(m_history.selectedFrame) : nullptr;
+		const ProfilerFrame* pCompare = m_history.bHasCompare ? rProfiler.FindHistoryFrame(m_history.compareFrame) : nullptr;
+		m_history.bHasCompare = pCompare != nullptr;
+
+		if(pSelected && pCompare)
+		{
+			DrawFrameDiff(*pSelected, *pCompare);
+		}
+		else if(pSelected)
+		{
+			ImGui::Text("Frame %llu: %.3f ms. Ctrl+Click another frame to compare.", (unsigned long long)pSelected->frameIndex,
+				NS_TO_MS((f32)pSelected->durationNs));
+		}
+	}
+
+	// Moves the selection to the previous (-1) or next (+1) spike, from the newest frame when nothing is selected
+	void SelectSpike(i32 direction)
+	{
+		Profiler& rProfiler = Profiler::GetInstance();
+		const i64 numFrames = (i64)rProfiler.GetNumHistoryFrames();
+		const ProfilerFrame* pSelected = m_history.bHasSelection ? rProfiler.FindHistoryFrame(m_history.selectedFrame) : nullptr;
+
+		i64 index = pSelected ? (i64)(pSelected->frameIndex - rProfiler.GetHistoryFrame(0).frameIndex) : numFrames;
+		for(index += direction; index >= 0 && index < numFrames; index += direction)
+		{
+			const ProfilerFrame& frame = rProfiler.GetHistoryFrame((u32)index);
+			if(frame.bSpike)
+			{
+				m_history.selectedFrame = frame.frameIndex;
+				m_history.bHasSelection = true;
+				return;
+			}
+		}
+	}
+
+	// Section times summed per name (all threads), largest change first
+	void DrawFrameDiff(const ProfilerFrame& frameA, const ProfilerFrame& frameB)
+	{
+		struct SectionTimes
+		{
+			u64 nsA = 0;
+			u64 nsB = 0;
+		};
+
+		std::unordered_map<std::string_view, SectionTimes> sections;
+		for(const ProfilerEntry& entry : frameA.entries)
+		{
+			sections[entry.GetName()].nsA += entry.duration;
+		}
+		for(const ProfilerEntry& entry : frameB.entries)
+		{
+			sections[entry.GetName()].nsB += entry.duration;
+		}
+
+		std::vector<std::pair<std::string_view, SectionTimes>> rows(sections.begin(), sections.end());
+		std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) {
+			return std::abs((i64)a.second.nsB - (i64)a.second.nsA) > std::abs((i64)b.second.nsB - (i64)b.second.nsA);
+		});
+
+		if(ImGui::BeginTable("FRAME_DIFF", 4, ImGuiTableFlags_ScrollY | ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg, ImVec2(0.0f, 200.0f)))
+		{
+			ImGui::TableSetupScrollFreeze(0, 1);
+			ImGui::TableSetupColumn("Section", ImGuiTableColumnFlags_WidthStretch);
+			ImGui::TableSetupColumn(StringFactory::TempFormat("Frame %llu", (unsigned long long)frameA.frameIndex), ImGuiTableColumnFlags_WidthFixed, 90.0f);
+			ImGui::TableSetupColumn(StringFactory::TempFormat("Frame %llu", (unsigned long long)frameB.frameIndex), ImGuiTableColumnFlags_WidthFixed, 90.0f);
+			ImGui::TableSetupColumn("Delta", ImGuiTableColumnFlags_WidthFixed, 90.0f);
+			ImGui::TableHeadersRow();
+
+			DrawFrameDiffRow("Frame", frameA.durationNs, frameB.durationNs);
+			for(const auto& [section, times] : rows)
+			{
+				DrawFrameDiffRow(section, times.nsA, times.nsB);
+			}
+
+			ImGui::EndTable();
+		}
+	}
+
+	void DrawFrameDiffRow(std::string_view section, u64 nsA, u64 nsB)
+	{
+		const f32 deltaMs = NS_TO_MS((f32)nsB - (f32)nsA);
+
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::Text("%.*s", (i32)section.size(), section.data());
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f ms", NS_TO_MS((f32)nsA));
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f ms", NS_TO_MS((f32)nsB));
+		ImGui::TableNextColumn();
+		ImGui::TextColored(deltaMs > 0.0f ? ImVec4(1.0f, 0.5f, 0.5f, 1.0f) : ImVec4(0.5f, 1.0f, 0.5f, 1.0f), "%+.3f ms", deltaMs);
+	}
+
+	// Rolling per-section numbers from the Profiler, one row per section and thread
+	void DrawSectionStats()
+	{
+		Profiler& rProfiler = Profiler::GetInstance();
+
+		i32 statsWindow = (i32)rProfiler.GetStatsWindow();
+		ImGui::SetNextItemWidth(80.0f);
+		if(ImGui::DragInt("Window (frames)", &statsWindow, 1.0f, 0, (i32)Profiler::MAX_STATS_WINDOW))
+		{
+			rProfiler.SetStatsWindow((u32)utils::Max(0, statsWindow));
+		}
+		ImGui::SameLine();
+		m_statsFilter.Draw("Filter", 180.0f);
+
+		rProfiler.GetSectionStats(m_sectionStats);
+		std::erase_if(m_sectionStats, [this](const ProfilerSectionStats& stats) { return !m_statsFilter.PassFilter(stats.section); });
+
+		const ImGuiTableFlags flags = ImGuiTableFlags_Sortable | ImGuiTableFlags_SortTristate | ImGuiTableFlags_ScrollY
+			| ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable;
+		if(!ImGui::BeginTable("SECTION_STATS", 9, flags, ImVec2(0.0f, 250.0f)))
+		{
+			return;
+		}
+
+		ImGui::TableSetupScrollFreeze(0, 1);
+		ImGui::TableSetupColumn("Section", ImGuiTableColumnFlags_WidthStretch);
+		ImGui::TableSetupColumn("Thread", ImGuiTableColumnFlags_WidthFixed, 100.0f);
+		ImGui::TableSetupColumn("Frames", ImGuiTableColumnFlags_WidthFixed, 50.0f);
+		ImGui::TableSetupColumn("Calls", ImGuiTableColumnFlags_WidthFixed, 50.0f);
+		ImGui::TableSetupColumn("Min", ImGuiTableColumnFlags_WidthFixed, 70.0f);
+		ImGui::TableSetupColumn("Avg", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_DefaultSort | ImGuiTableColumnFlags_PreferSortDescending, 70.0f);
+		ImGui::TableSetupColumn("Max", ImGuiTableColumnFlags_WidthFixed, 70.0f);
+		ImGui::TableSetupColumn("p95", ImGuiTableColumnFlags_WidthFixed, 70.0f);
+		ImGui::TableSetupColumn("p99", ImGuiTableColumnFlags_WidthFixed, 70.0f);
+		ImGui::TableHeadersRow();
+
+		if(const ImGuiTableSortSpecs* pSortSpecs = ImGui::TableGetSortSpecs(); pSortSpecs && pSortSpecs->SpecsCount > 0)
+		{
+			// Thread sorts by the name shown. Looked up once per row here, GetThreadName takes a lock.
+			std::vector<const char*> threadNames(256, nullptr);
+			for(const ProfilerSectionStats& stats : m_sectionStats)
+			{
+				if(!threadNames[stats.threadIndex])
+				{
+					threadNames[stats.threadIndex] = rProfiler.GetThreadName(stats.threadIndex);
+				}
+			}
+
+			const ImGuiTableColumnSortSpecs& spec = pSortSpecs->Specs[0];
+			std::stable_sort(m_sectionStats.begin(), m_sectionStats.end(), [&spec, &threadNames](const ProfilerSectionStats& a, const ProfilerSectionStats& b) {
+				const bool bLess = CompareSectionStats(a, b, spec.ColumnIndex, threadNames);
+				const bool bGreater = CompareSectionStats(b, a, spec.ColumnIndex, threadNames);
+				return spec.SortDirection == ImGuiSortDirection_Descending ? bGreater : bLess;
+			});
+		}
+
+		for(const ProfilerSectionStats& stats : m_sectionStats)
+		{
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(stats.section);
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(rProfiler.GetThreadName(stats.threadIndex));
+			ImGui::TableNextColumn();
+			ImGui::Text("%u", stats.numFrames);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.1f", stats.callsPerFrame);
+			for(u64 ns : { stats.minNs, stats.avgNs, stats.maxNs, stats.p95Ns, stats.p99Ns })
+			{
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f ms", NS_TO_MS((f32)ns));
+			}
+		}
+
+		ImGui::EndTable();
+	}
+
+	static bool CompareSectionStats(const ProfilerSectionStats& a, const ProfilerSectionStats& b, i32 column,
+		const std::vector<const char*>& threadNames)
+	{
+		switch(column)
+		{
+		case 0: return std::strcmp(a.section, b.section) < 0;
+		case 1: return std::strcmp(threadNames[a.threadIndex], threadNames[b.threadIndex]) < 0;
+		case 2: return a.numFrames < b.numFrames;
+		case 3: return a.callsPerFrame < b.callsPerFrame;
+		case 4: return a.minNs < b.minNs;
+		case 5: return a.avgNs < b.avgNs;
+		case 6: return a.maxNs < b.maxNs;
+		case 7: return a.p95Ns < b.p95Ns;
+		case 8: return a.p99Ns < b.p99Ns;
+		default: return false;
+		}
+	}
+
+	// One step line per counter name, over the same time axis as the scopes. PROFILE_COUNTER tracks
+	// show the running total through the frame, PROFILE_PLOT tracks the samples. Returns the y below
+	// the last track.
+	float DrawCounterTracks(ImDrawList& rDrawList, ImVec2 canvas_p0, ImVec2 canvas_sz, float baseY, u64 minTimestamp, u64 timeRange,
+		float virtualCanvasWidth, float panOffsetPixels, ImVec2 mousePos)
+	{
+		const float minX = canvas_p0.x + m_options.sideMargin;
+		const float maxX = canvas_p0.x + canvas_sz.x - m_options.sideMargin;
+		auto toScreenX = [&](u64 timestamp) {
+			const f64 t = timeRange > 0 ? ((f64)timestamp - (f64)minTimestamp) / (f64)timeRange : 0.0;
+			return std::clamp(minX + (float)t * virtualCanvasWidth - panOffsetPixels, minX, maxX);
+		};
+
+		float y = baseY;
+		u64 first = 0;
+		while(first < m_frameCounterSamples.size())
+		{
+			const char* name = m_frameCounterSamples[first].name;
+			const bool bRunningTotal = m_frameCounterSamples[first].kind == ProfilerCounterKind::Counter;
+
+			u64 last = first;
+			m_trackValues.clear();
+			f64 total = 0.0;
+			for(; last < m_frameCounterSamples.size() && std::strcmp(m_frameCounterSamples[last].name, name) == 0; last++)
+			{
+				total = bRunningTotal ? total + m_frameCounterSamples[last].value : m_frameCounterSamples[last].value;
+				m_trackValues.push_back(total);
+			}
+
+			const auto [minIt, maxIt] = std::minmax_element(m_trackValues.begin(), m_trackValues.end());
+			const f64 minValue = bRunningTotal ? utils::Min(0.0, *minIt) : *minIt;
+			const f64 valueRange = *maxIt > minValue ? *maxIt - minValue : 1.0;
+
+			const float top = y;
+			const float bottom = y + m_options.counterTrackHeight;
+			rDrawList.AddRectFilled(ImVec2(minX, top), ImVec2(maxX, bottom), ImGui::WithAlpha(ImGui::PASTEL_LAVENDER, 30));
+
+			const ImU32 lineColor = ImGui::GetPastelColor(std::hash<std::string_view>{}(name), 220);
+			float prevX = minX;
+			float prevY = bottom;
+			for(u64 i = 0; i < m_trackValues.size(); i++)
+			{
+				const float x = toScreenX(m_frameCounterSamples[first + i].timestamp);
+				const float valueY = bottom - (float)((m_trackValues[i] - minValue) / valueRange) * (m_options.counterTrackHeight - 2.0f);
+				if(i > 0 || bRunningTotal)
+				{
+					rDrawList.AddLine(ImVec2(prevX, prevY), ImVec2(x, prevY), lineColor);
+					rDrawList.AddLine(ImVec2(x, prevY), ImVec2(x, valueY), lineColor);
+				}
+				prevX = x;
+				prevY = valueY;
+			}
+			rDrawList.AddLine(ImVec2(prevX, prevY), ImVec2(maxX, prevY), lineColor);
+
+			const char* label = StringFactory::TempFormat("%s: %.6g (%.6g - %.6g)", name, m_trackValues.back(), minValue, *maxIt);
+			rDrawList.AddText(ImVec2(minX + 2.0f, top), ImGui::WithAlpha(ImGui::PASTEL_LEMON_CHIFFON, 200), label);
+
+			if(m_options.bShowTooltips && mousePos.x >= minX && mousePos.x <= maxX && mousePos.y >= top && mousePos.y < bottom)
+			{
+				// Value at the mouse: the last sample left of it
+				u64 hovered = 0;
+				while(hovered + 1 < m_trackValues.size() && toScreenX(m_frameCounterSamples[first + hovered + 1].timestamp) <= mousePos.x)
+				{
+					hovered++;
+				}
+				ImGui::SetTooltip("%s: %.6g", name, m_trackValues[hovered]);
+			}
+
+			y = bottom + m_options.barSpacing;
+			first = last;
+		}
+		return y;
+	}
+
+	// An arrow per job from where it was queued to where a worker picked it up, over the thread
+	// lanes. Long queue waits stand out in red, jobs from or to a thread without scopes this frame
+	// are skipped.
+	void DrawJobFlows(ImDrawList& rDrawList, const std::unordered_map<u8, float>& threadLaneY, ImVec2 canvas_p0, ImVec2 canvas_sz,
+		u64 minTimestamp, u64 timeRange, float virtualCanvasWidth, float panOffsetPixels)
+	{
+		if(timeRange == 0)
+		{
+			return;
+		}
+
+		const float minX = canvas_p0.x + m_options.sideMargin;
+		const float maxX = canvas_p0.x + canvas_sz.x - m_options.sideMargin;
+		// Jobs can be queued before the frame's first scope, keep the sign
+		auto toScreenX = [&](u64 timestamp) {
+			const f64 t = ((f64)timestamp - (f64)minTimestamp) / (f64)timeRange;
+			return minX + (float)t * virtualCanvasWidth - panOffsetPixels;
+		};
+
+		const u64 longWaitNs = US_TO_NS((u64)m_options.jobLongWaitUs);
+		const float arrowSize = 4.0f;
+		for(const ProfilerJobFlow& job : m_frameJobs)
+		{
+			auto producerIt = threadLaneY.find(job.producerThread);
+			auto workerIt = threadLaneY.find(job.workerThread);
+			if(producerIt == threadLaneY.end() || workerIt == threadLaneY.end())
+			{
+				continue;
+			}
+
+			const ImVec2 from(toScreenX(job.enqueueTime), producerIt->second + m_options.barHeight * 0.5f);
+			const ImVec2 to(toScreenX(job.startTime), workerIt->second + m_options.barHeight * 0.5f);
+			if(utils::Max(from.x, to.x) < minX || utils::Min(from.x, to.x) > maxX)
+			{
+				continue;
+			}
+
+			const ImU32 color = job.GetQueueWaitNs() >= longWaitNs ? ImGui::WithAlpha(ImGui::PASTEL_LIGHT_PINK, 220) : ImGui::WithAlpha(ImGui::PASTEL_PALE_TURQUOISE, 120);
+			rDrawList.AddLine(from, to, color);
+
+			const float dy = to.y >= from.y ? -arrowSize : arrowSize;
+			rDrawList.AddTriangleFilled(to, ImVec2(to.x - arrowSize, to.y + dy), ImVec2(to.x + arrowSize, to.y + dy), color);
+		}
+	}
+
+	// Queue wait histogram (power of two buckets) and the waits per job name this frame. A wait
+	// share near 100% means jobs sit in the queue longer than they run: the scheduler, not the work,
+	// bounds the frame.
+	void DrawJobs()
+	{
+		Profiler& rProfiler = Profiler::GetInstance();
+
+		ImGui::Checkbox("Since Reset", &m_options.bJobShowTotals);
+		ImGui::SameLine();
+		if(ImGui::Button("Reset"))
+		{
+			rProfiler.ResetJobHistogram();
+		}
+		ImGui::SameLine();
+		ImGui::SetNextItemWidth(80.0f);
+		ImGui::DragInt("Long Wait (us)", &m_options.jobLongWaitUs, 1.0f, 1, 100000);
+
+		const ProfilerJobHistogram& histogram = m_options.bJobShowTotals ? rProfiler.GetTotalJobHistogram() : rProfiler.GetFrameJobHistogram();
+		if(histogram.numJobs == 0)
+		{
+			ImGui::TextDisabled("No jobs ran through the thread pool");
+			return;
+		}
+
+		ImGui::Text("Jobs: %llu | Queue wait avg %.1f us, p50 < %.1f us, p95 < %.1f us, p99 < %.1f us, max %.1f us",
+			(unsigned long long)histogram.numJobs, NS_TO_US((f32)histogram.totalWaitNs / histogram.numJobs),
+			NS_TO_US((f32)histogram.GetPercentileNs(0.5f)), NS_TO_US((f32)histogram.GetPercentileNs(0.95f)),
+			NS_TO_US((f32)histogram.GetPercentileNs(0.99f)), NS_TO_US((f32)histogram.maxWaitNs));
+		ImGui::Text("Run avg %.1f us | Waiting %.1f%% of the time from queued to done",
+			NS_TO_US((f32)histogram.totalRunNs / histogram.numJobs), histogram.GetWaitRatio() * 100.0f);
+
+		// Only the used bucket range
+		u32 firstBucket = 0;
+		u32 lastBucket = ProfilerJobHistogram::NUM_BUCKETS - 1;
+		while(histogram.buckets[firstBucket] == 0) { firstBucket++; }
+		while(histogram.buckets[lastBucket] == 0) { lastBucket--; }
+
+		f32 bucketCounts[ProfilerJobHistogram::NUM_BUCKETS];
+		for(u32 i = firstBucket; i <= lastBucket; i++)
+		{
+			bucketCounts[i - firstBucket] = (f32)histogram.buckets[i];
+		}
+		const char* range = StringFactory::TempFormat("%.2f us .. %.2f us", NS_TO_US((f32)(1ULL << firstBucket)), NS_TO_US((f32)(2ULL << lastBucket)));
+		ImGui::PlotHistogram("##QueueWait", bucketCounts, (i32)(lastBucket - firstBucket + 1), 0, range, 0.0f, FLT_MAX, ImVec2(-1.0f, 80.0f));
+
+		if(m_options.bJobShowTotals || m_frameJobs.empty())
+		{
+			return;
+		}
+
+		// Per job name, the frame on display
+		m_jobRows.clear();
+		for(const ProfilerJobFlow& job : m_frameJobs)
+		{
+			auto it = std::find_if(m_jobRows.begin(), m_jobRows.end(), [&job](const JobRow& row) { return row.scopeId == job.scopeId; });
+			if(it == m_jobRows.end())
+			{
+				it = m_jobRows.insert(m_jobRows.end(), JobRow{ job.scopeId });
+			}
+			it->count++;
+			it->waitNs += job.GetQueueWaitNs();
+			it->maxWaitNs = utils::Max(it->maxWaitNs, job.GetQueueWaitNs());
+			it->runNs += job.GetRunNs();
+		}
+		std::sort(m_jobRows.begin(), m_jobRows.end(), [](const JobRow& a, const JobRow& b) { return a.maxWaitNs > b.maxWaitNs; });
+
+		if(!ImGui::BeginTable("JOBS", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable | ImGuiTableFlags_ScrollY, ImVec2(0.0f, 200.0f)))
+		{
+			return;
+		}
+
+		ImGui::TableSetupScrollFreeze(0, 1);
+		ImGui::TableSetupColumn("Job", ImGuiTableColumnFlags_WidthStretch);
+		ImGui::TableSetupColumn("Count", ImGuiTableColumnFlags_WidthFixed, 60.0f);
+		ImGui::TableSetupColumn("Avg Wait (us)", ImGuiTableColumnFlags_WidthFixed, 90.0f);
+		ImGui::TableSetupColumn("Max Wait (us)", ImGuiTableColumnFlags_WidthFixed, 90.0f);
+		ImGui::TableSetupColumn("Avg Run (us)", ImGuiTableColumnFlags_WidthFixed, 90.0f);
+		ImGui::TableHeadersRow();
+
+		for(const JobRow& row : m_jobRows)
+		{
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(row.scopeId != ProfilerScopes::UNKNOWN_SCOPE ? ProfilerScopes::GetName(row.scopeId) : "(anonymous)");
+			ImGui::TableNextColumn();
+			ImGui::Text("%u", row.count);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.1f", NS_TO_US((f32)row.waitNs / row.count));
+			ImGui::TableNextColumn();
+			ImGui::Text("%.1f", NS_TO_US((f32)row.maxWaitNs));
+			ImGui::TableNextColumn();
+			ImGui::Text("%.1f", NS_TO_US((f32)row.runNs / row.count));
+		}
+
+		ImGui::EndTable();
+	}
+
+	// Frame values of every counter with its history, from the Profiler's frame history
+	void DrawCounters()
+	{
+		Profiler& rProfiler = Profiler::GetInstance();
+		const std::vector<ProfilerCounterValue>& counters = rProfiler.GetFrameCounters();
+		if(counters.empty())
+		{
+			ImGui::TextDisabled("No PROFILE_COUNTER / PROFILE_PLOT this frame");
+			return;
+		}
+
+		if(!ImGui::BeginTable("COUNTERS", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable))
+		{
+			return;
+		}
+
+		ImGui::TableSetupColumn("Counter", ImGuiTableColumnFlags_WidthFixed, 160.0f);
+		ImGui::TableSetupColumn("Kind", ImGuiTableColumnFlags_WidthFixed, 60.0f);
+		ImGui::TableSetupColumn("Frame", ImGuiTableColumnFlags_WidthFixed, 80.0f);
+		ImGui::TableSetupColumn("History", ImGuiTableColumnFlags_WidthStretch);
+		ImGui::TableHeadersRow();
+
+		const u32 numFrames = rProfiler.GetNumHistoryFrames();
+		for(const ProfilerCounterValue& counter : counters)
+		{
+			// Frames without the counter read 0 for totals and repeat the last value for plots
+			m_counterHistory.clear();
+			f32 value = 0.0f;
+			for(u32 i = 0; i < numFrames; i++)
+			{
+				const std::vector<ProfilerCounterValue>& frameCounters = rProfiler.GetHistoryFrame(i).counters;
+				auto it = std::lower_bound(frameCounters.begin(), frameCounters.end(), counter.name,
+					[](const ProfilerCounterValue& frameCounter, const char* name) { return std::strcmp(frameCounter.name, name) < 0; });
+				if(it != frameCounters.end() && std::strcmp(it->name, counter.name) == 0)
+				{
+					value = (f32)it->value;
+				}
+				else if(counter.kind == ProfilerCounterKind::Counter)
+				{
+					value = 0.0f;
+				}
+				m_counterHistory.push_back(value);
+			}
+
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(counter.name);
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(counter.kind == ProfilerCounterKind::Counter ? "Counter" : "Plot");
+			ImGui::TableNextColumn();
+			ImGui::Text("%.6g", counter.value);
+			ImGui::TableNextColumn();
+			ImGui::PushID(counter.name);
+			ImGui::PlotLines("##History", m_counterHistory.data(), (i32)m_counterHistory.size(), 0, nullptr, FLT_MAX, FLT_MAX, ImVec2(-1.0f, 30.0f));
+			ImGui::PopID();
+		}
+
+		ImGui::EndTable();
+	}
+
+	// PROFILE_SCOPE_HW scopes with IPC and misses per thousand instructions, also on --profiler-hw
+	void DrawHwCounters()
+	{
+		Profiler& rProfiler = Profiler::GetInstance();
+
+		bool bEnabled = rProfiler.AreHwCountersEnabled();
+		if(ImGui::Checkbox("Enabled", &bEnabled))
+		{
+			rProfiler.SetHwCountersEnabled(bEnabled);
+		}
+		ImGui::SameLine();
+		ImGui::Checkbox("Since Reset", &m_options.bHwShowTotals);
+		ImGui::SameLine();
+		if(ImGui::Button("Reset"))
+		{
+			rProfiler.ResetHwScopeStats();
+		}
+
+		const std::vector<ProfilerHwScopeStats>& scopeStats = rProfiler.GetHwScopeStats();
+		if(scopeStats.empty())
+		{
+			ImGui::TextDisabled(bEnabled ? "No PROFILE_SCOPE_HW scope ran, or perf events are unavailable (see the log)" : "Off");
+			return;
+		}
+
+		if(!ImGui::BeginTable("HW_COUNTERS", 7, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable))
+		{
+			return;
+		}
+
+		ImGui::TableSetupColumn("Scope", ImGuiTableColumnFlags_WidthStretch);
+		ImGui::TableSetupColumn("Calls", ImGuiTableColumnFlags_WidthFixed, 60.0f);
+		ImGui::TableSetupColumn("Cycles", ImGuiTableColumnFlags_WidthFixed, 90.0f);
+		ImGui::TableSetupColumn("Instructions", ImGuiTableColumnFlags_WidthFixed, 90.0f);
+		ImGui::TableSetupColumn("IPC", ImGuiTableColumnFlags_WidthFixed, 50.0f);
+		ImGui::TableSetupColumn("Cache MPKI", ImGuiTableColumnFlags_WidthFixed, 80.0f);
+		ImGui::TableSetupColumn("Branch MPKI", ImGuiTableColumnFlags_WidthFixed, 80.0f);
+		ImGui::TableHeadersRow();
+
+		for(const ProfilerHwScopeStats& stats : scopeStats)
+		{
+			const ProfilerHwCounts& counts = m_options.bHwShowTotals ? stats.total : stats.frame;
+			const u64 calls = m_options.bHwShowTotals ? stats.totalCalls : stats.frameCalls;
+
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(ProfilerScopes::GetName(stats.scopeId));
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", (unsigned long long)calls);
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", (unsigned long long)counts.cycles);
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", (unsigned long long)counts.instructions);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.2f", counts.GetIpc());
+			ImGui::TableNextColumn();
+			ImGui::Text("%.2f", counts.GetCacheMpki());
+			ImGui::TableNextColumn();
+			ImGui::Text("%.2f", counts.GetBranchMpki());
+		}
+
+		ImGui::EndTable();
+	}
+
+	// Every ProfiledMutex since the last reset. Maxima are since the lock was created.
+	void DrawLocks()
+	{
+		ProfilerLocks::GetStats(m_lockStats);
+		if(ImGui::Button("Reset"))
+		{
+			m_lockBaseline = m_lockStats;
+		}
+
+		if(m_lockStats.empty())
+		{
+			ImGui::SameLine();
+			ImGui::TextDisabled("No ProfiledMutex (or the profiler is compiled out)");
+			return;
+		}
+
+		if(!ImGui::BeginTable("LOCKS", 8, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable))
+		{
+			return;
+		}
+
+		ImGui::TableSetupColumn("Lock", ImGuiTableColumnFlags_WidthStretch);
+		ImGui::TableSetupColumn("Acquired", ImGuiTableColumnFlags_WidthFixed, 80.0f);
+		ImGui::TableSetupColumn("Contended", ImGuiTableColumnFlags_WidthFixed, 110.0f);
+		ImGui::TableSetupColumn("Wait", ImGuiTableColumnFlags_WidthFixed, 80.0f);
+		ImGui::TableSetupColumn("Max Wait", ImGuiTableColumnFlags_WidthFixed, 80.0f);
+		ImGui::TableSetupColumn("Hold", ImGuiTableColumnFlags_WidthFixed, 80.0f);
+		ImGui::TableSetupColumn("Max Hold", ImGuiTableColumnFlags_WidthFixed, 80.0f);
+		ImGui::TableSetupColumn("Cond. Waits", ImGuiTableColumnFlags_WidthFixed, 110.0f);
+		ImGui::TableHeadersRow();
+
+		constexpr bool bShowMicroseconds = true;
+		for(const ProfilerLockStats& current : m_lockStats)
+		{
+			ProfilerLockStats stats = current;
+			auto it = std::find_if(m_lockBaseline.begin(), m_lockBaseline.end(),
+				[&current](const ProfilerLockStats& baseline) { return baseline.lockId == current.lockId; });
+			if(it != m_lockBaseline.end())
+			{
+				stats.acquisitions -= it->acquisitions;
+				stats.contentions -= it->contentions;
+				stats.waitNs -= it->waitNs;
+				stats.holdNs -= it->holdNs;
+				stats.conditionWaits -= it->conditionWaits;
+				stats.conditionWaitNs -= it->conditionWaitNs;
+			}
+
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(stats.name);
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", (unsigned long long)stats.acquisitions);
+			ImGui::TableNextColumn();
+			const f32 contention = stats.GetContentionRatio();
+			if(contention > 0.1f)
+			{
+				ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%llu (%.1f%%)", (unsigned long long)stats.contentions, contention * 100.0f);
+			}
+			else
+			{
+				ImGui::Text("%llu (%.1f%%)", (unsigned long long)stats.contentions, contention * 100.0f);
+			}
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(utils::FormatDuration(NS_TO_US(stats.waitNs), bShowMicroseconds));
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(utils::FormatDuration(NS_TO_US(stats.maxWaitNs), bShowMicroseconds));
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(utils::FormatDuration(NS_TO_US(stats.holdNs), bShowMicroseconds));
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(utils::FormatDuration(NS_TO_US(stats.maxHoldNs), bShowMicroseconds));
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu / %s", (unsigned long long)stats.conditionWaits, utils::FormatDuration(NS_TO_US(stats.conditionWaitNs), bShowMicroseconds));
+		}
+
+		ImGui::EndTable();
+	}
+
+	// Chrome trace export, also on F9 and --trace (see GameEngine)
+	void DrawTraceCapture()
+	{
+		Profiler& rProfiler = Profiler::GetInstance();
+
+		if(rProfiler.IsCapturingTrace())
+		{
+			ImGui::Text("Capturing trace: %u / %u frames", rProfiler.GetTraceFramesCaptured(), rProfiler.GetTraceFramesRequested());
+			return;
+		}
+
+		if(ImGui::Button("Capture Trace"))
+		{
+			rProfiler.StartTraceCapture((u32)m_options.traceFrames, ProfilerTrace::MakeDefaultPath());
+		}
+		ImGui::SameLine();
+		ImGui::SetNextItemWidth(80.0f);
+		ImGui::DragInt("Frames", &m_options.traceFrames, 1.0f, 1, 3000);
+
+		if(!rProfiler.GetLastTracePath().empty())
+		{
+			ImGui::SameLine();
+			ImGui::TextDisabled("Last: %s", rProfiler.GetLastTracePath().c_str());
+		}
+	}
+
 	void ShowTooltip(const ProfilerEntry* pEntry, u64 totalDuration)
 	{
 		if(!m_options.bShowTooltips || pEntry == nullptr)
@@ -546,10 +1395,14 @@ private:
 
 		constexpr bool bShowMicroseconds = true;
 		ImGui::BeginTooltip();
-		ImGui::Text("%s", Profiler::GetInstance().GetThreadName(pEntry->threadId));
-		ImGui::Text("Task: %s", pEntry->section);
+		ImGui::Text("%s", Profiler::GetInstance().GetThreadName(pEntry->threadIndex));
+		ImGui::Text("Task: %s", pEntry->GetName());
+		if(const ProfilerScopeDesc& scope = pEntry->GetScope(); scope.file[0] != '\0')
+		{
+			ImGui::TextDisabled("%s:%u", scope.file, scope.line);
+		}
 		ImGui::Text("Duration: %s | %.2f%%",
-			utils::FormatDuration(pEntry->duration, bShowMicroseconds),
+			utils::FormatDuration(NS_TO_US(pEntry->duration), bShowMicroseconds),
 			totalDuration > 0 ? (float)pEntry->duration / totalDuration * 100.0f : 0.0f);
 		ImGui::EndTooltip();
 	}
@@ -558,12 +1411,43 @@ private:
 private:
 	ProfilerEntry* pHoveredEntry = nullptr;
 	std::vector<ProfilerEntry> frozenEntries; // Store paused data
-	std::thread::id selectedThreadId;
+	u8 selectedThreadIndex = 0;
 	std::vector<ProfilerEntry> m_frameEntries;
+	std::vector<ProfilerCounterSample> frozenCounterSamples;
+	std::vector<ProfilerCounterSample> m_frameCounterSamples;
+	std::vector<ProfilerJobFlow> frozenJobs;
+	std::vector<ProfilerJobFlow> m_frameJobs;
+	std::vector<f64> m_trackValues;
+	std::vector<f32> m_counterHistory;
+	std::vector<ProfilerLockStats> m_lockStats;
+	std::vector<ProfilerLockStats> m_lockBaseline;
+
+	struct JobRow
+	{
+		ProfilerScopeId scopeId = ProfilerScopes::UNKNOWN_SCOPE;
+		u32 count = 0;
+		u64 waitNs = 0;
+		u64 maxWaitNs = 0;
+		u64 runNs = 0;
+	};
+	std::vector<JobRow> m_jobRows;
 
 	float m_zoomLevel = 1.0f;
 	float m_scrollOffset = 0.0f;
 
+	std::vector<ProfilerSectionStats> m_sectionStats;
+	ImGuiTextFilter m_statsFilter;
+
+	struct HistorySelection
+	{
+		u64 selectedFrame = 0;
+		u64 compareFrame = 0;
+		bool bHasSelection = false;
+		bool bHasCompare = false;
+		i32 editedSize = 0;			// "Frames Kept" while it's being dragged
+		bool bEditingSize = false;
+	} m_history;
+
 	ImVec2 m_dragStartPos;
 	float m_dragStartScrollOffset;
 	bool m_bDragging = false;
@@ -576,6 +1460,7 @@ private:
 		float sideMargin = 5.0f;
 		float topMargin = 5.0f;
 		float threadSeparatorHeight = 15.0f;
+		float counterTrackHeight = 30.0f;
 
 		float minZoom = 0.01f;
 		float maxZoom = 100.0f;
@@ -583,11 +1468,17 @@ private:
 		i32 entryBackgroundOpacity = 60;
 		i32 entryBorderOpacity = 180;
 
+		i32 traceFrames = (i32)ProfilerTraceCapture::DEFAULT_NUM_FRAMES;
+		i32 jobLongWaitUs = 100;
+
 		bool bShowAllThreads = true;
 		bool bGroupByThreads = false;
 		bool bHasSelectedThread = false;
 		bool bShowTooltips = true;
 		bool bPaused = false;
+		bool bHwShowTotals = false;
+		bool bShowJobFlows = true;
+		bool bJobShowTotals = false;
 	} m_options;
 };
 
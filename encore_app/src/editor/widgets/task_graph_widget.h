@@ -0,0 +1,473 @@
+#pragma once
+
+#include "core/core_minimal.h"
+
+#include "editor/editor_widget.h"
+
+#include "game_state.h"
+#include "debug/extension_imgui.h"
+#include "imgui/imgui.h"
+#include "profiler/profiler.h"
+#include "tasks/task_graph_simulator.h"
+#include "tasks/task_system.h"
+#include "utils/string_factory.h"
+#include "utils/utils_math.h"
+#include "utils/utils_time.h"
+
+#include <vector>
+
+// Draws the scheduler's task graph laid out by execution plan level, with each task's last frame
+// duration (from the Profiler), the critical path, and how much time every worker spent idle.
+// The split candidates table replays the graph with one critical task cut in even pieces,
+// to see what splitting it would actually buy.
+class TaskGraphWidget : public EditorWidget
+{
+public:
+	explicit TaskGraphWidget(TaskSchedulerSystem* pScheduler)
+		: m_pScheduler(pScheduler)
+	{
+		Assert(m_pScheduler);
+	}
+
+	virtual void DrawMenu() override
+	{
+		ImGui::MenuItem("Task Graph", nullptr, m_pOpenPanel);
+	}
+
+	virtual void Run(GameState& rGameState) override
+	{
+		if(!rGameState.widgets.bTaskGraph)
+		{
+			return;
+		}
+
+		PROFILE_SCOPE("TaskGraph");
+
+		UpdateWorkerIdle();
+
+		if(ImGui::Begin("Profiler - Task Graph"))
+		{
+			if(!m_options.bPaused)
+			{
+				Refresh();
+			}
+
+			if(ImGui::Button(m_options.bPaused ? "Resume" : "Pause"))
+			{
+				m_options.bPaused = !m_options.bPaused;
+			}
+			ImGui::SameLine(); ImGui::Checkbox("Smooth", &m_options.bSmooth);
+			ImGui::SameLine(); ImGui::Checkbox("Show Edges", &m_options.bShowEdges);
+
+			DrawSummary();
+
+			if(ImGui::CollapsingHeader("Workers", ImGuiTreeNodeFlags_DefaultOpen))
+			{
+				DrawWorkers();
+			}
+
+			if(ImGui::CollapsingHeader("Split Candidates", ImGuiTreeNodeFlags_DefaultOpen))
+			{
+				DrawSplitCandidates();
+			}
+
+			if(ImGui::CollapsingHeader("Time Sliced Jobs"))
+			{
+				DrawTimeSlicedJobs();
+			}
+
+			if(ImGui::CollapsingHeader("Graph", ImGuiTreeNodeFlags_DefaultOpen))
+			{
+				DrawGraph();
+			}
+		}
+		ImGui::End();
+	}
+
+private:
+	static constexpr f32 NODE_WIDTH = 160.0f;
+	static constexpr f32 NODE_HEIGHT = 36.0f;
+	static constexpr f32 COLUMN_SPACING = 70.0f;
+	static constexpr f32 ROW_SPACING = 12.0f;
+	static constexpr f32 CANVAS_MARGIN = 10.0f;
+
+	static f32 NsToMs(u64 ns) { return (f32)ns / 1'000'000.0f; }
+
+	void Refresh()
+	{
+		// Durations and wall time of the last graph that finished, even with the next one already in flight
+		TaskGraphSnapshot snapshot = m_pScheduler->CaptureGraphSnapshot();
+
+		const bool bSameShape = m_smoothedNs.size() == snapshot.nodes.size();
+		m_smoothedNs.resize(snapshot.nodes.size());
+
+		for(u64 i = 0; i < snapshot.nodes.size(); i++)
+		{
+			TaskGraphSnapshot::Node& node = snapshot.nodes[i];
+			m_smoothedNs[i] = m_options.bSmooth && bSameShape ? (m_smoothedNs[i] * 7 + node.durationNs) / 8 : node.durationNs;
+			node.durationNs = m_smoothedNs[i];
+		}
+
+		m_snapshot = std::move(snapshot);
+		RebuildAnalysis();
+	}
+
+	void RebuildAnalysis()
+	{
+		TaskGraphSimulator simulator(m_snapshot);
+		m_totalWorkNs = simulator.GetTotalWorkNs();
+		m_criticalPathNs = simulator.GetCriticalPathNs();
+		m_criticalPath = simulator.GetCriticalPath();
+
+		m_bOnCriticalPath.assign(m_snapshot.nodes.size(), false);
+		for(u32 index : m_criticalPath)
+		{
+			m_bOnCriticalPath[index] = true;
+		}
+
+		// What if each critical task was split evenly across the workers? Replaying the whole graph
+		// catches the case where the next longest chain takes over and splitting buys little.
+		const u32 numWorkers = utils::Max(1u, m_snapshot.numWorkers);
+		m_predictedNs = simulator.SimulateDependencyDriven(numWorkers);
+		m_splitPredictedNs.clear();
+
+		TaskGraphSnapshot whatIf = m_snapshot;
+		for(u32 index : m_criticalPath)
+		{
+			const u64 durationNs = whatIf.nodes[index].durationNs;
+			whatIf.nodes[index].durationNs = durationNs / numWorkers;
+			m_splitPredictedNs.push_back(TaskGraphSimulator(whatIf).GetCriticalPathNs());
+			whatIf.nodes[index].durationNs = durationNs;
+		}
+	}
+
+	// Idle time is accumulated when a worker wakes up, a worker parked for the whole frame shows up late
+	void UpdateWorkerIdle()
+	{
+		const ThreadPool& pool = m_pScheduler->GetThreadPool();
+		const u32 numWorkers = pool.GetNumThreads();
+		const u64 now = utils::GetTimeNs();
+
+		m_lastIdleNs.resize(numWorkers, 0);
+		m_lastJobs.resize(numWorkers, 0);
+		m_frameIdleNs.resize(numWorkers, 0);
+		m_frameJobs.resize(numWorkers, 0);
+
+		for(u32 i = 0; i < numWorkers; i++)
+		{
+			const WorkerStats stats = pool.GetWorkerStats(i);
+
+			// Someone called ResetWorkerStats, start over
+			if(stats.idleTimeNs < m_lastIdleNs[i] || stats.jobsExecuted < m_lastJobs[i])
+			{
+				m_lastIdleNs[i] = stats.idleTimeNs;
+				m_lastJobs[i] = stats.jobsExecuted;
+			}
+
+			m_frameIdleNs[i] = stats.idleTimeNs - m_lastIdleNs[i];
+			m_frameJobs[i] = stats.jobsExecuted - m_lastJobs[i];
+			m_lastIdleNs[i] = stats.idleTimeNs;
+			m_lastJobs[i] = stats.jobsExecuted;
+		}
+
+		m_frameNs = m_lastFrameStartNs > 0 ? now - m_lastFrameStartNs : 0;
+		m_lastFrameStartNs = now;
+	}
+
+	void DrawSummary()
+	{
+		const f32 parallelism = m_criticalPathNs > 0 ? (f32)m_totalWorkNs / m_criticalPathNs : 0.0f;
+
+		ImGui::Text("Tasks: %u   Workers: %u", (u32)m_snapshot.nodes.size(), m_snapshot.numWorkers);
+		ImGui::Text("Total Work: %.3f ms   Critical Path: %.3f ms   Parallelism: %.2f",
+			NsToMs(m_totalWorkNs), NsToMs(m_criticalPathNs), parallelism);
+		ImGui::Text("Graph Wall Time: %.3f ms   Predicted (dependency driven): %.3f ms",
+			NsToMs(m_snapshot.wallTimeNs), NsToMs(m_predictedNs));
+
+		if(ImGui::IsItemHovered())
+		{
+			ImGui::SetTooltip("Parallelism is total work over the critical path, the most cores the graph can keep busy.");
+		}
+	}
+
+	void DrawWorkers()
+	{
+		if(ImGui::BeginTable("TASK_GRAPH_WORKERS", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+		{
+			ImGui::TableSetupColumn("Worker", ImGuiTableColumnFlags_WidthStretch);
+			ImGui::TableSetupColumn("Idle", ImGuiTableColumnFlags_WidthStretch);
+			ImGui::TableSetupColumn("Idle %", ImGuiTableColumnFlags_WidthStretch);
+			ImGui::TableSetupColumn("Jobs", ImGuiTableColumnFlags_WidthFixed, 60.0f);
+			ImGui::TableHeadersRow();
+
+			for(u32 i = 0; i < m_frameIdleNs.size(); i++)
+			{
+				const f32 idleRatio = m_frameNs > 0 ? utils::Min(1.0f, (f32)m_frameIdleNs[i] / m_frameNs) : 0.0f;
+
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::Text("Worker %u", i);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f ms", NsToMs(m_frameIdleNs[i]));
+				ImGui::TableNextColumn();
+				ImGui::ProgressBar(idleRatio, ImVec2(-1.0f, 0.0f), StringFactory::TempFormat("%.1f%%", idleRatio * 100.0f));
+				ImGui::TableNextColumn();
+				ImGui::Text("%llu", m_frameJobs[i]);
+			}
+			ImGui::EndTable();
+		}
+	}
+
+	// Live counters, they may move while a pipelined graph runs
+	void DrawTimeSlicedJobs()
+	{
+		const auto& jobs = m_pScheduler->GetTimeSlicedJobs();
+		if(jobs.empty())
+		{
+			ImGui::TextDisabled("No time sliced jobs");
+			return;
+		}
+
+		if(ImGui::BeginTable("TASK_GRAPH_TIME_SLICED", 7, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+		{
+			ImGui::TableSetupColumn("Job", ImGuiTableColumnFlags_WidthStretch);
+			ImGui::TableSetupColumn("Budget", ImGuiTableColumnFlags_WidthStretch);
+			ImGui::TableSetupColumn("Last Slice", ImGuiTableColumnFlags_WidthStretch);
+			ImGui::TableSetupColumn("Slices", ImGuiTableColumnFlags_WidthFixed, 60.0f);
+			ImGui::TableSetupColumn("Passes", ImGuiTableColumnFlags_WidthFixed, 60.0f);
+			ImGui::TableSetupColumn("Overruns", ImGuiTableColumnFlags_WidthFixed, 60.0f);
+			ImGui::TableSetupColumn("Worst Overrun", ImGuiTableColumnFlags_WidthStretch);
+			ImGui::TableHeadersRow();
+
+			for(const auto& entry : jobs)
+			{
+				const TimeSlicedJob::Stats stats = entry.job->GetStats();
+
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				if(entry.job->IsRunning())
+				{
+					ImGui::TextUnformatted(entry.name.c_str());
+				}
+				else
+				{
+					ImGui::TextDisabled("%s (idle)", entry.name.c_str());
+				}
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f ms", entry.job->GetBudgetMs());
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f ms", NsToMs(stats.lastSliceNs));
+				ImGui::TableNextColumn();
+				ImGui::Text("%llu", stats.slicesRun);
+				ImGui::TableNextColumn();
+				ImGui::Text("%llu", stats.passesCompleted);
+				ImGui::TableNextColumn();
+				ImGui::Text("%llu", stats.overrunCount);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f ms", NsToMs(stats.worstOverrunNs));
+			}
+			ImGui::EndTable();
+		}
+	}
+
+	void DrawSplitCandidates()
+	{
+		if(m_criticalPath.empty())
+		{
+			ImGui::TextDisabled("No task graph data yet");
+			return;
+		}
+
+		if(ImGui::BeginTable("TASK_GRAPH_SPLIT", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+		{
+			ImGui::TableSetupColumn("Critical Task", ImGuiTableColumnFlags_WidthStretch);
+			ImGui::TableSetupColumn("Duration", ImGuiTableColumnFlags_WidthStretch);
+			ImGui::TableSetupColumn("Share", ImGuiTableColumnFlags_WidthStretch);
+			ImGui::TableSetupColumn(StringFactory::TempFormat("Critical Path if split x%u", utils::Max(1u, m_snapshot.numWorkers)), ImGuiTableColumnFlags_WidthStretch);
+			ImGui::TableHeadersRow();
+
+			for(u64 i = 0; i < m_criticalPath.size(); i++)
+			{
+				const TaskGraphSnapshot::Node& node = m_snapshot.nodes[m_criticalPath[i]];
+				const f32 share = m_criticalPathNs > 0 ? (f32)node.durationNs / m_criticalPathNs : 0.0f;
+				const u64 savedNs = m_criticalPathNs - utils::Min(m_criticalPathNs, m_splitPredictedNs[i]);
+
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::Text("%s", node.name.c_str());
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f ms", NsToMs(node.durationNs));
+				ImGui::TableNextColumn();
+				ImGui::ProgressBar(share, ImVec2(-1.0f, 0.0f), StringFactory::TempFormat("%.1f%%", share * 100.0f));
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f ms (-%.3f ms)", NsToMs(m_splitPredictedNs[i]), NsToMs(savedNs));
+			}
+			ImGui::EndTable();
+		}
+	}
+
+	void DrawGraph()
+	{
+		const u32 numNodes = (u32)m_snapshot.nodes.size();
+
+		// One column per level, tasks stacked in graph order
+		u32 numLevels = 0;
+		for(const TaskGraphSnapshot::Node& node : m_snapshot.nodes)
+		{
+			numLevels = utils::Max(numLevels, node.level + 1);
+		}
+
+		std::vector<u32> levelRows(numLevels, 0);
+		std::vector<ImVec2> nodeOffsets(numNodes);
+		u32 maxRows = 0;
+		for(u32 i = 0; i < numNodes; i++)
+		{
+			const u32 level = m_snapshot.nodes[i].level;
+			const u32 row = levelRows[level]++;
+			maxRows = utils::Max(maxRows, row + 1);
+			nodeOffsets[i] = ImVec2(CANVAS_MARGIN + level * (NODE_WIDTH + COLUMN_SPACING), CANVAS_MARGIN + row * (NODE_HEIGHT + ROW_SPACING));
+		}
+
+		const ImVec2 canvasSize(CANVAS_MARGIN * 2 + numLevels * (NODE_WIDTH + COLUMN_SPACING), CANVAS_MARGIN * 2 + maxRows * (NODE_HEIGHT + ROW_SPACING));
+
+		if(ImGui::BeginChild("TASK_GRAPH_CANVAS", ImVec2(0.0f, 0.0f), ImGuiChildFlags_Borders, ImGuiWindowFlags_HorizontalScrollbar))
+		{
+			const ImVec2 origin = ImGui::GetCursorScreenPos();
+			ImDrawList* pDrawList = ImGui::GetWindowDrawList();
+
+			pDrawList->AddRectFilled(origin, ImVec2(origin.x + canvasSize.x, origin.y + canvasSize.y), ImGui::WithAlpha(ImGui::PASTEL_LIGHT_BLUE, 40));
+
+			u64 maxDurationNs = 1;
+			for(const TaskGraphSnapshot::Node& node : m_snapshot.nodes)
+			{
+				maxDurationNs = utils::Max(maxDurationNs, node.durationNs);
+			}
+
+			// Edges first, under the nodes. Critical path edges go on top of the rest.
+			if(m_options.bShowEdges)
+			{
+				for(u32 pass = 0; pass < 2; pass++)
+				{
+					const bool bCriticalPass = pass == 1;
+					for(u32 i = 0; i < numNodes; i++)
+					{
+						for(u32 dependency : m_snapshot.nodes[i].dependencies)
+						{
+							const bool bCriticalEdge = IsCriticalEdge(dependency, i);
+							if(bCriticalEdge != bCriticalPass)
+							{
+								continue;
+							}
+
+							const ImVec2 from(origin.x + nodeOffsets[dependency].x + NODE_WIDTH, origin.y + nodeOffsets[dependency].y + NODE_HEIGHT * 0.5f);
+							const ImVec2 to(origin.x + nodeOffsets[i].x, origin.y + nodeOffsets[i].y + NODE_HEIGHT * 0.5f);
+							const f32 bend = (to.x - from.x) * 0.5f;
+
+							const ImU32 color = bCriticalEdge ? ImGui::PASTEL_PINK : ImGui::WithAlpha(ImGui::PASTEL_LIGHT_STEEL_BLUE, 160);
+							pDrawList->AddBezierCubic(from, ImVec2(from.x + bend, from.y), ImVec2(to.x - bend, to.y), to, color, bCriticalEdge ? 3.0f : 1.0f);
+							pDrawList->AddTriangleFilled(ImVec2(to.x - 6.0f, to.y - 4.0f), ImVec2(to.x - 6.0f, to.y + 4.0f), to, color);
+						}
+					}
+				}
+			}
+
+			const ImVec2 mousePos = ImGui::GetMousePos();
+			i32 hoveredNode = -1;
+
+			for(u32 i = 0; i < numNodes; i++)
+			{
+				const TaskGraphSnapshot::Node& node = m_snapshot.nodes[i];
+				const ImVec2 p0(origin.x + nodeOffsets[i].x, origin.y + nodeOffsets[i].y);
+				const ImVec2 p1(p0.x + NODE_WIDTH, p0.y + NODE_HEIGHT);
+				const bool bCritical = m_bOnCriticalPath[i];
+
+				// Background, then a bar showing the duration against the longest task
+				const ImU32 baseColor = node.durationNs == 0 ? ImGui::WithAlpha(ImGui::PASTEL_LAVENDER, 60) : ImGui::WithAlpha(ImGui::PASTEL_LAVENDER, 110);
+				pDrawList->AddRectFilled(p0, p1, baseColor, 3.0f);
+
+				const f32 ratio = (f32)node.durationNs / maxDurationNs;
+				const ImU32 barColor = bCritical ? ImGui::WithAlpha(ImGui::PASTEL_PINK, 200) : ImGui::WithAlpha(ImGui::PASTEL_LIGHT_GREEN, 160);
+				pDrawList->AddRectFilled(ImVec2(p0.x, p1.y - 5.0f), ImVec2(p0.x + NODE_WIDTH * ratio, p1.y), barColor, 3.0f);
+
+				pDrawList->AddRect(p0, p1, bCritical ? ImGui::PASTEL_PINK : ImGui::WithAlpha(ImGui::PASTEL_LIGHT_STEEL_BLUE, 200), 3.0f, 0, bCritical ? 2.5f : 1.0f);
+
+				pDrawList->PushClipRect(p0, p1, true);
+				pDrawList->AddText(ImVec2(p0.x + 4.0f, p0.y + 2.0f), IM_COL32_WHITE, node.name.c_str());
+				const char* durationStr = node.durationNs == 0 ? "skipped" : StringFactory::TempFormat("%.3f ms", NsToMs(node.durationNs));
+				pDrawList->AddText(ImVec2(p0.x + 4.0f, p0.y + 16.0f), ImGui::WithAlpha(ImGui::PASTEL_LEMON_CHIFFON, 200), durationStr);
+				pDrawList->PopClipRect();
+
+				if(ImGui::IsWindowHovered() && mousePos.x >= p0.x && mousePos.x <= p1.x && mousePos.y >= p0.y && mousePos.y <= p1.y)
+				{
+					hoveredNode = (i32)i;
+				}
+			}
+
+			ImGui::Dummy(canvasSize);
+
+			if(hoveredNode >= 0)
+			{
+				ShowNodeTooltip((u32)hoveredNode);
+			}
+		}
+		ImGui::EndChild();
+	}
+
+	void ShowNodeTooltip(u32 nodeIndex) const
+	{
+		const TaskGraphSnapshot::Node& node = m_snapshot.nodes[nodeIndex];
+
+		ImGui::BeginTooltip();
+		ImGui::Text("%s", node.name.c_str());
+		ImGui::Separator();
+		ImGui::Text("Duration: %.3f ms", NsToMs(node.durationNs));
+		ImGui::Text("Level: %u", node.level);
+		ImGui::Text("Dependencies: %u", (u32)node.dependencies.size());
+		ImGui::Text("Priority: %s", node.priority == TaskPriority::High ? "High" : node.priority == TaskPriority::Normal ? "Normal" : "Background");
+		ImGui::Text("Affinity: %s", node.affinity == TaskAffinity::MainThread ? "Main Thread" : "Any Thread");
+		if(m_bOnCriticalPath[nodeIndex])
+		{
+			ImGui::TextColored(ImGui::ColorConvertU32ToFloat4(ImGui::PASTEL_PINK), "On the critical path");
+		}
+		ImGui::EndTooltip();
+	}
+
+	bool IsCriticalEdge(u32 from, u32 to) const
+	{
+		for(u64 i = 1; i < m_criticalPath.size(); i++)
+		{
+			if(m_criticalPath[i - 1] == from && m_criticalPath[i] == to)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	struct Options
+	{
+		bool bPaused = false;
+		bool bSmooth = true;
+		bool bShowEdges = true;
+	} m_options;
+
+	TaskSchedulerSystem* m_pScheduler = nullptr;
+
+	TaskGraphSnapshot m_snapshot;
+	std::vector<u64> m_smoothedNs;
+
+	u64 m_totalWorkNs = 0;
+	u64 m_criticalPathNs = 0;
+	u64 m_predictedNs = 0;
+	std::vector<u32> m_criticalPath;
+	std::vector<bool> m_bOnCriticalPath;
+	std::vector<u64> m_splitPredictedNs;
+
+	// Worker counters at the previous Run, and the difference over the last frame
+	std::vector<u64> m_lastIdleNs;
+	std::vector<u64> m_lastJobs;
+	std::vector<u64> m_frameIdleNs;
+	std::vector<u64> m_frameJobs;
+	u64 m_lastFrameStartNs = 0;
+	u64 m_frameNs = 0;
+};
@@ -3,13 +3,16 @@
 #include "editor/editor.h"
 #include "entity/entity.h"
 #include "game_state.h"
+#include "components/sprite2d_component.h"
 #include "gfx/frame_stats.h"
 #include "imgui/backends/imgui_impl_sdl2.h"
 #include "profiler/profiler_section.h"
+#include "utils/command_line.h"
 #include "utils/string_factory.h"
 
 GameEngine::GameEngine()
-	: m_gameState()
+	: m_taskScheduler(WorkerPlacement::FromCommandLine())
+	, m_gameState()
 #if USE_LPP
 	  , m_lppHandler()
 #endif
@@ -28,6 +31,13 @@ bool GameEngine::Run()
 
 	RegisterTasks();
 
+	// --trace[=frames] [--trace-file=path] [--trace-quit]: capture from the first frame
+	const CommandLine& commandLine = CommandLine::GetInstance();
+	if (commandLine.HasFlag("trace"))
+	{
+		m_bQuitAfterTrace = StartTraceCapture() && commandLine.HasFlag("trace-quit");
+	}
+
 	f32 deltaTime = 0.0f;
 	f32 lastUpdate = 0u;
 
@@ -36,6 +46,12 @@ bool GameEngine::Run()
 	{
 		PROFILE_FRAME_START_ALL_THREADS();
 
+		if (m_bQuitAfterTrace && !Profiler::GetInstance().IsCapturingTrace())
+		{
+			m_bIsRunning = false;
+			break;
+		}
+
 #if USE_LPP
 		{
 			PROFILE_SCOPE("LPP_SyncPoint");
@@ -52,9 +68,23 @@ bool GameEngine::Run()
 		ARENA_SAVE(&m_gameState.arenas[AT_FRAME]);
 
 		HandleInput();
-		Update(deltaTime);
+
+		m_renderingEngine.SetPipelineDepth(m_gameState.pipelineDepth);
+		if (m_renderingEngine.GetPipelineDepth() > 1)
+		{
+			UpdatePipelined(deltaTime);
+		}
+		else
+		{
+			Update(deltaTime);
+		}
 		Render();
 
+		// Simulation must be idle before the frame arena and profiler data are reset
+		m_taskScheduler.WaitForTaskGraph();
+
+		PlotFrameCounters();
+
 		// Reset Frame Arena
 		ARENA_RESET(&m_gameState.arenas[AT_FRAME]);
 	}
@@ -72,6 +102,36 @@ bool GameEngine::Run()
 	return m_bIsRunning;
 }
 
+// What the Memory Monitor shows, as profiler tracks with a history. Before the frame arena reset.
+// Time sliced overruns are a running total, the track's slope is the overrun rate.
+void GameEngine::PlotFrameCounters()
+{
+	PROFILE_PLOT("Frame Arena (KB)", BYTES_TO_KB(arena_used(&m_gameState.arenas[AT_FRAME])));
+	PROFILE_PLOT("Components Arena (KB)", BYTES_TO_KB(arena_used(&m_gameState.arenas[AT_COMPONENTS])));
+	PROFILE_PLOT("Move Components", MoveComponent::GetPool()->GetActiveCount());
+	PROFILE_PLOT("Sprite2D Components", Sprite2DComponent::GetPool()->GetActiveCount());
+	PROFILE_PLOT("AnimatedSprite Components", AnimatedSpriteComponent::GetPool()->GetActiveCount());
+	PROFILE_PLOT("Time Sliced Overruns", m_taskScheduler.GetTotalBudgetOverruns());
+}
+
+template<typename T>
+static PoolUsage GetPoolUsage(const Pool<T>* pPool)
+{
+	return { pPool->GetCapacity(), pPool->GetActiveCount(), pPool->GetUsagePercentage() };
+}
+
+// Only while the task graph is idle, see GameState::memory
+void GameEngine::CaptureMemoryUsage()
+{
+	for (u32 i = 0; i < AT_COUNT; i++)
+	{
+		m_gameState.memory.arenas[i] = arena_get_stats(&m_gameState.arenas[i]);
+	}
+	m_gameState.memory.moveComponents = GetPoolUsage(MoveComponent::GetPool());
+	m_gameState.memory.sprite2DComponents = GetPoolUsage(Sprite2DComponent::GetPool());
+	m_gameState.memory.animatedSpriteComponents = GetPoolUsage(AnimatedSpriteComponent::GetPool());
+}
+
 void GameEngine::InitGameState()
 {
 	m_gameState.arenas[AT_GLOBAL] = arena_create(KILOBYTES(24));
@@ -89,6 +149,9 @@ void GameEngine::InitCoreSubsystems()
 
 	frame_stats_init(g_frameStats, m_gameState.arenas[AT_GLOBAL]);
 
+	Profiler::GetInstance().SetHistorySize(CommandLine::GetInstance().GetU32("profiler-history", Profiler::DEFAULT_HISTORY_SIZE));
+	Profiler::GetInstance().SetHwCountersEnabled(CommandLine::GetInstance().HasFlag("profiler-hw"));
+
 	Entity::Init(&m_gameState.arenas[AT_COMPONENTS]);
 	MoveComponent::Init(&m_gameState.arenas[AT_COMPONENTS]);
 	AnimatedSpriteComponent::Init(&m_gameState.arenas[AT_COMPONENTS]);
@@ -114,7 +177,7 @@ void GameEngine::InitGame()
 	m_lppHandler.InitSynchedAgent();
 #endif
 
-	m_editor.Init(&m_gameState, &m_renderingEngine);
+	m_editor.Init(&m_gameState, &m_renderingEngine, &m_taskScheduler);
 
 	m_renderingEngine.Init(m_gameState);
 
@@ -127,49 +190,101 @@ void GameEngine::InitGame()
 
 void GameEngine::RegisterTasks()
 {
+	// Dependencies are inferred from the declared accesses, in registration order.
 	auto clearRenderTask = m_taskScheduler.CreateTask("ClearRenderCommand List", [this](float deltaTime) {
+		TASK_ACCESS_WRITE(RenderCommand);
 		m_renderingEngine.ClearRenderCommands();
-		});
+		}, TaskPriority::High);
+
+	clearRenderTask->DeclareAccess({ Write<RenderCommand>() });
 
 	auto moveTask = m_taskScheduler.CreateTask("MoveComponent Pool", [this](float deltaTime) {
 		// Rotate Sprites
-		Pool<MoveComponent>* pMovePool = MoveComponent::GetPool();
+		Pool<MoveComponent>* pMovePool = WritePool<MoveComponent>();
 		AssertMsg(pMovePool, "Call MoveComponent::InitPool() first");
 		for(MoveComponent& moveComp : *pMovePool)
 		{
 			// moveComp.Update(deltaTime);
 		}
-		});
+		}, TaskPriority::High);
 
-	moveTask->AddDependency(clearRenderTask);
+	moveTask->DeclareAccess({ Write<MoveComponent>() });
 
-	auto pushRenderTask = m_taskScheduler.CreateTask("AnimatedSpriteComponent Pool", [this](float deltaTime) {
-		Pool<AnimatedSpriteComponent>* pAnimSpritePool = AnimatedSpriteComponent::GetPool();
-		AssertMsg(pAnimSpritePool, "Call MoveComponent::InitPool() first");
-		RenderCommand cmd;
-		for(AnimatedSpriteComponent& comp : *pAnimSpritePool)
-		{
-			comp.GetSpriteNonConst().Update(deltaTime);
+	// Sprites are split in chunks: each chunk updates its sprites and counts the commands it will push,
+	// the counts are scanned into write offsets, then every chunk fills its own slice of one command list.
+	auto pushRenderTask = m_taskScheduler.CreateCoroutineTask("AnimatedSpriteComponent Pool", [this](float deltaTime) -> Task<void> {
+		static constexpr u32 SPRITE_CHUNK_SIZE = 1024;
 
-			// Get the entity this component belongs to
-			Entity* pEntity = Entity::GetPool()->Get(comp.GetEntityId());
-			if(!pEntity) continue;
-
-			MoveComponent* pMoveComp = pEntity->GetMoveComponent();
-			if(!pMoveComp) continue;
+		Pool<AnimatedSpriteComponent>* pAnimSpritePool = WritePool<AnimatedSpriteComponent>();
+		AssertMsg(pAnimSpritePool, "Call MoveComponent::InitPool() first");
+		const Pool<Entity>* pEntityPool = ReadPool<Entity>();
+		TASK_ACCESS_READ(MoveComponent);
+		TASK_ACCESS_WRITE(RenderCommand);
+
+		ThreadPool& pool = m_taskScheduler.GetThreadPool();
+		const u32 numSlots = pAnimSpritePool->GetCapacity();
+		const u32 numChunks = (numSlots + SPRITE_CHUNK_SIZE - 1) / SPRITE_CHUNK_SIZE;
+
+		auto getMoveComponent = [pEntityPool](const AnimatedSpriteComponent& comp) -> MoveComponent* {
+			const Entity* pEntity = pEntityPool->Get(comp.GetEntityId());
+			return pEntity ? pEntity->GetMoveComponent() : nullptr;
+		};
+
+		std::vector<u32> chunkCounts(numChunks, 0);
+		co_await ParallelFor(pool, numChunks, 1, [&](u32 begin, u32 end) {
+			PROFILE_SCOPE_HW("Sprite Update Chunks");
+			for (u32 chunk = begin; chunk < end; chunk++)
+			{
+				const u32 lastSlot = utils::Min(numSlots, (chunk + 1) * SPRITE_CHUNK_SIZE);
+				for (u32 slot = chunk * SPRITE_CHUNK_SIZE; slot < lastSlot; slot++)
+				{
+					AnimatedSpriteComponent* pComp = pAnimSpritePool->GetSlot(slot);
+					if (!pComp) continue;
+
+					pComp->GetSpriteNonConst().Update(deltaTime);
+					if (getMoveComponent(*pComp))
+					{
+						chunkCounts[chunk]++;
+					}
+				}
+			}
+		});
 
-			cmd.frame = comp.GetSprite().GetCurrentFrame();
-			cmd.textureId = comp.GetSprite().GetTextureID();
+		std::vector<u32> chunkOffsets(numChunks, 0);
+		const u32 numCommands = co_await ParallelExclusiveScan(pool, chunkCounts.data(), chunkOffsets.data(), numChunks, 256, 0u,
+			[](const u32& a, const u32& b) { return a + b; });
 
-			cmd.position = pMoveComp->GetPosition();
-			cmd.rotation = pMoveComp->GetRotation();
-			m_renderingEngine.PushRenderCommand(cmd);
-		}
+		RenderCommand* pCommands = m_renderingEngine.AllocateRenderCommands(numCommands);
+		co_await ParallelFor(pool, numChunks, 1, [&](u32 begin, u32 end) {
+			PROFILE_SCOPE_HW("Sprite Command Chunks");
+			for (u32 chunk = begin; chunk < end; chunk++)
+			{
+				RenderCommand* pCmd = pCommands + chunkOffsets[chunk];
+				const u32 lastSlot = utils::Min(numSlots, (chunk + 1) * SPRITE_CHUNK_SIZE);
+				for (u32 slot = chunk * SPRITE_CHUNK_SIZE; slot < lastSlot; slot++)
+				{
+					const AnimatedSpriteComponent* pComp = pAnimSpritePool->GetSlot(slot);
+					if (!pComp) continue;
+
+					const MoveComponent* pMoveComp = getMoveComponent(*pComp);
+					if (!pMoveComp) continue;
+
+					pCmd->frame = pComp->GetSprite().GetCurrentFrame();
+					pCmd->textureId = pComp->GetSprite().GetTextureID();
+					pCmd->position = pMoveComp->GetPosition();
+					pCmd->rotation = pMoveComp->GetRotation();
+					pCmd++;
+				}
+			}
 		});
+		}, TaskPriority::High);
 
-	pushRenderTask->AddDependency(clearRenderTask);
-	pushRenderTask->AddDependency(moveTask);
-
+	pushRenderTask->DeclareAccess({
+		Read<Entity>(),
+		Read<MoveComponent>(),
+		Write<AnimatedSpriteComponent>(),
+		Write<RenderCommand>()
+	});
 
 	m_taskScheduler.CreateExecutionPlan();
 }
@@ -210,6 +325,10 @@ void GameEngine::HandleInput()
 			{
 				CycleRuntimeMode();
 			}
+			if(event.key.keysym.sym == SDLK_F9)
+			{
+				StartTraceCapture();
+			}
 			break;
 		default: break;
 		}
@@ -226,6 +345,29 @@ void GameEngine::Update(float deltaTime)
 
 	// TASK_GRAPH
 	m_taskScheduler.ExecuteTaskGraph(deltaTime);
+	m_taskScheduler.ExecuteMainThreadTasks();
+	m_renderingEngine.SwapRenderCommandBuffers();
+	CaptureMemoryUsage();
+
+	m_editor.Update(deltaTime);
+}
+
+// Render draws the commands of the previous simulation frame while the task graph
+// fills the other list on the workers. Waited on at the end of the frame.
+void GameEngine::UpdatePipelined(float deltaTime)
+{
+	PROFILE();
+
+	frame_stats_update(g_frameStats, deltaTime);
+
+	m_renderingEngine.SwapRenderCommandBuffers();
+
+	// Last chance before the graph runs alongside the editor, which draws frame N's memory usage
+	CaptureMemoryUsage();
+
+	// TASK_GRAPH
+	m_taskScheduler.BeginTaskGraph(deltaTime);
+	m_taskScheduler.ExecuteMainThreadTasks();
 
 	m_editor.Update(deltaTime);
 }
@@ -258,3 +400,18 @@ void GameEngine::CycleRuntimeMode()
 {
 	m_runtimeMode = ++m_runtimeMode % (u8)RuntimeMode::Count;
 }
+
+bool GameEngine::StartTraceCapture()
+{
+#if PROFILER_ENABLED
+	const CommandLine& commandLine = CommandLine::GetInstance();
+	const u32 numFrames = commandLine.GetU32("trace", ProfilerTraceCapture::DEFAULT_NUM_FRAMES);
+	const char* pPath = commandLine.GetString("trace-file");
+	Profiler::GetInstance().StartTraceCapture(numFrames, pPath ? pPath : ProfilerTrace::MakeDefaultPath());
+	return true;
+#else
+	// Nothing is recorded or published, the capture would never complete
+	LOG_WARNING("Profiler: built with PROFILER_ENABLED 0, no trace to capture");
+	return false;
+#endif
+}
@@ -32,11 +32,16 @@ private:
 
 	void HandleInput();
 	void Update(float deltaTime);
+	void UpdatePipelined(float deltaTime);
 	void Render();
+	void PlotFrameCounters();
+	void CaptureMemoryUsage();
 
 	void ShutdownGameState();
 
 	void CycleRuntimeMode();
+	// False when the profiler is compiled out
+	bool StartTraceCapture();
 
 	RuntimeMode GetRuntimeMode() const { return (RuntimeMode) m_runtimeMode; }
 	bool IsEditorRuntimeMode() const { return GetRuntimeMode() == RuntimeMode::Editor; }
@@ -59,4 +64,6 @@ private:
 	u8 m_runtimeMode;
 
 	bool m_bIsRunning = false;
+	// --trace-quit: CI runs exit once the startup trace is written
+	bool m_bQuitAfterTrace = false;
 };
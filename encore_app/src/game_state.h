@@ -16,6 +16,14 @@ enum eArenaTypes
 	AT_COUNT
 };
 
+// One component pool's occupancy, see GameState::memory
+struct PoolUsage
+{
+	u32 capacity = 0;
+	u32 activeCount = 0;
+	f32 usagePercent = 0.0f;
+};
+
 struct GameState
 {
 	// Memory Arenas
@@ -38,6 +46,8 @@ struct GameState
 		bool bProfiler = true;
 		bool bPerformanceMonitor = true;
 		bool bMemoryMonitor = true;
+		bool bTaskGraph = false;
+		bool bFlameGraph = false;
 		bool bDemoWindow = false;
 	} widgets;
 
@@ -48,6 +58,20 @@ struct GameState
 	i32 framebufferWidth = 800;
 	i32 framebufferHeight = 600;
 
+	// Arena and pool usage, captured by GameEngine while the task graph is idle. The editor draws
+	// this rather than the live arenas and pools, which frame N+1's graph mutates in pipelined mode.
+	struct
+	{
+		ArenaStats arenas[AT_COUNT] = {};
+		PoolUsage moveComponents;
+		PoolUsage sprite2DComponents;
+		PoolUsage animatedSpriteComponents;
+	} memory;
+
+	// Frame pipelining, 1 runs simulation and rendering back to back.
+	// 2 simulates frame N+1 on the workers while the main thread renders frame N (one frame of latency).
+	u32 pipelineDepth = 1;
+
 	// Global
 	bool bShowInGameImGui = true;
 };
@@ -2,9 +2,11 @@
 
 #include "core/core_minimal.h"
 
-#include <thread>
-#include <queue>
+#include "containers/ring_queue.h"
+#include "profiler/profiler_lock.h"
+
 #include <mutex>
+#include <thread>
 
 struct RenderCommand
 {
@@ -22,7 +24,10 @@ public:
 
 	~RenderSystem()
 	{
-		m_bShouldStop = true;
+		{
+			std::lock_guard<ProfiledMutex> lock(m_renderMutex);
+			m_bShouldStop = true;
+		}
 		m_renderCondition.notify_all();
 
 		if(m_renderThread.joinable())
@@ -31,9 +36,19 @@ public:
 		}
 	}
 
+	// Main thread. Commands run on the render thread at the next Present, or earlier when
+	// a whole queue piles up: the render thread is woken to drain it and we wait for room.
 	void SubmitRenderCommand(const RenderCommand& cmd)
 	{
-
+		while(!m_commandQueue.TryPush(cmd))
+		{
+			{
+				std::lock_guard<ProfiledMutex> lock(m_renderMutex);
+				m_bDrainRequested = true;
+			}
+			m_renderCondition.notify_one();
+			std::this_thread::yield();
+		}
 	}
 
 	void ClearScreen()
@@ -46,47 +61,49 @@ public:
 	void Present()
 	{
 		{
-			std::lock_guard<std::mutex> lock(m_renderMutex);
+			std::lock_guard<ProfiledMutex> lock(m_renderMutex);
 			m_bPresentRequested = true;
 		}
 		m_renderCondition.notify_one();
 
-		std::unique_lock<std::mutex> lock(m_presentMutex);
+		ProfiledUniqueLock lock(m_presentMutex);
 		m_presentCondition.wait(lock, [this]() { return !m_bPresentRequested; });
 	}
 
 private:
 	void RenderLoop()
 	{
-		while(!m_bShouldStop)
+		while(true)
 		{
-			std::unique_lock<std::mutex> lock(m_renderMutex);
-			m_renderCondition.wait(lock, [this] { return m_bShouldStop || !m_bPresentRequested; });
+			bool bPresent = false;
+			{
+				ProfiledUniqueLock lock(m_renderMutex);
+				m_renderCondition.wait(lock, [this] { return m_bShouldStop || m_bPresentRequested || m_bDrainRequested; });
 
-			if(m_bShouldStop) { break; }
+				if(m_bShouldStop) { break; }
 
-			while(!m_commandQueue.empty())
-			{
-				RenderCommand cmd = m_commandQueue.front();
-				m_commandQueue.pop();
+				// A present requested after this point waits for the next wake up, so it
+				// can't blit before the commands submitted ahead of it have run
+				bPresent = m_bPresentRequested;
+				m_bDrainRequested = false;
+			}
 
-				lock.unlock();
+			// The queue needs no lock, the mutex only carries the wake up and present handshake
+			RenderCommand cmd;
+			while(m_commandQueue.TryPop(cmd))
+			{
 				ExecuteRenderCommand(cmd);
-				lock.lock();
 			}
 
+			if(bPresent)
 			{
-				std::lock_guard<std::mutex> presentLock(m_presentMutex);
-				if(m_bPresentRequested)
-				{
-					lock.unlock();
-
-					// SDL_RenderPresent(); // Blit
+				// SDL_RenderPresent(); // Blit
 
+				{
+					std::lock_guard<ProfiledMutex> presentLock(m_presentMutex);
 					m_bPresentRequested = false;
-					m_presentCondition.notify_one();
-					lock.lock();
 				}
+				m_presentCondition.notify_one();
 			}
 		}
 	}
@@ -95,14 +112,18 @@ private:
 	{}
 
 
+	static constexpr u32 COMMAND_QUEUE_CAPACITY = 4096;
+
 	std::thread m_renderThread;
-	std::queue<RenderCommand> m_commandQueue;
-	std::mutex m_renderMutex;
-	std::condition_variable m_renderCondition;
+	// Main thread pushes, render thread pops
+	SpscRingQueue<RenderCommand, COMMAND_QUEUE_CAPACITY> m_commandQueue;
+	ProfiledMutex m_renderMutex{ "Render" };
+	ProfiledConditionVariable m_renderCondition;
 	std::atomic<bool> m_bShouldStop;
+	bool m_bDrainRequested = false;		// queue filled up before the next Present
 
 	// Present Sync
-	std::mutex m_presentMutex;
-	std::condition_variable m_presentCondition;
+	ProfiledMutex m_presentMutex{ "Render Present" };
+	ProfiledConditionVariable m_presentCondition;
 	bool m_bPresentRequested = false;
 };
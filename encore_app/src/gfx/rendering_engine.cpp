@@ -6,6 +6,7 @@
 #include "imgui/backends/imgui_impl_sdl2.h"
 #include "profiler/profiler.h"
 #include "profiler/profiler_section.h"
+#include "utils/utils_math.h"
 #include "utils/utils_path.h"
 
 RenderingEngine::RenderingEngine()
@@ -17,7 +18,10 @@ void RenderingEngine::Init(GameState& rGameState)
 {
 	m_spriteRenderer.Init();
 
-	m_renderCommands.reserve(100'000);
+	for (std::vector<RenderCommand>& renderCommands : m_renderCommandBuffers)
+	{
+		renderCommands.reserve(100'000);
+	}
 
 	CreateFramebuffer(rGameState);
 }
@@ -94,12 +98,40 @@ void RenderingEngine::EndFrame_ImGui()
 
 void RenderingEngine::PushRenderCommand(RenderCommand cmd)
 {
-	m_renderCommands.push_back(cmd);
+	m_renderCommandBuffers[m_writeBufferIndex].push_back(cmd);
+}
+
+RenderCommand* RenderingEngine::AllocateRenderCommands(u32 count)
+{
+	std::vector<RenderCommand>& renderCommands = m_renderCommandBuffers[m_writeBufferIndex];
+	const u64 first = renderCommands.size();
+	renderCommands.resize(first + count);
+	return renderCommands.data() + first;
 }
 
 void RenderingEngine::ClearRenderCommands()
 {
-	m_renderCommands.clear();
+	m_renderCommandBuffers[m_writeBufferIndex].clear();
+}
+
+void RenderingEngine::SwapRenderCommandBuffers()
+{
+	m_readBufferIndex = m_writeBufferIndex;
+	m_writeBufferIndex = (m_writeBufferIndex + 1) % m_pipelineDepth;
+}
+
+void RenderingEngine::SetPipelineDepth(u32 depth)
+{
+	depth = utils::Clamp(depth, 1u, MAX_PIPELINE_DEPTH);
+	if (depth == m_pipelineDepth)
+	{
+		return;
+	}
+
+	// The next swap hands the last completed list to the renderer again, the simulation then
+	// fills the one after it. Pointing the write index past it would draw a list nobody filled yet.
+	m_pipelineDepth = depth;
+	m_writeBufferIndex = m_readBufferIndex;
 }
 
 void RenderingEngine::ResizeFramebuffer(GameState& rGameState, i32 width, i32 height)
@@ -134,7 +166,7 @@ void RenderingEngine::RenderScene(GameState& rGameState, Camera2D& camera)
 	m_spriteRenderer.DrawSprite({0, 0}, {2000, 2000}, 0, {0.1f, 0.1f, 0.2f, 1.0f});
 
 	// Draw all sprites
-	for (const RenderCommand& cmd : m_renderCommands)
+	for (const RenderCommand& cmd : m_renderCommandBuffers[m_readBufferIndex])
 	{
 		m_spriteRenderer.DrawSprite(cmd.position, cmd.rotation, cmd.frame, cmd.textureId, Vec2(64, 64), Vec4(1));
 	}
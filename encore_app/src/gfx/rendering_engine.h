@@ -19,6 +19,10 @@ struct RenderCommand
 class RenderingEngine
 {
 public:
+	// Render command lists in flight. Depth 1 renders what the simulation just produced,
+	// depth 2 lets the simulation fill one list while the renderer draws the other.
+	static constexpr u32 MAX_PIPELINE_DEPTH = 2;
+
 	RenderingEngine();
 
 	void Init(GameState& rGameState);
@@ -30,8 +34,16 @@ public:
 	void EndFrame_ImGui();
 
 	void PushRenderCommand(RenderCommand cmd);
+	// Grows the write list by count and returns the first new command, for filling from several threads
+	// at precomputed offsets. Call it from one thread, before the writers start.
+	RenderCommand* AllocateRenderCommands(u32 count);
 	void ClearRenderCommands();
 
+	// Hands the list the simulation just filled over to the renderer. Main thread, simulation idle.
+	void SwapRenderCommandBuffers();
+	void SetPipelineDepth(u32 depth);
+	u32 GetPipelineDepth() const { return m_pipelineDepth; }
+
 	void ResizeFramebuffer(GameState& rGameState, i32 width, i32 height);
 
 private:
@@ -43,7 +55,11 @@ private:
 
 private:
 	SpriteBatchRenderer m_spriteRenderer;
-	std::vector<RenderCommand> m_renderCommands;
+	// Written by the simulation through m_writeBufferIndex, drawn from m_readBufferIndex
+	std::vector<RenderCommand> m_renderCommandBuffers[MAX_PIPELINE_DEPTH];
+	u32 m_pipelineDepth = 1;
+	u32 m_writeBufferIndex = 0;
+	u32 m_readBufferIndex = 0;
 
 	Spritesheet m_tileset;
 	AnimatedSprite m_animSprite;
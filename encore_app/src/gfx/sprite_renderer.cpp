@@ -1,6 +1,7 @@
 #include "sprite_renderer.h"
 
 #include "assets/texture_manager.h"
+#include "profiler/profiler.h"
 
 void SpriteBatchRenderer::Init()
 {
@@ -451,6 +452,8 @@ void SpriteBatchRenderer::Flush()
 
 	m_renderStats.drawCalls++;
 	m_renderStats.verticesDrawn += static_cast<u32>(m_vertices.size());
+	PROFILE_COUNTER("Draw Calls", 1);
+	PROFILE_COUNTER("Sprites Drawn", spriteCount);
 
 	// Reset for next batch
 	m_vertices.clear();
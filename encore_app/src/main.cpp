@@ -1,6 +1,7 @@
 #include "core/core_minimal.h"
 
 #include "game_engine.h"
+#include "utils/command_line.h"
 
 #define TEST 0
 #if TEST
@@ -19,6 +20,8 @@ namespace StubWorkload {
 
 i32 main(i32 argc, char* argv[])
 {
+	CommandLine::GetInstance().Init(argc, argv);
+
 	GameEngine engine;
 	return engine.Run();
 }
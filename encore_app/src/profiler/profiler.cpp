@@ -1,51 +1,623 @@
 #include "profiler.h"
 
 #include "utils/string_factory.h"
+#include "utils/utils_math.h"
 
-#include <chrono>
+#include <algorithm>
+#include <cstring>
 
 // Define the thread_local static member
 thread_local ProfilerThreadData* Profiler::tl_threadData = nullptr;
 
-u32 Profiler::BeginSection(const char* section_name)
+void Profiler::ClearCurrentThread()
 {
-	ProfilerThreadData* data = GetOrCreateThreadData();
-	auto threadId = std::this_thread::get_id();
+	ProfilerThreadData* pData = GetOrCreateThreadData();
+	PublishThread(*pData);
+	PublishThreadCounters(*pData);
+	PublishThreadHwSamples(*pData);
+	PublishThreadJobs(*pData);
 
-	data->entries.emplace_back(section_name, GetTimeUs(), 0, data->depth++, threadId);
-	return (u32)(data->entries.size() - 1);
+	std::lock_guard<ProfiledMutex> lock(m_threadDataMutex);
+	std::swap(pData->lastEntries, pData->publishEntries);
+	std::swap(pData->lastCounters, pData->publishCounters);
+	std::swap(pData->lastHwSamples, pData->publishHwSamples);
+	std::swap(pData->lastJobs, pData->publishJobs);
 }
 
-void Profiler::EndSection(u32 timerId)
+void Profiler::ClearAllThreads()
 {
-	ProfilerThreadData* data = GetOrCreateThreadData();
+	const u64 publishNs = ProfilerClock::ToNs(ProfilerClock::Now());
+
+	const u32 numThreads = GetNumThreads();
+	for(u32 i = 0; i < numThreads; i++)
+	{
+		PublishThread(*m_threads[i]);
+		PublishThreadCounters(*m_threads[i]);
+		PublishThreadHwSamples(*m_threads[i]);
+		PublishThreadJobs(*m_threads[i]);
+	}
+
+	// Only pointer swaps under the lock
+	{
+		std::lock_guard<ProfiledMutex> lock(m_threadDataMutex);
+		for(u32 i = 0; i < numThreads; i++)
+		{
+			std::swap(m_threads[i]->lastEntries, m_threads[i]->publishEntries);
+			std::swap(m_threads[i]->lastCounters, m_threads[i]->publishCounters);
+			std::swap(m_threads[i]->lastHwSamples, m_threads[i]->publishHwSamples);
+			std::swap(m_threads[i]->lastJobs, m_threads[i]->publishJobs);
+		}
+	}
+
+	RecordFrameCounters();
+	RecordHwScopeStats();
+	RecordJobHistograms();
+
+	// The frame that just ended: scopes published now, timed from the previous publish
+	const u64 frameStartNs = m_lastPublishNs;
+	m_lastPublishNs = publishNs;
+	if(frameStartNs != 0)
+	{
+		const u64 frameIndex = m_numPublishedFrames++;
+		RecordHistoryFrame(frameIndex, frameStartNs, publishNs);
+		RecordSectionStats(frameIndex);
+	}
 
-	if(timerId < data->entries.size())
+	if(m_pTraceCapture)
 	{
-		data->depth--;
-		data->entries[timerId].duration = GetTimeUs() - data->entries[timerId].timestamp;
+		RecordTraceFrame(frameStartNs != 0 ? frameStartNs : publishNs, publishNs);
 	}
 }
 
-void Profiler::ClearCurrentThread()
+void Profiler::SetHistorySize(u32 numFrames)
 {
-	ProfilerThreadData* data = GetOrCreateThreadData();
-	data->depth = 0;
-	data->lastEntries = data->entries;
-	data->entries.clear();
+	m_history.clear();
+	m_history.resize(numFrames);
+	m_historyHead = 0;
+	m_numHistoryFrames = 0;
 }
 
-void Profiler::ClearAllThreads()
+const ProfilerFrame& Profiler::GetHistoryFrame(u32 index) const
+{
+	Assert(index < m_numHistoryFrames);
+	return m_history[(m_historyHead + index) % m_history.size()];
+}
+
+const ProfilerFrame* Profiler::FindHistoryFrame(u64 frameIndex) const
+{
+	if(m_numHistoryFrames == 0)
+	{
+		return nullptr;
+	}
+
+	// Frame indices are consecutive in the ring
+	const u64 oldestIndex = GetHistoryFrame(0).frameIndex;
+	if(frameIndex < oldestIndex || frameIndex - oldestIndex >= m_numHistoryFrames)
+	{
+		return nullptr;
+	}
+	return &GetHistoryFrame((u32)(frameIndex - oldestIndex));
+}
+
+void Profiler::RecordHistoryFrame(u64 frameIndex, u64 frameStartNs, u64 frameEndNs)
+{
+	if(m_history.empty())
+	{
+		return;
+	}
+
+	const u32 historySize = (u32)m_history.size();
+	u32 slot;
+	if(m_numHistoryFrames < historySize)
+	{
+		slot = (m_historyHead + m_numHistoryFrames++) % historySize;
+	}
+	else
+	{
+		slot = m_historyHead;
+		m_historyHead = (m_historyHead + 1) % historySize;
+	}
+
+	ProfilerFrame& rFrame = m_history[slot];
+	rFrame.frameIndex = frameIndex;
+	rFrame.startNs = frameStartNs;
+	rFrame.durationNs = frameEndNs - frameStartNs;
+	rFrame.entries.clear();
+
+	const u32 numThreads = GetNumThreads();
+	for(u32 i = 0; i < numThreads; i++)
+	{
+		const std::vector<ProfilerEntry>& lastEntries = m_threads[i]->lastEntries;
+		rFrame.entries.insert(rFrame.entries.end(), lastEntries.begin(), lastEntries.end());
+	}
+
+	rFrame.counterSamples.clear();
+	for(u32 i = 0; i < numThreads; i++)
+	{
+		const std::vector<ProfilerCounterSample>& lastCounters = m_threads[i]->lastCounters;
+		rFrame.counterSamples.insert(rFrame.counterSamples.end(), lastCounters.begin(), lastCounters.end());
+	}
+	rFrame.counters = m_frameCounters;
+
+	rFrame.jobs.clear();
+	for(u32 i = 0; i < numThreads; i++)
+	{
+		const std::vector<ProfilerJobFlow>& lastJobs = m_threads[i]->lastJobs;
+		rFrame.jobs.insert(rFrame.jobs.end(), lastJobs.begin(), lastJobs.end());
+	}
+
+	// Median of the frames before it, a spike doesn't raise its own bar
+	const u32 numPrevious = utils::Min(m_numHistoryFrames - 1, SPIKE_WINDOW);
+	rFrame.bSpike = false;
+	if(numPrevious >= SPIKE_WINDOW / 4)
+	{
+		u64 durations[SPIKE_WINDOW];
+		for(u32 i = 0; i < numPrevious; i++)
+		{
+			durations[i] = GetHistoryFrame(m_numHistoryFrames - 2 - i).durationNs;
+		}
+		std::nth_element(durations, durations + numPrevious / 2, durations + numPrevious);
+		rFrame.bSpike = (f32)rFrame.durationNs > (f32)durations[numPrevious / 2] * m_spikeFactor;
+	}
+}
+
+void Profiler::StartTraceCapture(u32 numFrames, const std::string& path)
+{
+	if(m_pTraceCapture)
+	{
+		LOG_WARNING("Profiler: dropping the trace capture to '%s'", m_pTraceCapture->path.c_str());
+	}
+
+	m_pTraceCapture = std::make_unique<ProfilerTraceCapture>();
+	m_pTraceCapture->path = path;
+	m_pTraceCapture->numFrames = utils::Max(1u, numFrames);
+	ProfilerLocks::GetStats(m_pTraceCapture->lockStats);
+	LOG_INFO("Profiler: capturing %u frames to '%s'", m_pTraceCapture->numFrames, path.c_str());
+}
+
+// Only the publishing thread writes lastEntries, no lock needed to read them here
+void Profiler::RecordTraceFrame(u64 lastPublishNs, u64 publishNs)
+{
+	ProfilerTrace& rTrace = m_pTraceCapture->trace;
+	rTrace.frameStartNs.push_back(publishNs);
+
+	const u32 numThreads = GetNumThreads();
+	for(u32 i = 0; i < numThreads; i++)
+	{
+		const std::vector<ProfilerEntry>& lastEntries = m_threads[i]->lastEntries;
+		rTrace.entries.insert(rTrace.entries.end(), lastEntries.begin(), lastEntries.end());
+
+		for(const ProfilerCounterSample& sample : m_threads[i]->lastCounters)
+		{
+			if(sample.kind == ProfilerCounterKind::Plot)
+			{
+				rTrace.counterSamples.push_back(sample);
+			}
+		}
+
+		const std::vector<ProfilerJobFlow>& lastJobs = m_threads[i]->lastJobs;
+		rTrace.jobs.insert(rTrace.jobs.end(), lastJobs.begin(), lastJobs.end());
+	}
+
+	// Counters hold their frame total from the start of the frame
+	for(const ProfilerCounterValue& counter : m_frameCounters)
+	{
+		if(counter.kind == ProfilerCounterKind::Counter)
+		{
+			rTrace.counterSamples.push_back({ counter.name, lastPublishNs, counter.value, counter.kind });
+		}
+	}
+
+	// Lock totals since the previous frame, locks created since start from zero
+	std::vector<ProfilerLockStats> lockStats;
+	ProfilerLocks::GetStats(lockStats);
+	for(const ProfilerLockStats& stats : lockStats)
+	{
+		ProfilerLockStats previous;
+		auto it = std::find_if(m_pTraceCapture->lockStats.begin(), m_pTraceCapture->lockStats.end(),
+			[&stats](const ProfilerLockStats& other) { return other.lockId == stats.lockId; });
+		if(it != m_pTraceCapture->lockStats.end())
+		{
+			previous = *it;
+		}
+		rTrace.lockSamples.push_back({ stats.name, lastPublishNs, stats.contentions - previous.contentions,
+			stats.waitNs - previous.waitNs, stats.holdNs - previous.holdNs });
+	}
+	m_pTraceCapture->lockStats = std::move(lockStats);
+
+	if(!m_pTraceCapture->IsComplete())
+	{
+		return;
+	}
+
+	for(u32 i = 0; i < numThreads; i++)
+	{
+		rTrace.threadNames.emplace_back((u8)i, GetThreadName((u8)i));
+	}
+
+	const bool bWritten = rTrace.WriteChromeJson(m_pTraceCapture->path);
+	m_lastTracePath = bWritten ? m_pTraceCapture->path : std::string();
+	m_pTraceCapture.reset();
+}
+
+void Profiler::SetStatsWindow(u32 numFrames)
+{
+	m_statsWindow = utils::Min(numFrames, MAX_STATS_WINDOW);
+
+	const u32 numThreads = GetNumThreads();
+	for(u32 i = 0; i < numThreads; i++)
+	{
+		m_threads[i]->sectionSamples.clear();
+	}
+}
+
+void Profiler::RecordSectionStats(u64 frameIndex)
+{
+	if(m_statsWindow == 0)
+	{
+		return;
+	}
+
+	const u32 numThreads = GetNumThreads();
+	for(u32 i = 0; i < numThreads; i++)
+	{
+		ProfilerThreadData& rData = *m_threads[i];
+		for(const ProfilerEntry& entry : rData.lastEntries)
+		{
+			const std::string_view section(entry.GetName());
+
+			auto it = rData.sectionSamples.find(section);
+			if(it == rData.sectionSamples.end())
+			{
+				it = rData.sectionSamples.emplace(std::string(section), ProfilerSectionSamples()).first;
+			}
+			it->second.Add(frameIndex, entry.duration, m_statsWindow);
+		}
+	}
+}
+
+bool Profiler::ComputeSectionStats(const ProfilerSectionSamples& samples, ProfilerSectionStats& rOutStats) const
+{
+	// Samples of frames that slid out of the window don't count
+	const u64 firstFrame = m_numPublishedFrames > m_statsWindow ? m_numPublishedFrames - m_statsWindow : 0;
+
+	u64 values[MAX_STATS_WINDOW];
+	u32 numValues = 0;
+	u64 totalNs = 0;
+	u64 totalCalls = 0;
+	for(const ProfilerSectionSamples::Sample& sample : samples.samples)
+	{
+		if(sample.frameIndex >= firstFrame && numValues < MAX_STATS_WINDOW)
+		{
+			values[numValues++] = sample.ns;
+			totalNs += sample.ns;
+			totalCalls += sample.calls;
+		}
+	}
+
+	if(numValues == 0)
+	{
+		return false;
+	}
+
+	std::sort(values, values + numValues);
+
+	// Nearest rank
+	auto percentile = [&](u32 percent) {
+		const u32 rank = (numValues * percent + 99) / 100;
+		return values[utils::Max(1u, rank) - 1];
+	};
+
+	rOutStats.numFrames = numValues;
+	rOutStats.callsPerFrame = (f32)totalCalls / (f32)numValues;
+	rOutStats.minNs = values[0];
+	rOutStats.maxNs = values[numValues - 1];
+	rOutStats.avgNs = totalNs / numValues;
+	rOutStats.p95Ns = percentile(95);
+	rOutStats.p99Ns = percentile(99);
+	rOutStats.lastNs = samples.samples[samples.last].ns;
+	return true;
+}
+
+void Profiler::GetSectionStats(std::vector<ProfilerSectionStats>& rOutStats) const
+{
+	rOutStats.clear();
+
+	const u32 numThreads = GetNumThreads();
+	for(u32 i = 0; i < numThreads; i++)
+	{
+		for(const auto& [section, samples] : m_threads[i]->sectionSamples)
+		{
+			ProfilerSectionStats stats;
+			if(ComputeSectionStats(samples, stats))
+			{
+				stats.section = section.c_str();
+				stats.threadIndex = (u8)i;
+				rOutStats.push_back(stats);
+			}
+		}
+	}
+}
+
+bool Profiler::GetSectionStats(u8 threadIndex, std::string_view section, ProfilerSectionStats& rOutStats) const
+{
+	if(threadIndex >= GetNumThreads())
+	{
+		return false;
+	}
+
+	const auto& sectionSamples = m_threads[threadIndex]->sectionSamples;
+	auto it = sectionSamples.find(section);
+	if(it == sectionSamples.end() || !ComputeSectionStats(it->second, rOutStats))
+	{
+		return false;
+	}
+	rOutStats.section = it->first.c_str();
+	rOutStats.threadIndex = threadIndex;
+	return true;
+}
+
+void Profiler::PublishThread(ProfilerThreadData& rData)
+{
+	rData.publishEntries.clear();
+
+	const u64 writeIndex = rData.writeIndex.load(std::memory_order_acquire);
+	if(writeIndex - rData.readIndex > ProfilerThreadData::RING_SIZE)
+	{
+		rData.numDropped += writeIndex - rData.readIndex - ProfilerThreadData::RING_SIZE;
+		rData.readIndex = writeIndex - ProfilerThreadData::RING_SIZE;
+	}
+
+	u64 index = rData.readIndex;
+	for(; index < writeIndex; index++)
+	{
+		const ProfilerSlot& slot = rData.slots[index & ProfilerThreadData::RING_MASK];
+
+		u64 endTicks = slot.endTicks.load(std::memory_order_acquire);
+		if(endTicks == 0)
+		{
+			// Still open, it goes out with the frame it ends in. Scopes begun before it are closed (LIFO).
+			// A scope left open for half a ring is published as it stands so the ring can move on.
+			if(writeIndex - index < ProfilerThreadData::RING_SIZE / 2)
+			{
+				break;
+			}
+			endTicks = ProfilerClock::Now();
+		}
+
+		const u64 startTicks = slot.startTicks.load(std::memory_order_relaxed);
+		rData.publishEntries.emplace_back(slot.scopeId.load(std::memory_order_relaxed),
+			ProfilerClock::ToNs(startTicks), ProfilerClock::TicksToNs(endTicks - startTicks),
+			slot.depth.load(std::memory_order_relaxed), rData.threadIndex);
+	}
+	rData.readIndex = index;
+
+	// Slots the owner reused while we were copying hold newer scopes, drop what came from them
+	const u64 oldestValid = rData.writeIndex.load(std::memory_order_acquire) - ProfilerThreadData::RING_SIZE;
+	const u64 firstCopied = index - rData.publishEntries.size();
+	if((i64)(oldestValid - firstCopied) > 0)
+	{
+		const u64 numTorn = utils::Min(oldestValid - firstCopied, (u64)rData.publishEntries.size());
+		rData.publishEntries.erase(rData.publishEntries.begin(), rData.publishEntries.begin() + numTorn);
+		rData.numDropped += numTorn;
+	}
+}
+
+void Profiler::PublishThreadCounters(ProfilerThreadData& rData)
+{
+	rData.publishCounters.clear();
+
+	const u64 writeIndex = rData.counterWriteIndex.load(std::memory_order_acquire);
+	if(writeIndex - rData.counterReadIndex > ProfilerThreadData::COUNTER_RING_SIZE)
+	{
+		rData.numDropped += writeIndex - rData.counterReadIndex - ProfilerThreadData::COUNTER_RING_SIZE;
+		rData.counterReadIndex = writeIndex - ProfilerThreadData::COUNTER_RING_SIZE;
+	}
+
+	for(u64 index = rData.counterReadIndex; index < writeIndex; index++)
+	{
+		const ProfilerCounterSlot& slot = rData.counterSlots[index & ProfilerThreadData::COUNTER_RING_MASK];
+		rData.publishCounters.push_back({ slot.name.load(std::memory_order_relaxed),
+			ProfilerClock::ToNs(slot.ticks.load(std::memory_order_relaxed)),
+			slot.value.load(std::memory_order_relaxed),
+			slot.kind.load(std::memory_order_relaxed) });
+	}
+	rData.counterReadIndex = writeIndex;
+
+	// Same as scopes, samples whose slots were reused during the copy are dropped
+	const u64 oldestValid = rData.counterWriteIndex.load(std::memory_order_acquire) - ProfilerThreadData::COUNTER_RING_SIZE;
+	const u64 firstCopied = writeIndex - rData.publishCounters.size();
+	if((i64)(oldestValid - firstCopied) > 0)
+	{
+		const u64 numTorn = utils::Min(oldestValid - firstCopied, (u64)rData.publishCounters.size());
+		rData.publishCounters.erase(rData.publishCounters.begin(), rData.publishCounters.begin() + numTorn);
+		rData.numDropped += numTorn;
+	}
+}
+
+// Only the publishing thread writes lastCounters, no lock needed to read them here
+void Profiler::RecordFrameCounters()
+{
+	m_frameCounters.clear();
+
+	const u32 numThreads = GetNumThreads();
+	for(u32 i = 0; i < numThreads; i++)
+	{
+		for(const ProfilerCounterSample& sample : m_threads[i]->lastCounters)
+		{
+			// A frame has a handful of counters, a linear search beats hashing the names
+			auto it = std::find_if(m_frameCounters.begin(), m_frameCounters.end(), [&sample](const ProfilerCounterValue& counter) {
+				return counter.name == sample.name || std::strcmp(counter.name, sample.name) == 0;
+			});
+			if(it == m_frameCounters.end())
+			{
+				it = m_frameCounters.insert(m_frameCounters.end(), ProfilerCounterValue());
+				it->name = sample.name;
+				it->kind = sample.kind;
+			}
+
+			if(sample.kind == ProfilerCounterKind::Counter)
+			{
+				it->value += sample.value;
+			}
+			else if(sample.timestamp >= it->timestamp)
+			{
+				it->value = sample.value;
+			}
+			it->timestamp = utils::Max(it->timestamp, sample.timestamp);
+			it->numSamples++;
+		}
+	}
+
+	std::sort(m_frameCounters.begin(), m_frameCounters.end(), [](const ProfilerCounterValue& a, const ProfilerCounterValue& b) {
+		return std::strcmp(a.name, b.name) < 0;
+	});
+}
+
+void Profiler::PublishThreadHwSamples(ProfilerThreadData& rData)
+{
+	rData.publishHwSamples.clear();
+
+	const u64 writeIndex = rData.hwWriteIndex.load(std::memory_order_acquire);
+	if(writeIndex - rData.hwReadIndex > ProfilerThreadData::HW_RING_SIZE)
+	{
+		rData.numDropped += writeIndex - rData.hwReadIndex - ProfilerThreadData::HW_RING_SIZE;
+		rData.hwReadIndex = writeIndex - ProfilerThreadData::HW_RING_SIZE;
+	}
+
+	for(u64 index = rData.hwReadIndex; index < writeIndex; index++)
+	{
+		const ProfilerHwSlot& slot = rData.hwSlots[index & ProfilerThreadData::HW_RING_MASK];
+		ProfilerHwSample& rSample = rData.publishHwSamples.emplace_back();
+		rSample.scopeId = slot.scopeId.load(std::memory_order_relaxed);
+		rSample.counts.cycles = slot.cycles.load(std::memory_order_relaxed);
+		rSample.counts.instructions = slot.instructions.load(std::memory_order_relaxed);
+		rSample.counts.cacheMisses = slot.cacheMisses.load(std::memory_order_relaxed);
+		rSample.counts.branchMisses = slot.branchMisses.load(std::memory_order_relaxed);
+	}
+	rData.hwReadIndex = writeIndex;
+
+	const u64 oldestValid = rData.hwWriteIndex.load(std::memory_order_acquire) - ProfilerThreadData::HW_RING_SIZE;
+	const u64 firstCopied = writeIndex - rData.publishHwSamples.size();
+	if((i64)(oldestValid - firstCopied) > 0)
+	{
+		const u64 numTorn = utils::Min(oldestValid - firstCopied, (u64)rData.publishHwSamples.size());
+		rData.publishHwSamples.erase(rData.publishHwSamples.begin(), rData.publishHwSamples.begin() + numTorn);
+		rData.numDropped += numTorn;
+	}
+}
+
+// Only the publishing thread writes lastHwSamples, no lock needed to read them here
+void Profiler::RecordHwScopeStats()
+{
+	for(ProfilerHwScopeStats& rStats : m_hwScopeStats)
+	{
+		rStats.frameCalls = 0;
+		rStats.frame = ProfilerHwCounts();
+	}
+
+	const u32 numThreads = GetNumThreads();
+	for(u32 i = 0; i < numThreads; i++)
+	{
+		for(const ProfilerHwSample& sample : m_threads[i]->lastHwSamples)
+		{
+			// Only the few PROFILE_SCOPE_HW scopes end up here
+			auto it = std::find_if(m_hwScopeStats.begin(), m_hwScopeStats.end(),
+				[&sample](const ProfilerHwScopeStats& stats) { return stats.scopeId == sample.scopeId; });
+			if(it == m_hwScopeStats.end())
+			{
+				it = m_hwScopeStats.insert(m_hwScopeStats.end(), ProfilerHwScopeStats());
+				it->scopeId = sample.scopeId;
+			}
+
+			it->frameCalls++;
+			it->frame += sample.counts;
+			it->totalCalls++;
+			it->total += sample.counts;
+		}
+	}
+}
+
+void Profiler::PublishThreadJobs(ProfilerThreadData& rData)
 {
-	std::lock_guard<std::mutex> lock(m_threadDataMutex);
-	for(auto& [threadId, data] : m_threadDataMap)
+	rData.publishJobs.clear();
+
+	const u64 writeIndex = rData.jobWriteIndex.load(std::memory_order_acquire);
+	if(writeIndex - rData.jobReadIndex > ProfilerThreadData::JOB_RING_SIZE)
 	{
-		data->depth = 0;
-		data->lastEntries = data->entries;
-		data->entries.clear();
+		rData.numDropped += writeIndex - rData.jobReadIndex - ProfilerThreadData::JOB_RING_SIZE;
+		rData.jobReadIndex = writeIndex - ProfilerThreadData::JOB_RING_SIZE;
+	}
+
+	for(u64 index = rData.jobReadIndex; index < writeIndex; index++)
+	{
+		const ProfilerJobSlot& slot = rData.jobSlots[index & ProfilerThreadData::JOB_RING_MASK];
+		ProfilerJobFlow& rJob = rData.publishJobs.emplace_back();
+		rJob.enqueueTime = ProfilerClock::ToNs(slot.enqueueTicks.load(std::memory_order_relaxed));
+		rJob.startTime = ProfilerClock::ToNs(slot.startTicks.load(std::memory_order_relaxed));
+		rJob.endTime = ProfilerClock::ToNs(slot.endTicks.load(std::memory_order_relaxed));
+		rJob.scopeId = slot.scopeId.load(std::memory_order_relaxed);
+		rJob.producerThread = slot.producerThread.load(std::memory_order_relaxed);
+		rJob.workerThread = rData.threadIndex;
+	}
+	rData.jobReadIndex = writeIndex;
+
+	const u64 oldestValid = rData.jobWriteIndex.load(std::memory_order_acquire) - ProfilerThreadData::JOB_RING_SIZE;
+	const u64 firstCopied = writeIndex - rData.publishJobs.size();
+	if((i64)(oldestValid - firstCopied) > 0)
+	{
+		const u64 numTorn = utils::Min(oldestValid - firstCopied, (u64)rData.publishJobs.size());
+		rData.publishJobs.erase(rData.publishJobs.begin(), rData.publishJobs.begin() + numTorn);
+		rData.numDropped += numTorn;
 	}
 }
 
+// Only the publishing thread writes lastJobs, no lock needed to read them here
+void Profiler::RecordJobHistograms()
+{
+	m_frameJobHistogram = ProfilerJobHistogram();
+
+	const u32 numThreads = GetNumThreads();
+	for(u32 i = 0; i < numThreads; i++)
+	{
+		for(const ProfilerJobFlow& job : m_threads[i]->lastJobs)
+		{
+			m_frameJobHistogram.Add(job);
+			m_totalJobHistogram.Add(job);
+		}
+	}
+}
+
+std::vector<ProfilerJobFlow> Profiler::GetAllThreadsJobs()
+{
+	std::lock_guard<ProfiledMutex> lock(m_threadDataMutex);
+	std::vector<ProfilerJobFlow> allJobs;
+
+	const u32 numThreads = GetNumThreads();
+	for(u32 i = 0; i < numThreads; i++)
+	{
+		const std::vector<ProfilerJobFlow>& lastJobs = m_threads[i]->lastJobs;
+		allJobs.insert(allJobs.end(), lastJobs.begin(), lastJobs.end());
+	}
+
+	return allJobs;
+}
+
+std::vector<ProfilerCounterSample> Profiler::GetAllThreadsCounterSamples()
+{
+	std::lock_guard<ProfiledMutex> lock(m_threadDataMutex);
+	std::vector<ProfilerCounterSample> allSamples;
+
+	const u32 numThreads = GetNumThreads();
+	for(u32 i = 0; i < numThreads; i++)
+	{
+		const std::vector<ProfilerCounterSample>& lastCounters = m_threads[i]->lastCounters;
+		allSamples.insert(allSamples.end(), lastCounters.begin(), lastCounters.end());
+	}
+
+	return allSamples;
+}
+
 // Get profiling data for current thread
 const std::vector<ProfilerEntry>& Profiler::GetCurrentThreadEntries()
 {
@@ -56,45 +628,62 @@ const std::vector<ProfilerEntry>& Profiler::GetCurrentThreadEntries()
 // Get profiling data for all threads
 std::vector<ProfilerEntry> Profiler::GetAllThreadsEntries()
 {
-	std::lock_guard<std::mutex> lock(m_threadDataMutex);
+	std::lock_guard<ProfiledMutex> lock(m_threadDataMutex);
 	std::vector<ProfilerEntry> allEntries;
 
-	for(const auto& [threadId, data] : m_threadDataMap)
+	const u32 numThreads = GetNumThreads();
+	for(u32 i = 0; i < numThreads; i++)
 	{
-		allEntries.insert(allEntries.end(), data->lastEntries.begin(), data->lastEntries.end());
+		const std::vector<ProfilerEntry>& lastEntries = m_threads[i]->lastEntries;
+		allEntries.insert(allEntries.end(), lastEntries.begin(), lastEntries.end());
 	}
 
 	return allEntries;
 }
 
-std::vector<ProfilerEntry> Profiler::GetThreadEntries(std::thread::id threadId)
+std::vector<ProfilerEntry> Profiler::GetThreadEntries(u8 threadIndex)
 {
-	std::lock_guard<std::mutex> lock(m_threadDataMutex);
-	auto it = m_threadDataMap.find(threadId);
-	if(it != m_threadDataMap.end())
+	std::lock_guard<ProfiledMutex> lock(m_threadDataMutex);
+	if(threadIndex < GetNumThreads())
 	{
-		return it->second->lastEntries;
+		return m_threads[threadIndex]->lastEntries;
 	}
 	return {};
 }
 
+u64 Profiler::GetNumDroppedEntries()
+{
+	u64 numDropped = 0;
+	const u32 numThreads = GetNumThreads();
+	for(u32 i = 0; i < numThreads; i++)
+	{
+		numDropped += m_threads[i]->numDropped;
+	}
+	return numDropped;
+}
+
 // Get thread names for better reporting
 void Profiler::SetThreadName(const char* name)
 {
-	std::lock_guard<std::mutex> lock(m_threadDataMutex);
+	std::lock_guard<ProfiledMutex> lock(m_threadDataMutex);
 	m_threadNames[std::this_thread::get_id()] = name;
 }
 
-const char* Profiler::GetThreadName(std::thread::id threadId)
+const char* Profiler::GetThreadName(u8 threadIndex)
 {
-	std::lock_guard<std::mutex> lock(m_threadDataMutex);
-	auto it = m_threadNames.find(threadId);
+	if(threadIndex >= GetNumThreads())
+	{
+		return "?";
+	}
+
+	std::lock_guard<ProfiledMutex> lock(m_threadDataMutex);
+	auto it = m_threadNames.find(m_threads[threadIndex]->threadId);
 	if(it != m_threadNames.end())
 	{
 		return it->second;
 	}
 
-	return StringFactory::TempFormat("Thread_%d", threadId);
+	return StringFactory::TempFormat("Thread_%u", threadIndex);
 }
 
 // Report profiling data grouped by thread
@@ -102,50 +691,47 @@ void Profiler::PrintReport()
 {
 	auto allEntries = GetAllThreadsEntries();
 
-	std::unordered_map<std::thread::id, std::vector<ProfilerEntry>> threadGroups;
+	std::unordered_map<u8, std::vector<ProfilerEntry>> threadGroups;
 	for(const auto& entry : allEntries)
 	{
-		threadGroups[entry.threadId].push_back(entry);
+		threadGroups[entry.threadIndex].push_back(entry);
 	}
 
-	for(const auto& [threadId, entries] : threadGroups)
+	for(const auto& [threadIndex, entries] : threadGroups)
 	{
-		printf("\n=== %s ===\n", GetThreadName(threadId));
+		printf("\n=== %s ===\n", GetThreadName(threadIndex));
 		for(const auto& entry : entries)
 		{
 			for(int i = 0; i < entry.depth; i++)
 			{
 				printf("\t");
 			}
-			printf("%s: %.4fms\n", entry.section, NS_TO_MS((f32)entry.duration));
+			printf("%s: %.4fms\n", entry.GetName(), NS_TO_MS((f32)entry.duration));
 		}
 	}
 }
 
-u64 Profiler::GetTimeUs()
-{
-	auto now = std::chrono::high_resolution_clock::now();
-	auto duration = now.time_since_epoch();
-	return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
-}
-
 ProfilerThreadData* Profiler::GetOrCreateThreadData()
 {
 	if(!tl_threadData)
 	{
-		std::lock_guard<std::mutex> lock(m_threadDataMutex);
-		auto threadId = std::this_thread::get_id();
+		auto pThreadData = std::make_unique<ProfilerThreadData>();
+		pThreadData->threadId = std::this_thread::get_id();
 
-		auto it = m_threadDataMap.find(threadId);
-		if(it == m_threadDataMap.end())
+		std::lock_guard<ProfiledMutex> lock(m_threadDataMutex);
+		const u32 index = m_numThreads.load(std::memory_order_relaxed);
+		if(index < MAX_THREADS)
 		{
-			auto threadData = std::make_unique<ProfilerThreadData>();
-			tl_threadData = threadData.get();
-			m_threadDataMap[threadId] = std::move(threadData);
+			pThreadData->threadIndex = (u8)index;
+			tl_threadData = pThreadData.get();
+			m_threads[index] = std::move(pThreadData);
+			m_numThreads.store(index + 1, std::memory_order_release);
 		}
 		else
 		{
-			tl_threadData = it->second.get();
+			// Still needs a ring to write to, it just never gets published
+			LOG_WARNING("Profiler: more than %u threads, scopes on this one are not recorded", MAX_THREADS);
+			tl_threadData = pThreadData.release();
 		}
 	}
 	return tl_threadData;
@@ -3,50 +3,313 @@
 #include "core/core_minimal.h"
 #include "manager/base_singleton.h"
 
+#include "profiler_clock.h"
+#include "profiler_lock.h"
+#include "profiler_trace.h"
 #include "profiler_types.h"
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
 #include <thread>
 #include <unordered_map>
-#include <mutex>
 
+// Scopes go into a fixed ring per thread, no locks or allocations on the hot path (a TSC read and
+// a few stores per Begin / End). Once a frame the main thread publishes every thread's finished
+// scopes, the Get*Entries functions return the last published frame.
+//
+// A scope costs about 45 ns begin to end on the dev VM, almost all of it the two TSC reads (~20 ns
+// each there, less on bare metal). See BenchmarkProfileScopes in profiler_section.h.
 class Profiler
 {
 	DECLARE_SINGLETON(Profiler);
 
 public:
+	static constexpr u32 MAX_THREADS = 64;
+	static constexpr u32 DEFAULT_HISTORY_SIZE = 300;
+	static constexpr u32 SPIKE_WINDOW = 60;
+	static constexpr u32 MAX_STATS_WINDOW = 2048;
+
+	ProfilerThreadData* GetCurrentThreadData() { return tl_threadData ? tl_threadData : GetOrCreateThreadData(); }
+
+	u64 BeginSection(ProfilerScopeId scopeId) { return BeginSection(GetCurrentThreadData(), scopeId); }
+
+	// pData is the current thread's, see GetCurrentThreadData
+	u64 BeginSection(ProfilerThreadData* pData, ProfilerScopeId scopeId)
+	{
+		const u64 index = pData->writeIndex.load(std::memory_order_relaxed);
+		ProfilerSlot& slot = pData->slots[index & ProfilerThreadData::RING_MASK];
+		slot.scopeId.store(scopeId, std::memory_order_relaxed);
+		slot.depth.store(pData->depth++, std::memory_order_relaxed);
+		slot.endTicks.store(0, std::memory_order_relaxed);
+		slot.startTicks.store(ProfilerClock::Now(), std::memory_order_relaxed);
+		pData->writeIndex.store(index + 1, std::memory_order_release);
+		return index;
+	}
+
+	// Must run on the thread that began the section
+	void EndSection(u64 timerId) { EndSection(tl_threadData, timerId); }
+
+	// Closes in the ring of the thread that began the section. Ending on another thread (a scope kept
+	// across a co_await) is a bug: it asserts, and only the end time is written, depth is owner only.
+	void EndSection(ProfilerThreadData* pData, u64 timerId)
+	{
+		const u64 endTicks = ProfilerClock::Now();
+
+		if(pData == tl_threadData)
+		{
+			pData->depth--;
+		}
+		else
+		{
+			AssertMsg(false, "Profile section ended on another thread, don't keep a scope across a co_await");
+		}
+
+		// The slot was reused if the scope outlived a full ring of newer scopes
+		if (pData->writeIndex.load(std::memory_order_relaxed) - timerId <= ProfilerThreadData::RING_SIZE)
+		{
+			pData->slots[timerId & ProfilerThreadData::RING_MASK].endTicks.store(endTicks, std::memory_order_release);
+		}
+	}
+
+	// Counter and plot values go into a second ring per thread, published with the scopes.
+	// Names are code literals like section names, the pointer is kept.
+	void RecordCounter(const char* name, f64 value, ProfilerCounterKind kind)
+	{
+		ProfilerThreadData* pData = tl_threadData ? tl_threadData : GetOrCreateThreadData();
+
+		const u64 index = pData->counterWriteIndex.load(std::memory_order_relaxed);
+		ProfilerCounterSlot& slot = pData->counterSlots[index & ProfilerThreadData::COUNTER_RING_MASK];
+		slot.name.store(name, std::memory_order_relaxed);
+		slot.value.store(value, std::memory_order_relaxed);
+		slot.kind.store(kind, std::memory_order_relaxed);
+		slot.ticks.store(ProfilerClock::Now(), std::memory_order_relaxed);
+		pData->counterWriteIndex.store(index + 1, std::memory_order_release);
+	}
 
-	u32 BeginSection(const char* section_name);
-	void EndSection(u32 timerId);
+	// Hardware counters around a PROFILE_SCOPE_HW scope. Begin returns false when they are off or
+	// unavailable on this thread, End must then be skipped.
+	bool BeginHwCounters(ProfilerHwReading& rOutStart)
+	{
+		if(!m_bHwCountersEnabled.load(std::memory_order_relaxed))
+		{
+			return false;
+		}
+		ProfilerThreadData* pData = tl_threadData ? tl_threadData : GetOrCreateThreadData();
+		return pData->hwGroup.Read(rOutStart);
+	}
+
+	void EndHwCounters(ProfilerScopeId scopeId, const ProfilerHwReading& start)
+	{
+		ProfilerThreadData* pData = tl_threadData;
+
+		ProfilerHwReading end;
+		if(!pData->hwGroup.Read(end))
+		{
+			return;
+		}
+		const ProfilerHwCounts delta = ProfilerHwGroup::Delta(start, end);
+
+		const u64 index = pData->hwWriteIndex.load(std::memory_order_relaxed);
+		ProfilerHwSlot& slot = pData->hwSlots[index & ProfilerThreadData::HW_RING_MASK];
+		slot.scopeId.store(scopeId, std::memory_order_relaxed);
+		slot.cycles.store(delta.cycles, std::memory_order_relaxed);
+		slot.instructions.store(delta.instructions, std::memory_order_relaxed);
+		slot.cacheMisses.store(delta.cacheMisses, std::memory_order_relaxed);
+		slot.branchMisses.store(delta.branchMisses, std::memory_order_relaxed);
+		pData->hwWriteIndex.store(index + 1, std::memory_order_release);
+	}
+
+	// Job flow: stamped on the thread queuing the job, recorded by the thread that ran it. Jobs
+	// queued without a stamp record nothing.
+	ProfilerJobStamp StampJob()
+	{
+		ProfilerThreadData* pData = tl_threadData ? tl_threadData : GetOrCreateThreadData();
+		return { ProfilerClock::Now(), pData->threadIndex };
+	}
+
+	void RecordJob(const ProfilerJobStamp& stamp, ProfilerScopeId scopeId, u64 startTicks, u64 endTicks)
+	{
+		if(stamp.enqueueTicks == 0)
+		{
+			return;
+		}
+		ProfilerThreadData* pData = tl_threadData ? tl_threadData : GetOrCreateThreadData();
+
+		const u64 index = pData->jobWriteIndex.load(std::memory_order_relaxed);
+		ProfilerJobSlot& slot = pData->jobSlots[index & ProfilerThreadData::JOB_RING_MASK];
+		slot.enqueueTicks.store(stamp.enqueueTicks, std::memory_order_relaxed);
+		slot.startTicks.store(startTicks, std::memory_order_relaxed);
+		slot.endTicks.store(endTicks, std::memory_order_relaxed);
+		slot.scopeId.store(scopeId, std::memory_order_relaxed);
+		slot.producerThread.store(stamp.producerThread, std::memory_order_relaxed);
+		pData->jobWriteIndex.store(index + 1, std::memory_order_release);
+	}
+
+	// Publishing runs on one thread at a time (the main thread)
 	void ClearCurrentThread();
 	void ClearAllThreads();
 
 	const std::vector<ProfilerEntry>& GetCurrentThreadEntries();
 	std::vector<ProfilerEntry> GetAllThreadsEntries();
-	std::vector<ProfilerEntry> GetThreadEntries(std::thread::id threadId);
+	std::vector<ProfilerEntry> GetThreadEntries(u8 threadIndex);
+
+	// Scopes, counter samples and jobs lost because a thread wrote more than a ring between two publishes
+	u64 GetNumDroppedEntries();
+
+	// Hardware counters for PROFILE_SCOPE_HW scopes, off by default (two syscalls per scope, see
+	// ProfilerHwGroup). Stats are per scope, main thread like publishing.
+	void SetHwCountersEnabled(bool bEnabled) { m_bHwCountersEnabled.store(bEnabled, std::memory_order_relaxed); }
+	bool AreHwCountersEnabled() const { return m_bHwCountersEnabled.load(std::memory_order_relaxed); }
+	const std::vector<ProfilerHwScopeStats>& GetHwScopeStats() const { return m_hwScopeStats; }
+	void ResetHwScopeStats() { m_hwScopeStats.clear(); }
+
+	// Counters of the last published frame, sorted by name. Main thread, like publishing.
+	const std::vector<ProfilerCounterValue>& GetFrameCounters() const { return m_frameCounters; }
+	// Every counter and plot sample of the last published frame, all threads
+	std::vector<ProfilerCounterSample> GetAllThreadsCounterSamples();
 
+	// Jobs that finished in the last published frame, all threads
+	std::vector<ProfilerJobFlow> GetAllThreadsJobs();
+	// Queue wait histograms of every recorded job: last published frame and since the last reset. Main thread.
+	const ProfilerJobHistogram& GetFrameJobHistogram() const { return m_frameJobHistogram; }
+	const ProfilerJobHistogram& GetTotalJobHistogram() const { return m_totalJobHistogram; }
+	void ResetJobHistogram() { m_totalJobHistogram = ProfilerJobHistogram(); }
+
+	// Threads are numbered in the order they first recorded something, entries carry that index
 	void SetThreadName(const char* name);
-	const char* GetThreadName(std::thread::id threadId);
+	const char* GetThreadName(u8 threadIndex);
 
 	void PrintReport();
 
-private:
-	static u64 GetTimeUs();
+	// Last published frames, oldest first. Main thread, like publishing. 0 frames turns the history off.
+	void SetHistorySize(u32 numFrames);
+	u32 GetHistorySize() const { return (u32)m_history.size(); }
+	u32 GetNumHistoryFrames() const { return m_numHistoryFrames; }
+	const ProfilerFrame& GetHistoryFrame(u32 index) const;
+	const ProfilerFrame* FindHistoryFrame(u64 frameIndex) const;
+
+	// A frame is a spike when it takes spikeFactor times the median of the SPIKE_WINDOW frames before it
+	void SetSpikeFactor(f32 spikeFactor) { m_spikeFactor = spikeFactor; }
+	f32 GetSpikeFactor() const { return m_spikeFactor; }
 
+	// Rolling min / avg / max / p95 / p99 of every section per thread over the last statsWindow
+	// frames. Main thread. Changing the window restarts the statistics.
+	void SetStatsWindow(u32 numFrames);
+	u32 GetStatsWindow() const { return m_statsWindow; }
+	void GetSectionStats(std::vector<ProfilerSectionStats>& rOutStats) const;
+	bool GetSectionStats(u8 threadIndex, std::string_view section, ProfilerSectionStats& rOutStats) const;
+
+	// Records the next numFrames publishes and writes them as a Chrome trace (see ProfilerTrace).
+	// Main thread, like publishing. Restarting drops the capture in progress.
+	void StartTraceCapture(u32 numFrames, const std::string& path);
+	bool IsCapturingTrace() const { return m_pTraceCapture != nullptr; }
+	u32 GetTraceFramesCaptured() const { return m_pTraceCapture ? (u32)m_pTraceCapture->trace.frameStartNs.size() : 0; }
+	u32 GetTraceFramesRequested() const { return m_pTraceCapture ? m_pTraceCapture->numFrames : 0; }
+	// Path of the last trace written, empty if none or it failed
+	const std::string& GetLastTracePath() const { return m_lastTracePath; }
+
+private:
 	ProfilerThreadData* GetOrCreateThreadData();
+	void PublishThread(ProfilerThreadData& rData);
+	void PublishThreadCounters(ProfilerThreadData& rData);
+	void PublishThreadHwSamples(ProfilerThreadData& rData);
+	void PublishThreadJobs(ProfilerThreadData& rData);
+	void RecordFrameCounters();
+	void RecordHwScopeStats();
+	void RecordJobHistograms();
+	void RecordHistoryFrame(u64 frameIndex, u64 frameStartNs, u64 frameEndNs);
+	void RecordSectionStats(u64 frameIndex);
+	bool ComputeSectionStats(const ProfilerSectionSamples& samples, ProfilerSectionStats& rOutStats) const;
+	void RecordTraceFrame(u64 frameStartNs, u64 publishNs);
+
+	u32 GetNumThreads() const { return m_numThreads.load(std::memory_order_acquire); }
 
 private:
 	thread_local static ProfilerThreadData* tl_threadData;
 
-	std::unordered_map<std::thread::id, std::unique_ptr<ProfilerThreadData>> m_threadDataMap;
+	// Append-only, entries below m_numThreads are never touched again and can be read without the lock
+	std::unique_ptr<ProfilerThreadData> m_threads[MAX_THREADS];
+	std::atomic<u32> m_numThreads{ 0 };
+
 	std::unordered_map<std::thread::id, const char*> m_threadNames;
-	std::mutex m_threadDataMutex;
+	ProfiledMutex m_threadDataMutex{ "Profiler Thread Data", false };
+
+	std::vector<ProfilerCounterValue> m_frameCounters;
+
+	std::atomic<bool> m_bHwCountersEnabled{ false };
+	std::vector<ProfilerHwScopeStats> m_hwScopeStats;
+
+	ProfilerJobHistogram m_frameJobHistogram;
+	ProfilerJobHistogram m_totalJobHistogram;
+
+	// Ring of m_history.size() frames, m_historyHead is the oldest. Frames keep their entry buffers when reused.
+	std::vector<ProfilerFrame> m_history = std::vector<ProfilerFrame>(DEFAULT_HISTORY_SIZE);
+	u32 m_historyHead = 0;
+	u32 m_numHistoryFrames = 0;
+	u64 m_lastPublishNs = 0;
+	u64 m_numPublishedFrames = 0;
+	f32 m_spikeFactor = 1.5f;
+
+	u32 m_statsWindow = DEFAULT_HISTORY_SIZE;
+
+	std::unique_ptr<ProfilerTraceCapture> m_pTraceCapture;
+	std::string m_lastTracePath;
 };
 
 
-// Enhanced macros with thread support
+// PROFILER_ENABLED 0 compiles every macro below to nothing (the Release configuration), arguments
+// are not evaluated. The Profiler itself still builds, it just never gets anything to record.
+#ifndef PROFILER_ENABLED
+	#define PROFILER_ENABLED 1
+#endif
+
+#if PROFILER_ENABLED
+
+#define PROFILER_CONCAT_INNER(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_INNER(a, b)
+
+// A constexpr descriptor and its id per callsite, the id is registered the first time the scope runs
+#define PROFILER_SCOPE_IMPL(sectionType, name, color, suffix) \
+	static constexpr ProfilerScopeDesc PROFILER_CONCAT(_profilerScopeDesc, suffix) = { name, __FILE__, __LINE__, color }; \
+	static const ProfilerScopeId PROFILER_CONCAT(_profilerScopeId, suffix) = ProfilerScopes::Register(PROFILER_CONCAT(_profilerScopeDesc, suffix)); \
+	sectionType PROFILER_CONCAT(_profilerTimer, suffix)(PROFILER_CONCAT(_profilerScopeId, suffix))
+
 #define PROFILE_FRAME_START() Profiler::GetInstance().ClearCurrentThread()
 #define PROFILE_FRAME_START_ALL_THREADS() Profiler::GetInstance().ClearAllThreads()
-#define PROFILE_SCOPE(name) ProfileSection _timer(name)
-#define PROFILE() ProfileSection _timer(__FUNCTION__)
+#define PROFILE_SCOPE(name) PROFILER_SCOPE_IMPL(ProfileSection, name, 0, __COUNTER__)
+#define PROFILE_SCOPE_COLOR(name, color) PROFILER_SCOPE_IMPL(ProfileSection, name, color, __COUNTER__)
+#define PROFILE() PROFILER_SCOPE_IMPL(ProfileSection, __FUNCTION__, 0, __COUNTER__)
+// Also counts cycles, instructions, cache and branch misses when hardware counters are on
+#define PROFILE_SCOPE_HW(name) PROFILER_SCOPE_IMPL(ProfileSectionHw, name, 0, __COUNTER__)
+// Names only known at runtime, interned on every call (a lock and a lookup). Intern once and use PROFILE_SCOPE_ID where it runs often.
+#define PROFILE_SCOPE_DYNAMIC(name) ProfileSection PROFILER_CONCAT(_profilerTimer, __COUNTER__)(ProfilerScopes::Intern(name))
+#define PROFILE_SCOPE_ID(scopeId) ProfileSection PROFILER_CONCAT(_profilerTimer, __COUNTER__)(scopeId)
 #define PROFILE_SET_THREAD_NAME(name) Profiler::GetInstance().SetThreadName(name)
 #define PROFILE_PRINT_REPORT() Profiler::GetInstance().PrintReport()
+#define PROFILE_COUNTER(name, value) Profiler::GetInstance().RecordCounter(name, (f64)(value), ProfilerCounterKind::Counter)
+#define PROFILE_PLOT(name, value) Profiler::GetInstance().RecordCounter(name, (f64)(value), ProfilerCounterKind::Plot)
+// Job flow, see Profiler::StampJob: stamp a ProfilerJobStamp where the job is queued, wrap its run on the worker
+#define PROFILE_JOB_ENQUEUE(rStamp) ((rStamp) = Profiler::GetInstance().StampJob())
+#define PROFILE_JOB_RUN(stamp, scopeId) ProfileJob PROFILER_CONCAT(_profilerJob, __COUNTER__)(stamp, scopeId)
+
+#else
+
+#define PROFILE_FRAME_START() ((void)0)
+#define PROFILE_FRAME_START_ALL_THREADS() ((void)0)
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_SCOPE_COLOR(name, color) ((void)0)
+#define PROFILE() ((void)0)
+#define PROFILE_SCOPE_HW(name) ((void)0)
+#define PROFILE_SCOPE_DYNAMIC(name) ((void)0)
+#define PROFILE_SCOPE_ID(scopeId) ((void)0)
+#define PROFILE_SET_THREAD_NAME(name) ((void)0)
+#define PROFILE_PRINT_REPORT() ((void)0)
+#define PROFILE_COUNTER(name, value) ((void)0)
+#define PROFILE_PLOT(name, value) ((void)0)
+#define PROFILE_JOB_ENQUEUE(rStamp) ((void)0)
+#define PROFILE_JOB_RUN(stamp, scopeId) ((void)0)
+
+#endif
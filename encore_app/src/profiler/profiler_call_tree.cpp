@@ -0,0 +1,155 @@
+#include "profiler_call_tree.h"
+
+#include "utils/utils_math.h"
+
+#include <algorithm>
+#include <cstring>
+
+void ProfilerCallTree::Clear()
+{
+	nodes.clear();
+	nodes.emplace_back();
+	numFrames = 0;
+}
+
+void ProfilerCallTree::AddFrame(const std::vector<ProfilerEntry>& entries, bool bMergeThreads)
+{
+	// Open path on the current thread, stack[d] is the node of the depth d scope
+	u32 stack[256];
+	u32 stackSize = 0;
+	u8 currentThread = 0;
+	u32 threadNode = INVALID_NODE;
+
+	for(const ProfilerEntry& entry : entries)
+	{
+		if(threadNode == INVALID_NODE || entry.threadIndex != currentThread)
+		{
+			currentThread = entry.threadIndex;
+			threadNode = FindOrAddThread(bMergeThreads ? ALL_THREADS : currentThread);
+			stackSize = 0;
+		}
+
+		// A parent missing from this frame (dropped, or published earlier) hangs its children under the closest one
+		u32 parent = threadNode;
+		for(u32 depth = utils::Min((u32)entry.depth, stackSize); depth-- > 0;)
+		{
+			if(stack[depth] != INVALID_NODE)
+			{
+				parent = stack[depth];
+				break;
+			}
+		}
+
+		const u32 node = FindOrAddChild(parent, entry.GetName(), nodes[threadNode].threadIndex);
+		nodes[node].calls++;
+		nodes[node].inclusiveNs += entry.duration;
+
+		for(u32 depth = stackSize; depth < entry.depth; depth++)
+		{
+			stack[depth] = INVALID_NODE;
+		}
+		stack[entry.depth] = node;
+		stackSize = entry.depth + 1u;
+	}
+
+	numFrames++;
+}
+
+void ProfilerCallTree::Finish()
+{
+	std::vector<u32> children;
+
+	// Children are always added after their parent, walking backwards sees them first
+	for(u32 i = (u32)nodes.size(); i-- > 0;)
+	{
+		Node& rNode = nodes[i];
+
+		u64 childrenNs = 0;
+		for(u32 child = rNode.firstChild; child != INVALID_NODE; child = nodes[child].nextSibling)
+		{
+			childrenNs += nodes[child].inclusiveNs;
+		}
+
+		// Root and threads have no scope of their own, they total their children
+		if(rNode.name == nullptr)
+		{
+			rNode.inclusiveNs = childrenNs;
+		}
+		rNode.exclusiveNs = rNode.inclusiveNs > childrenNs ? rNode.inclusiveNs - childrenNs : 0;
+
+		// Heaviest child first
+		children.clear();
+		for(u32 child = rNode.firstChild; child != INVALID_NODE; child = nodes[child].nextSibling)
+		{
+			children.push_back(child);
+		}
+		std::stable_sort(children.begin(), children.end(), [this](u32 a, u32 b) { return nodes[a].inclusiveNs > nodes[b].inclusiveNs; });
+
+		rNode.firstChild = INVALID_NODE;
+		for(u64 c = children.size(); c-- > 0;)
+		{
+			nodes[children[c]].nextSibling = rNode.firstChild;
+			rNode.firstChild = children[c];
+		}
+	}
+}
+
+u32 ProfilerCallTree::FindOrAddChild(u32 parent, const char* name, u8 threadIndex)
+{
+	u32 lastChild = INVALID_NODE;
+	for(u32 child = nodes[parent].firstChild; child != INVALID_NODE; child = nodes[child].nextSibling)
+	{
+		const char* childName = nodes[child].name;
+		if(childName && (childName == name || std::strcmp(childName, name) == 0))
+		{
+			return child;
+		}
+		lastChild = child;
+	}
+
+	const u32 node = (u32)nodes.size();
+	Node& rNode = nodes.emplace_back();
+	rNode.name = name;
+	rNode.threadIndex = threadIndex;
+	rNode.parent = parent;
+	rNode.depth = nodes[parent].depth + 1;
+
+	if(lastChild == INVALID_NODE)
+	{
+		nodes[parent].firstChild = node;
+	}
+	else
+	{
+		nodes[lastChild].nextSibling = node;
+	}
+	return node;
+}
+
+u32 ProfilerCallTree::FindOrAddThread(u8 threadIndex)
+{
+	u32 lastChild = INVALID_NODE;
+	for(u32 child = nodes[ROOT_NODE].firstChild; child != INVALID_NODE; child = nodes[child].nextSibling)
+	{
+		if(nodes[child].threadIndex == threadIndex)
+		{
+			return child;
+		}
+		lastChild = child;
+	}
+
+	const u32 node = (u32)nodes.size();
+	Node& rNode = nodes.emplace_back();
+	rNode.threadIndex = threadIndex;
+	rNode.parent = ROOT_NODE;
+	rNode.depth = 1;
+
+	if(lastChild == INVALID_NODE)
+	{
+		nodes[ROOT_NODE].firstChild = node;
+	}
+	else
+	{
+		nodes[lastChild].nextSibling = node;
+	}
+	return node;
+}
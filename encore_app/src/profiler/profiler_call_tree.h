@@ -0,0 +1,53 @@
+#pragma once
+
+#include "core/core_minimal.h"
+
+#include "profiler_types.h"
+
+#include <vector>
+
+// Scopes merged by call path: every distinct stack of section names is one node, however many
+// times it ran and over however many frames were added. A parallel loop's thousand identical
+// scopes become one node with a call count.
+//
+// The root has one child per thread, threads hold their depth 0 sections. Exclusive time is the
+// inclusive time minus the children's, valid after Finish.
+struct ProfilerCallTree
+{
+	static constexpr u32 INVALID_NODE = UINT32_MAX;
+	static constexpr u32 ROOT_NODE = 0;
+	static constexpr u8 ALL_THREADS = UINT8_MAX;	// thread node when threads are merged
+
+	struct Node
+	{
+		const char* name = nullptr;		// null for the root and thread nodes
+		u8 threadIndex = 0;
+		u32 parent = INVALID_NODE;
+		u32 firstChild = INVALID_NODE;
+		u32 nextSibling = INVALID_NODE;
+		u32 depth = 0;
+		u64 calls = 0;
+		u64 inclusiveNs = 0;
+		u64 exclusiveNs = 0;
+	};
+
+	std::vector<Node> nodes;
+	u32 numFrames = 0;
+
+	ProfilerCallTree() { Clear(); }
+
+	void Clear();
+
+	// One frame's entries, each thread's in begin order (as published). bMergeThreads puts every
+	// thread under a single node (ALL_THREADS), for work spread over the pool.
+	void AddFrame(const std::vector<ProfilerEntry>& entries, bool bMergeThreads = false);
+
+	// Thread and root totals, exclusive times, children sorted by inclusive time
+	void Finish();
+
+	const Node& GetNode(u32 index) const { return nodes[index]; }
+
+private:
+	u32 FindOrAddChild(u32 parent, const char* name, u8 threadIndex);
+	u32 FindOrAddThread(u8 threadIndex);
+};
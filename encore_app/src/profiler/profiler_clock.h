@@ -0,0 +1,109 @@
+#pragma once
+
+#include "core/core_minimal.h"
+
+#include <chrono>
+
+// x86-64 reads the invariant TSC, a few cycles and no syscall. Define PROFILER_USE_TSC 0 to fall
+// back to the OS monotonic clock (clock_gettime / QueryPerformanceCounter through steady_clock).
+#ifndef PROFILER_USE_TSC
+	#if defined(_M_X64) || defined(__x86_64__)
+		#define PROFILER_USE_TSC 1
+	#else
+		#define PROFILER_USE_TSC 0
+	#endif
+#endif
+
+#if PROFILER_USE_TSC
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#else
+		#include <x86intrin.h>
+	#endif
+#elif defined(__linux__)
+	#include <time.h>
+#endif
+
+// Raw ticks on the hot path, converted to nanoseconds when a frame is published.
+// TSC ticks are calibrated once against steady_clock, the first conversion pays for it (~10ms).
+struct ProfilerClock
+{
+	static u64 Now()
+	{
+#if PROFILER_USE_TSC
+		return __rdtsc();
+#elif defined(__linux__)
+		timespec time;
+		clock_gettime(CLOCK_MONOTONIC, &time);
+		return (u64)time.tv_sec * 1'000'000'000ULL + (u64)time.tv_nsec;
+#else
+		return (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	// Ticks to nanoseconds on the steady_clock timeline, comparable across threads
+	static u64 ToNs(u64 ticks)
+	{
+#if PROFILER_USE_TSC
+		const Calibration& calibration = GetCalibration();
+		return calibration.baseNs + (u64)((f64)(i64)(ticks - calibration.baseTicks) * calibration.nsPerTick);
+#else
+		return ticks;
+#endif
+	}
+
+	static u64 TicksToNs(u64 ticks)
+	{
+#if PROFILER_USE_TSC
+		return (u64)((f64)ticks * GetCalibration().nsPerTick);
+#else
+		return ticks;
+#endif
+	}
+
+	static f64 GetNsPerTick()
+	{
+#if PROFILER_USE_TSC
+		return GetCalibration().nsPerTick;
+#else
+		return 1.0;
+#endif
+	}
+
+private:
+#if PROFILER_USE_TSC
+	static constexpr u64 CALIBRATION_NS = MS_TO_NS(10);
+
+	struct Calibration
+	{
+		u64 baseTicks = 0;
+		u64 baseNs = 0;
+		f64 nsPerTick = 1.0;
+	};
+
+	static u64 SteadyNs()
+	{
+		return (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	static const Calibration& GetCalibration()
+	{
+		static const Calibration calibration = []() {
+			Calibration result;
+			result.baseNs = SteadyNs();
+			result.baseTicks = __rdtsc();
+
+			u64 endNs = result.baseNs;
+			while (endNs - result.baseNs < CALIBRATION_NS)
+			{
+				endNs = SteadyNs();
+			}
+			const u64 endTicks = __rdtsc();
+
+			result.nsPerTick = (f64)(endNs - result.baseNs) / (f64)(endTicks - result.baseTicks);
+			return result;
+		}();
+		return calibration;
+	}
+#endif
+};
@@ -0,0 +1,148 @@
+#include "profiler_hw_counters.h"
+
+#ifdef __linux__
+	#include <linux/perf_event.h>
+	#include <sys/ioctl.h>
+	#include <sys/syscall.h>
+	#include <unistd.h>
+
+	#include <atomic>
+	#include <cerrno>
+	#include <cstring>
+#endif
+
+ProfilerHwGroup::~ProfilerHwGroup()
+{
+#ifdef __linux__
+	for(i32 fd : m_fds)
+	{
+		if(fd >= 0)
+		{
+			close(fd);
+		}
+	}
+#endif
+}
+
+bool ProfilerHwGroup::Read(ProfilerHwReading& rOutReading)
+{
+	if(m_state == State::Closed)
+	{
+		m_state = Open() ? State::Open : State::Failed;
+	}
+	if(m_state != State::Open)
+	{
+		return false;
+	}
+
+#ifdef __linux__
+	// PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING | PERF_FORMAT_ID:
+	// the number of events, time enabled, time running, then a value and id per event
+	static constexpr u32 HEADER_SIZE = 3;
+	u64 buffer[HEADER_SIZE + NUM_EVENTS * 2];
+	const ssize_t numBytes = read(m_fds[0], buffer, sizeof(buffer));
+	if(numBytes < (ssize_t)(HEADER_SIZE * sizeof(u64)))
+	{
+		return false;
+	}
+	const u64 numRead = ((u64)numBytes / sizeof(u64) - HEADER_SIZE) / 2;
+	const u64 numEvents = buffer[0] < numRead ? buffer[0] : numRead;
+
+	u64* counts[NUM_EVENTS] = { &rOutReading.counts.cycles, &rOutReading.counts.instructions,
+		&rOutReading.counts.cacheMisses, &rOutReading.counts.branchMisses };
+	rOutReading = ProfilerHwReading();
+	rOutReading.timeEnabled = buffer[1];
+	rOutReading.timeRunning = buffer[2];
+	for(u64 i = 0; i < numEvents && i < NUM_EVENTS; i++)
+	{
+		const u64 value = buffer[HEADER_SIZE + i * 2];
+		const u64 id = buffer[HEADER_SIZE + 1 + i * 2];
+		for(u32 event = 0; event < NUM_EVENTS; event++)
+		{
+			if(m_fds[event] >= 0 && m_ids[event] == id)
+			{
+				*counts[event] = value;
+			}
+		}
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+ProfilerHwCounts ProfilerHwGroup::Delta(const ProfilerHwReading& start, const ProfilerHwReading& end)
+{
+	const ProfilerHwCounts delta = end.counts - start.counts;
+	const u64 enabled = end.timeEnabled - start.timeEnabled;
+	const u64 running = end.timeRunning - start.timeRunning;
+	if(running == 0)
+	{
+		// Never on the hardware in between, nothing to extrapolate from
+		return ProfilerHwCounts();
+	}
+	if(running >= enabled)
+	{
+		return delta;
+	}
+
+	const f64 scale = (f64)enabled / (f64)running;
+	return { (u64)((f64)delta.cycles * scale), (u64)((f64)delta.instructions * scale),
+		(u64)((f64)delta.cacheMisses * scale), (u64)((f64)delta.branchMisses * scale) };
+}
+
+bool ProfilerHwGroup::Open()
+{
+#ifdef __linux__
+	static constexpr u64 EVENTS[NUM_EVENTS] = {
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_MISSES,
+		PERF_COUNT_HW_BRANCH_MISSES,
+	};
+	static constexpr const char* EVENT_NAMES[NUM_EVENTS] = { "cycles", "instructions", "cache misses", "branch misses" };
+
+	// Said once per process, every thread fails the same way
+	static std::atomic<bool> s_bReported{ false };
+
+	for(u32 event = 0; event < NUM_EVENTS; event++)
+	{
+		perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = EVENTS[event];
+		attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING | PERF_FORMAT_ID;
+		attr.disabled = event == 0 ? 1 : 0;	// the leader starts the whole group
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+
+		// This thread, on whatever CPU it runs
+		const i32 groupFd = event == 0 ? -1 : m_fds[0];
+		m_fds[event] = (i32)syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0);
+		if(m_fds[event] < 0)
+		{
+			if(!s_bReported.exchange(true))
+			{
+				LOG_WARNING("Profiler: no hardware counter for %s (%s)%s", EVENT_NAMES[event], strerror(errno),
+					event == 0 ? ", hardware counters are off" : "");
+			}
+
+			// Cycles lead the group, the others are optional
+			if(event == 0)
+			{
+				return false;
+			}
+			continue;
+		}
+
+		ioctl(m_fds[event], PERF_EVENT_IOC_ID, &m_ids[event]);
+	}
+
+	ioctl(m_fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(m_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	return true;
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "core/core_minimal.h"
+
+// Hardware event counts over a scope, user space only
+struct ProfilerHwCounts
+{
+	u64 cycles = 0;
+	u64 instructions = 0;
+	u64 cacheMisses = 0;	// last level cache
+	u64 branchMisses = 0;
+
+	f32 GetIpc() const { return cycles > 0 ? (f32)instructions / (f32)cycles : 0.0f; }
+	// Misses per thousand instructions
+	f32 GetCacheMpki() const { return instructions > 0 ? (f32)cacheMisses * 1000.0f / (f32)instructions : 0.0f; }
+	f32 GetBranchMpki() const { return instructions > 0 ? (f32)branchMisses * 1000.0f / (f32)instructions : 0.0f; }
+
+	ProfilerHwCounts& operator+=(const ProfilerHwCounts& other)
+	{
+		cycles += other.cycles;
+		instructions += other.instructions;
+		cacheMisses += other.cacheMisses;
+		branchMisses += other.branchMisses;
+		return *this;
+	}
+
+	ProfilerHwCounts operator-(const ProfilerHwCounts& other) const
+	{
+		return { cycles - other.cycles, instructions - other.instructions, cacheMisses - other.cacheMisses, branchMisses - other.branchMisses };
+	}
+};
+
+// Raw group totals since it was opened. With more events than hardware counters the kernel
+// multiplexes: the group only counted for timeRunning out of the timeEnabled ns.
+struct ProfilerHwReading
+{
+	ProfilerHwCounts counts;
+	u64 timeEnabled = 0;
+	u64 timeRunning = 0;
+};
+
+// The four counters of one thread as a perf_event_open group (Linux), scheduled and read together.
+// Opened by the owning thread on its first read. Without perf events (other platforms,
+// perf_event_paranoid above 2, a VM without a virtual PMU) reads fail and scopes record nothing.
+//
+// A read is a syscall, around a microsecond: meant for a few chosen scopes (PROFILE_SCOPE_HW)
+// doing enough work to hide it, not for every scope.
+class ProfilerHwGroup
+{
+public:
+	ProfilerHwGroup() = default;
+	~ProfilerHwGroup();
+
+	NO_COPY(ProfilerHwGroup);
+	NO_MOVE(ProfilerHwGroup);
+
+	// Owning thread only
+	bool Read(ProfilerHwReading& rOutReading);
+
+	// Counts between two readings, scaled up by how long the group was off the hardware in between
+	static ProfilerHwCounts Delta(const ProfilerHwReading& start, const ProfilerHwReading& end);
+
+private:
+	enum class State : u8
+	{
+		Closed,
+		Open,
+		Failed
+	};
+
+	static constexpr u32 NUM_EVENTS = 4;
+
+	bool Open();
+
+	i32 m_fds[NUM_EVENTS] = { -1, -1, -1, -1 };
+	u64 m_ids[NUM_EVENTS] = {};
+	State m_state = State::Closed;
+};
@@ -0,0 +1,111 @@
+#include "profiler_lock.h"
+
+#if PROFILER_ENABLED
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <string>
+
+namespace
+{
+	struct LockRegistry
+	{
+		std::mutex mutex;
+		std::vector<ProfiledMutex*> locks;
+		u32 nextLockId = 1;
+	};
+
+	// Function-local, locks can be statics constructed before this file's globals
+	LockRegistry& GetRegistry()
+	{
+		static LockRegistry s_registry;
+		return s_registry;
+	}
+}
+
+ProfiledMutex::ProfiledMutex(const char* name, bool bRecordWaits)
+	: m_name(name)
+	, m_bRecordWaits(bRecordWaits)
+{
+	if(m_bRecordWaits)
+	{
+		m_waitScopeId = ProfilerScopes::Intern(std::string("Lock Wait: ") + name);
+	}
+	m_lockId = ProfilerLocks::Add(this);
+}
+
+ProfiledMutex::~ProfiledMutex()
+{
+	ProfilerLocks::Remove(this);
+}
+
+void ProfiledMutex::LockContended()
+{
+	const u64 startTicks = ProfilerClock::Now();
+	if(m_bRecordWaits)
+	{
+		Profiler& rProfiler = Profiler::GetInstance();
+		const u64 timerId = rProfiler.BeginSection(m_waitScopeId);
+		m_mutex.lock();
+		rProfiler.EndSection(timerId);
+	}
+	else
+	{
+		m_mutex.lock();
+	}
+
+	const u64 waitTicks = ProfilerClock::Now() - startTicks;
+	Add(m_contentions, 1);
+	Add(m_waitTicks, waitTicks);
+	Max(m_maxWaitTicks, waitTicks);
+}
+
+void ProfiledMutex::GetStats(ProfilerLockStats& rOutStats) const
+{
+	rOutStats.name = m_name;
+	rOutStats.lockId = m_lockId;
+	rOutStats.acquisitions = m_acquisitions.load(std::memory_order_relaxed);
+	rOutStats.contentions = m_contentions.load(std::memory_order_relaxed);
+	rOutStats.waitNs = ProfilerClock::TicksToNs(m_waitTicks.load(std::memory_order_relaxed));
+	rOutStats.maxWaitNs = ProfilerClock::TicksToNs(m_maxWaitTicks.load(std::memory_order_relaxed));
+	rOutStats.holdNs = ProfilerClock::TicksToNs(m_holdTicks.load(std::memory_order_relaxed));
+	rOutStats.maxHoldNs = ProfilerClock::TicksToNs(m_maxHoldTicks.load(std::memory_order_relaxed));
+	rOutStats.conditionWaits = m_conditionWaits.load(std::memory_order_relaxed);
+	rOutStats.conditionWaitNs = ProfilerClock::TicksToNs(m_conditionWaitTicks.load(std::memory_order_relaxed));
+}
+
+void ProfilerLocks::GetStats(std::vector<ProfilerLockStats>& rOutStats)
+{
+	LockRegistry& rRegistry = GetRegistry();
+	std::lock_guard<std::mutex> lock(rRegistry.mutex);
+
+	rOutStats.resize(rRegistry.locks.size());
+	for(u64 i = 0; i < rRegistry.locks.size(); i++)
+	{
+		rRegistry.locks[i]->GetStats(rOutStats[i]);
+	}
+}
+
+u32 ProfilerLocks::Add(ProfiledMutex* pMutex)
+{
+	LockRegistry& rRegistry = GetRegistry();
+	std::lock_guard<std::mutex> lock(rRegistry.mutex);
+
+	rRegistry.locks.push_back(pMutex);
+	return rRegistry.nextLockId++;
+}
+
+void ProfilerLocks::Remove(ProfiledMutex* pMutex)
+{
+	LockRegistry& rRegistry = GetRegistry();
+	std::lock_guard<std::mutex> lock(rRegistry.mutex);
+
+	auto it = std::find(rRegistry.locks.begin(), rRegistry.locks.end(), pMutex);
+	if(it != rRegistry.locks.end())
+	{
+		rRegistry.locks.erase(it);
+	}
+}
+
+#endif
@@ -0,0 +1,194 @@
+#pragma once
+
+#include "core/core_minimal.h"
+
+#include "profiler_clock.h"
+#include "profiler_scope.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+// Same default as profiler.h, which includes this header first
+#ifndef PROFILER_ENABLED
+	#define PROFILER_ENABLED 1
+#endif
+
+// Totals of one ProfiledMutex since it was created, diff two snapshots (by lockId) for a period. Times in nanoseconds.
+// Condition waits are the time spent blocked in ProfiledConditionVariable::wait, waking up included.
+struct ProfilerLockStats
+{
+	const char* name = nullptr;
+	u32 lockId = 0;
+	u64 acquisitions = 0;
+	u64 contentions = 0;	// acquisitions that had to block
+	u64 waitNs = 0;
+	u64 maxWaitNs = 0;
+	u64 holdNs = 0;
+	u64 maxHoldNs = 0;
+	u64 conditionWaits = 0;
+	u64 conditionWaitNs = 0;
+
+	f32 GetContentionRatio() const { return acquisitions > 0 ? (f32)contentions / (f32)acquisitions : 0.0f; }
+};
+
+#if PROFILER_ENABLED
+
+// std::mutex that counts how often and how long it is waited for and held. Meets the standard
+// Lockable requirements (hence the std naming), lock_guard and unique_lock take it as is.
+//
+// Uncontended, a lock is a try_lock plus a clock read and an unlock another clock read. The
+// counters are only written while the mutex is held, so they need no atomic read-modify-write,
+// they are atomics for the readers. A contended lock blocks inside a "Lock Wait: <name>" scope
+// so waits show on the timeline and in trace captures, unless bRecordWaits is off (the
+// Profiler's own lock, which would otherwise record into itself).
+class ProfiledMutex
+{
+public:
+	// Name is a code literal, the pointer is kept
+	explicit ProfiledMutex(const char* name, bool bRecordWaits = true);
+	~ProfiledMutex();
+
+	NO_COPY(ProfiledMutex);
+	NO_MOVE(ProfiledMutex);
+
+	void lock()
+	{
+		if(!m_mutex.try_lock())
+		{
+			LockContended();
+		}
+		Add(m_acquisitions, 1);
+		m_acquireTicks = ProfilerClock::Now();
+	}
+
+	bool try_lock()
+	{
+		if(!m_mutex.try_lock())
+		{
+			return false;
+		}
+		Add(m_acquisitions, 1);
+		m_acquireTicks = ProfilerClock::Now();
+		return true;
+	}
+
+	void unlock()
+	{
+		const u64 holdTicks = ProfilerClock::Now() - m_acquireTicks;
+		Add(m_holdTicks, holdTicks);
+		Max(m_maxHoldTicks, holdTicks);
+		m_mutex.unlock();
+	}
+
+	const char* GetName() const { return m_name; }
+	void GetStats(ProfilerLockStats& rOutStats) const;
+
+	// By ProfiledConditionVariable, with the mutex held
+	void RecordConditionWait(u64 ticks)
+	{
+		Add(m_conditionWaits, 1);
+		Add(m_conditionWaitTicks, ticks);
+	}
+
+private:
+	friend class ProfilerLocks;
+
+	void LockContended();
+
+	static void Add(std::atomic<u64>& rCounter, u64 value)
+	{
+		rCounter.store(rCounter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	}
+	static void Max(std::atomic<u64>& rCounter, u64 value)
+	{
+		if(value > rCounter.load(std::memory_order_relaxed))
+		{
+			rCounter.store(value, std::memory_order_relaxed);
+		}
+	}
+
+	std::mutex m_mutex;
+	const char* m_name;
+	u32 m_lockId = 0;
+	ProfilerScopeId m_waitScopeId = ProfilerScopes::UNKNOWN_SCOPE;
+	bool m_bRecordWaits;
+
+	u64 m_acquireTicks = 0;
+	std::atomic<u64> m_acquisitions{ 0 };
+	std::atomic<u64> m_contentions{ 0 };
+	std::atomic<u64> m_waitTicks{ 0 };
+	std::atomic<u64> m_maxWaitTicks{ 0 };
+	std::atomic<u64> m_holdTicks{ 0 };
+	std::atomic<u64> m_maxHoldTicks{ 0 };
+	std::atomic<u64> m_conditionWaits{ 0 };
+	std::atomic<u64> m_conditionWaitTicks{ 0 };
+};
+
+// Lock to wait on a ProfiledConditionVariable with. Use this over naming the unique_lock: compiled
+// out, it's a std::mutex lock for a plain std::condition_variable.
+using ProfiledUniqueLock = std::unique_lock<ProfiledMutex>;
+
+// std::condition_variable for a ProfiledMutex (std::condition_variable only takes std::mutex),
+// timing every wait on the mutex's stats
+class ProfiledConditionVariable
+{
+public:
+	ProfiledConditionVariable() = default;
+
+	NO_COPY(ProfiledConditionVariable);
+	NO_MOVE(ProfiledConditionVariable);
+
+	template<typename Predicate>
+	void wait(ProfiledUniqueLock& rLock, Predicate predicate)
+	{
+		if(predicate())
+		{
+			return;
+		}
+		const u64 startTicks = ProfilerClock::Now();
+		m_condition.wait(rLock, predicate);
+		rLock.mutex()->RecordConditionWait(ProfilerClock::Now() - startTicks);
+	}
+
+	void notify_one() noexcept { m_condition.notify_one(); }
+	void notify_all() noexcept { m_condition.notify_all(); }
+
+private:
+	std::condition_variable_any m_condition;
+};
+
+// Every live ProfiledMutex, for the editor and trace captures
+class ProfilerLocks
+{
+public:
+	static void GetStats(std::vector<ProfilerLockStats>& rOutStats);
+
+private:
+	friend class ProfiledMutex;
+
+	static u32 Add(ProfiledMutex* pMutex);
+	static void Remove(ProfiledMutex* pMutex);
+};
+
+#else
+
+// Profiler compiled out: plain std types, names ignored. The lock holds the std::mutex base, so the
+// condition variable is the plain one, not condition_variable_any.
+class ProfiledMutex : public std::mutex
+{
+public:
+	explicit ProfiledMutex(const char*, bool = true) {}
+};
+
+using ProfiledUniqueLock = std::unique_lock<std::mutex>;
+using ProfiledConditionVariable = std::condition_variable;
+
+class ProfilerLocks
+{
+public:
+	static void GetStats(std::vector<ProfilerLockStats>& rOutStats) { rOutStats.clear(); }
+};
+
+#endif
@@ -0,0 +1,73 @@
+#include "profiler_scope.h"
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace
+{
+	std::mutex s_scopeMutex;
+
+	struct InternedScope
+	{
+		std::string name;
+		ProfilerScopeDesc desc;
+	};
+
+	// Deque, interned descriptors never move
+	std::deque<InternedScope>& GetInternedScopes()
+	{
+		static std::deque<InternedScope> s_internedScopes;
+		return s_internedScopes;
+	}
+
+	std::unordered_map<std::string_view, ProfilerScopeId>& GetInternedIds()
+	{
+		static std::unordered_map<std::string_view, ProfilerScopeId> s_internedIds;
+		return s_internedIds;
+	}
+}
+
+const ProfilerScopeDesc ProfilerScopes::sm_unknownScope = { "?", "", 0, 0 };
+const ProfilerScopeDesc* ProfilerScopes::sm_scopes[MAX_SCOPES] = { &sm_unknownScope };
+std::atomic<u32> ProfilerScopes::sm_numScopes{ 1 };
+
+ProfilerScopeId ProfilerScopes::Register(const ProfilerScopeDesc& desc)
+{
+	std::lock_guard<std::mutex> lock(s_scopeMutex);
+	return Add(&desc);
+}
+
+ProfilerScopeId ProfilerScopes::Intern(std::string_view name)
+{
+	std::lock_guard<std::mutex> lock(s_scopeMutex);
+
+	auto it = GetInternedIds().find(name);
+	if(it != GetInternedIds().end())
+	{
+		return it->second;
+	}
+
+	InternedScope& rScope = GetInternedScopes().emplace_back();
+	rScope.name = name;
+	rScope.desc = { rScope.name.c_str(), "", 0, 0 };
+
+	const ProfilerScopeId id = Add(&rScope.desc);
+	GetInternedIds().emplace(rScope.name, id);
+	return id;
+}
+
+ProfilerScopeId ProfilerScopes::Add(const ProfilerScopeDesc* pDesc)
+{
+	const u32 index = sm_numScopes.load(std::memory_order_relaxed);
+	if(index >= MAX_SCOPES)
+	{
+		LOG_WARNING("Profiler: more than %u scopes, '%s' is recorded as '?'", MAX_SCOPES, pDesc->name);
+		return UNKNOWN_SCOPE;
+	}
+
+	sm_scopes[index] = pDesc;
+	sm_numScopes.store(index + 1, std::memory_order_release);
+	return (ProfilerScopeId)index;
+}
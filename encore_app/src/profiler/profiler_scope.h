@@ -0,0 +1,50 @@
+#pragma once
+
+#include "core/core_minimal.h"
+
+#include <atomic>
+#include <string_view>
+
+using ProfilerScopeId = u16;
+
+// What a profiled scope is, built at compile time as a static per PROFILE / PROFILE_SCOPE callsite.
+// Ring slots and entries only carry its id.
+struct ProfilerScopeDesc
+{
+	const char* name;
+	const char* file;
+	u32 line;
+	u32 color;	// ImU32 layout (0xAABBGGRR), 0 lets the viewer pick one
+};
+
+// Table of every scope descriptor, append-only. A callsite registers its descriptor the first time it
+// runs (a function-local static, one guard check afterwards). Runtime names, like task names, are
+// interned by value once and kept forever.
+//
+// Lookups take no lock: an id only reaches a reader through the ring it was written to, after the
+// descriptor was stored.
+class ProfilerScopes
+{
+public:
+	static constexpr u32 MAX_SCOPES = 8192;
+	static constexpr ProfilerScopeId UNKNOWN_SCOPE = 0;
+
+	static ProfilerScopeId Register(const ProfilerScopeDesc& desc);
+	static ProfilerScopeId Intern(std::string_view name);
+
+	static const ProfilerScopeDesc& Get(ProfilerScopeId id)
+	{
+		const ProfilerScopeDesc* pDesc = id < MAX_SCOPES ? sm_scopes[id] : nullptr;
+		return pDesc ? *pDesc : sm_unknownScope;
+	}
+	static const char* GetName(ProfilerScopeId id) { return Get(id).name; }
+
+	static u32 GetNumScopes() { return sm_numScopes.load(std::memory_order_acquire); }
+
+private:
+	static ProfilerScopeId Add(const ProfilerScopeDesc* pDesc);
+
+	static const ProfilerScopeDesc sm_unknownScope;
+	static const ProfilerScopeDesc* sm_scopes[MAX_SCOPES];
+	static std::atomic<u32> sm_numScopes;
+};
@@ -0,0 +1,168 @@
+#include "profiler_trace.h"
+
+#include <cstdio>
+#include <ctime>
+
+namespace
+{
+	// Section names are code literals, only quotes, backslashes and control characters need care
+	void WriteJsonString(FILE* pFile, const char* text)
+	{
+		fputc('"', pFile);
+		for(const char* c = text; *c; c++)
+		{
+			switch(*c)
+			{
+			case '"': fputs("\\\"", pFile); break;
+			case '\\': fputs("\\\\", pFile); break;
+			case '\n': fputs("\\n", pFile); break;
+			case '\t': fputs("\\t", pFile); break;
+			default:
+				if((u8)*c < 0x20)
+				{
+					fprintf(pFile, "\\u%04x", (u8)*c);
+				}
+				else
+				{
+					fputc(*c, pFile);
+				}
+				break;
+			}
+		}
+		fputc('"', pFile);
+	}
+
+	// Trace timestamps are microseconds, keep the nanoseconds as decimals
+	f64 ToTraceUs(u64 ns, u64 originNs)
+	{
+		return (f64)(ns - originNs) / 1000.0;
+	}
+}
+
+bool ProfilerTrace::WriteChromeJson(const std::string& path) const
+{
+	FILE* pFile = fopen(path.c_str(), "wb");
+	if(!pFile)
+	{
+		LOG_ERROR("Profiler: couldn't open '%s' for the trace", path.c_str());
+		return false;
+	}
+
+	u64 originNs = frameStartNs.empty() ? UINT64_MAX : frameStartNs.front();
+	for(const ProfilerEntry& entry : entries)
+	{
+		originNs = entry.timestamp < originNs ? entry.timestamp : originNs;
+	}
+	for(const ProfilerCounterSample& sample : counterSamples)
+	{
+		originNs = sample.timestamp < originNs ? sample.timestamp : originNs;
+	}
+	for(const LockSample& sample : lockSamples)
+	{
+		originNs = sample.timestamp < originNs ? sample.timestamp : originNs;
+	}
+	for(const ProfilerJobFlow& job : jobs)
+	{
+		originNs = job.enqueueTime < originNs ? job.enqueueTime : originNs;
+	}
+
+	// Chrome thread ids are the Profiler's thread indices, 0 is taken by the frame markers
+	auto toTid = [](u8 threadIndex) { return (u32)threadIndex + 1; };
+
+	fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", pFile);
+	fputs("{\"ph\":\"M\",\"pid\":1,\"tid\":0,\"name\":\"process_name\",\"args\":{\"name\":\"encore\"}}", pFile);
+
+	for(const auto& [threadIndex, name] : threadNames)
+	{
+		const u32 tid = toTid(threadIndex);
+		fprintf(pFile, ",\n{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":", tid);
+		WriteJsonString(pFile, name.c_str());
+		fprintf(pFile, "}},\n{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_sort_index\",\"args\":{\"sort_index\":%u}}", tid, tid);
+	}
+
+	for(u64 i = 0; i < frameStartNs.size(); i++)
+	{
+		fprintf(pFile, ",\n{\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"name\":\"Frame %llu\",\"ts\":%.3f}",
+			(unsigned long long)i, ToTraceUs(frameStartNs[i], originNs));
+	}
+
+	for(const ProfilerEntry& entry : entries)
+	{
+		fprintf(pFile, ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"name\":",
+			toTid(entry.threadIndex), ToTraceUs(entry.timestamp, originNs), (f64)entry.duration / 1000.0);
+		const ProfilerScopeDesc& scope = entry.GetScope();
+		WriteJsonString(pFile, scope.name);
+		if(scope.file[0] != '\0')
+		{
+			fputs(",\"args\":{\"file\":", pFile);
+			WriteJsonString(pFile, scope.file);
+			fprintf(pFile, ",\"line\":%u}", scope.line);
+		}
+		fputc('}', pFile);
+	}
+
+	for(const ProfilerCounterSample& sample : counterSamples)
+	{
+		fprintf(pFile, ",\n{\"ph\":\"C\",\"pid\":1,\"tid\":0,\"ts\":%.3f,\"name\":", ToTraceUs(sample.timestamp, originNs));
+		WriteJsonString(pFile, sample.name ? sample.name : "?");
+		fprintf(pFile, ",\"args\":{\"value\":%.15g}}", sample.value);
+	}
+
+	for(const LockSample& sample : lockSamples)
+	{
+		const f64 ts = ToTraceUs(sample.timestamp, originNs);
+		fprintf(pFile, ",\n{\"ph\":\"C\",\"pid\":1,\"tid\":0,\"ts\":%.3f,\"name\":", ts);
+		WriteJsonString(pFile, (std::string("Lock: ") + sample.name).c_str());
+		fprintf(pFile, ",\"args\":{\"wait_us\":%.3f,\"hold_us\":%.3f}}", (f64)sample.waitNs / 1000.0, (f64)sample.holdNs / 1000.0);
+
+		fprintf(pFile, ",\n{\"ph\":\"C\",\"pid\":1,\"tid\":0,\"ts\":%.3f,\"name\":", ts);
+		WriteJsonString(pFile, (std::string("Lock Contentions: ") + sample.name).c_str());
+		fprintf(pFile, ",\"args\":{\"value\":%llu}}", (unsigned long long)sample.contentions);
+	}
+
+	for(u64 i = 0; i < jobs.size(); i++)
+	{
+		const ProfilerJobFlow& job = jobs[i];
+		const char* name = job.scopeId != ProfilerScopes::UNKNOWN_SCOPE ? ProfilerScopes::GetName(job.scopeId) : "Job";
+
+		fprintf(pFile, ",\n{\"ph\":\"s\",\"cat\":\"job\",\"id\":%llu,\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"name\":",
+			(unsigned long long)i, toTid(job.producerThread), ToTraceUs(job.enqueueTime, originNs));
+		WriteJsonString(pFile, name);
+		fprintf(pFile, ",\"args\":{\"queue_wait_us\":%.3f,\"run_us\":%.3f}}", (f64)job.GetQueueWaitNs() / 1000.0, (f64)job.GetRunNs() / 1000.0);
+
+		fprintf(pFile, ",\n{\"ph\":\"f\",\"cat\":\"job\",\"id\":%llu,\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"name\":",
+			(unsigned long long)i, toTid(job.workerThread), ToTraceUs(job.startTime, originNs));
+		WriteJsonString(pFile, name);
+		fputc('}', pFile);
+	}
+
+	fputs("\n]}\n", pFile);
+
+	const bool bOk = ferror(pFile) == 0;
+	fclose(pFile);
+
+	if(!bOk)
+	{
+		LOG_ERROR("Profiler: failed writing the trace to '%s'", path.c_str());
+		return false;
+	}
+
+	LOG_INFO("Profiler: wrote %zu scopes, %zu counter samples and %zu jobs over %zu frames to '%s'", entries.size(), counterSamples.size(),
+		jobs.size(), frameStartNs.size(), path.c_str());
+	return true;
+}
+
+std::string ProfilerTrace::MakeDefaultPath()
+{
+	const std::time_t now = std::time(nullptr);
+	std::tm localTime;
+#ifdef _WIN32
+	localtime_s(&localTime, &now);
+#else
+	localtime_r(&now, &localTime);
+#endif
+
+	char path[64];
+	std::strftime(path, sizeof(path), "trace_%Y%m%d_%H%M%S.json", &localTime);
+	return path;
+}
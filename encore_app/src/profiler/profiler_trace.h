@@ -0,0 +1,60 @@
+#pragma once
+
+#include "core/core_minimal.h"
+
+#include "profiler_lock.h"
+#include "profiler_types.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// Published frames collected for offline analysis, written in the Chrome trace event format
+// (JSON). chrome://tracing, ui.perfetto.dev and Speedscope open it as is.
+//
+// Scopes become complete events ("X") and nest by time on their thread's track, every publish
+// adds a global instant event ("Frame N") as frame marker, threads are named from SetThreadName.
+// Scopes declared with PROFILE / PROFILE_SCOPE carry their file and line as args.
+// Counters become counter events ("C"), one track per name: plots at every sample, PROFILE_COUNTER
+// totals once per frame.
+// Every ProfiledMutex adds two counter tracks with its frame totals: "Lock: <name>" (wait and hold
+// time) and "Lock Contentions: <name>". Contended waits are also scopes, "Lock Wait: <name>".
+// Jobs become flow events ("s" / "f"), an arrow from the scope queuing a job to the first scope
+// starting on the worker once it picked the job up (the job's own scope for task graph jobs).
+struct ProfilerTrace
+{
+	// One lock over one frame
+	struct LockSample
+	{
+		const char* name;
+		u64 timestamp;
+		u64 contentions;
+		u64 waitNs;
+		u64 holdNs;
+	};
+
+	std::vector<ProfilerEntry> entries;
+	std::vector<ProfilerCounterSample> counterSamples;
+	std::vector<LockSample> lockSamples;
+	std::vector<ProfilerJobFlow> jobs;
+	std::vector<u64> frameStartNs;
+	std::vector<std::pair<u8, std::string>> threadNames;	// by thread index
+
+	bool WriteChromeJson(const std::string& path) const;
+
+	// trace_YYYYMMDD_HHMMSS.json in the working directory
+	static std::string MakeDefaultPath();
+};
+
+// Capture in progress, owned by the Profiler and fed on every ClearAllThreads
+struct ProfilerTraceCapture
+{
+	static constexpr u32 DEFAULT_NUM_FRAMES = 120;
+
+	std::string path;
+	u32 numFrames = 0;
+	ProfilerTrace trace;
+	std::vector<ProfilerLockStats> lockStats;	// at the last frame, to diff against
+
+	bool IsComplete() const { return trace.frameStartNs.size() >= numFrames; }
+};
@@ -2,7 +2,16 @@
 
 #include "core/core_minimal.h"
 
+#include "profiler_hw_counters.h"
+#include "profiler_scope.h"
+
+#include <atomic>
+#include <bit>
+#include <functional>
+#include <string>
+#include <string_view>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 enum class FrameCategory
@@ -13,23 +22,298 @@ enum class FrameCategory
 	RENDER
 };
 
+// A finished scope, timestamp and duration in nanoseconds (ProfilerClock::ToNs). The thread is its
+// index in the Profiler (registration order), the name comes from the scope descriptor.
 struct ProfilerEntry
 {
-	const char* section;
 	u64 timestamp;
 	u64 duration;
-	std::thread::id threadId;
+	ProfilerScopeId scopeId;
+	u8 threadIndex;
 	u8 depth;
 
-	ProfilerEntry(const char* name, u64 inTimestamp, u64 inDuration, u8 inDepth, std::thread::id tid)
-		: section(name), timestamp(inTimestamp), duration(inDuration), depth(inDepth), threadId(tid)
+	ProfilerEntry(ProfilerScopeId inScopeId, u64 inTimestamp, u64 inDuration, u8 inDepth, u8 inThreadIndex)
+		: timestamp(inTimestamp), duration(inDuration), scopeId(inScopeId), threadIndex(inThreadIndex), depth(inDepth)
 	{}
+
+	const ProfilerScopeDesc& GetScope() const { return ProfilerScopes::Get(scopeId); }
+	const char* GetName() const { return ProfilerScopes::GetName(scopeId); }
 };
 
-// Per-thread profiling data
-struct ProfilerThreadData
+enum class ProfilerCounterKind : u8
+{
+	Counter,	// PROFILE_COUNTER, added up over the frame
+	Plot		// PROFILE_PLOT, sampled, the frame keeps the last sample
+};
+
+// One PROFILE_COUNTER / PROFILE_PLOT call, timestamp in nanoseconds
+struct ProfilerCounterSample
+{
+	const char* name;
+	u64 timestamp;
+	f64 value;
+	ProfilerCounterKind kind;
+};
+
+// A counter over one published frame, all threads: the sum of its PROFILE_COUNTER values or its
+// last PROFILE_PLOT sample
+struct ProfilerCounterValue
+{
+	const char* name = nullptr;
+	f64 value = 0.0;
+	u64 timestamp = 0;	// of the last sample
+	u32 numSamples = 0;
+	ProfilerCounterKind kind = ProfilerCounterKind::Counter;
+};
+
+// Taken on the thread queuing a job (PROFILE_JOB_ENQUEUE), travels with the job to its worker
+struct ProfilerJobStamp
+{
+	u64 enqueueTicks = 0;	// 0: not stamped, the job records nothing
+	u8 producerThread = 0;
+};
+
+// One job from the thread that queued it to the one that ran it (PROFILE_JOB_RUN), nanoseconds
+// like entries. The scope is the job's name, UNKNOWN_SCOPE for anonymous jobs.
+struct ProfilerJobFlow
+{
+	u64 enqueueTime;
+	u64 startTime;
+	u64 endTime;
+	ProfilerScopeId scopeId;
+	u8 producerThread;
+	u8 workerThread;
+
+	u64 GetQueueWaitNs() const { return startTime > enqueueTime ? startTime - enqueueTime : 0; }
+	u64 GetRunNs() const { return endTime - startTime; }
+};
+
+// Queue wait of jobs in power of two buckets: bucket i counts waits in [2^i, 2^(i+1)) ns, the last
+// one everything from 2^(NUM_BUCKETS - 1) ns (~2 s) up
+struct ProfilerJobHistogram
+{
+	static constexpr u32 NUM_BUCKETS = 32;
+
+	u64 buckets[NUM_BUCKETS] = {};
+	u64 numJobs = 0;
+	u64 totalWaitNs = 0;
+	u64 maxWaitNs = 0;
+	u64 totalRunNs = 0;
+
+	static u32 GetBucket(u64 ns)
+	{
+		const u32 bucket = ns > 0 ? (u32)std::bit_width(ns) - 1 : 0;
+		return bucket < NUM_BUCKETS ? bucket : NUM_BUCKETS - 1;
+	}
+
+	void Add(const ProfilerJobFlow& job)
+	{
+		const u64 waitNs = job.GetQueueWaitNs();
+		buckets[GetBucket(waitNs)]++;
+		numJobs++;
+		totalWaitNs += waitNs;
+		maxWaitNs = waitNs > maxWaitNs ? waitNs : maxWaitNs;
+		totalRunNs += job.GetRunNs();
+	}
+
+	// Upper bound of the bucket holding the percentile (capped by the max), within a factor of two
+	u64 GetPercentileNs(f32 percentile) const
+	{
+		const u64 rank = (u64)((f64)numJobs * (f64)percentile);
+		u64 count = 0;
+		for(u32 i = 0; i < NUM_BUCKETS; i++)
+		{
+			count += buckets[i];
+			if(count > rank)
+			{
+				const u64 upperNs = (u64)2 << i;
+				return upperNs < maxWaitNs ? upperNs : maxWaitNs;
+			}
+		}
+		return maxWaitNs;
+	}
+
+	// Share of the jobs' time from queued to done spent waiting in the queue
+	f32 GetWaitRatio() const { return totalWaitNs + totalRunNs > 0 ? (f32)totalWaitNs / (f32)(totalWaitNs + totalRunNs) : 0.0f; }
+};
+
+// A published frame kept in the Profiler's history. Holds the scopes that closed between two
+// publishes, its duration is the time between them.
+struct ProfilerFrame
 {
+	u64 frameIndex = 0;
+	u64 startNs = 0;
+	u64 durationNs = 0;
+	bool bSpike = false;
 	std::vector<ProfilerEntry> entries;
+	std::vector<ProfilerCounterSample> counterSamples;
+	std::vector<ProfilerCounterValue> counters;	// sorted by name
+	std::vector<ProfilerJobFlow> jobs;
+};
+
+// Hardware counts of one PROFILE_SCOPE_HW run
+struct ProfilerHwSample
+{
+	ProfilerScopeId scopeId;
+	ProfilerHwCounts counts;
+};
+
+// Hardware counts of a scope, all threads: over the last published frame and since the last reset
+struct ProfilerHwScopeStats
+{
+	ProfilerScopeId scopeId = ProfilerScopes::UNKNOWN_SCOPE;
+	u32 frameCalls = 0;
+	ProfilerHwCounts frame;
+	u64 totalCalls = 0;
+	ProfilerHwCounts total;
+};
+
+// Rolling numbers for one section on one thread, over the frames it ran in. Times are the
+// section's total per frame (all its calls), in nanoseconds.
+struct ProfilerSectionStats
+{
+	const char* section = nullptr;	// owned by the Profiler, valid until SetStatsWindow
+	u8 threadIndex = 0;
+	u32 numFrames = 0;
+	f32 callsPerFrame = 0.0f;
+	u64 minNs = 0;
+	u64 avgNs = 0;
+	u64 maxNs = 0;
+	u64 p95Ns = 0;
+	u64 p99Ns = 0;
+	u64 lastNs = 0;
+};
+
+// Per-frame totals of a section, the last statsWindow frames it ran in
+struct ProfilerSectionSamples
+{
+	struct Sample
+	{
+		u64 frameIndex = 0;
+		u64 ns = 0;
+		u32 calls = 0;
+	};
+
+	std::vector<Sample> samples;	// ring once full
+	u32 last = 0;
+
+	void Add(u64 frameIndex, u64 ns, u32 window)
+	{
+		if(!samples.empty() && samples[last].frameIndex == frameIndex)
+		{
+			samples[last].ns += ns;
+			samples[last].calls++;
+			return;
+		}
+
+		if(samples.size() < window)
+		{
+			last = (u32)samples.size();
+			samples.push_back({ frameIndex, ns, 1 });
+		}
+		else
+		{
+			last = (last + 1) % window;
+			samples[last] = { frameIndex, ns, 1 };
+		}
+	}
+};
+
+struct ProfilerStringHash
+{
+	using is_transparent = void;
+	u64 operator()(std::string_view text) const { return std::hash<std::string_view>{}(text); }
+};
+
+// One ring slot, written by the owning thread and read by the publisher. Relaxed atomics compile to
+// plain moves on x86, they only make the publisher's read of a slot being reused well defined.
+struct ProfilerSlot
+{
+	std::atomic<u64> startTicks{ 0 };
+	std::atomic<u64> endTicks{ 0 };	// 0 while the scope is open
+	std::atomic<ProfilerScopeId> scopeId{ ProfilerScopes::UNKNOWN_SCOPE };
+	std::atomic<u8> depth{ 0 };
+};
+
+// Counter ring slot, same rules as ProfilerSlot
+struct ProfilerCounterSlot
+{
+	std::atomic<const char*> name{ nullptr };
+	std::atomic<u64> ticks{ 0 };
+	std::atomic<f64> value{ 0.0 };
+	std::atomic<ProfilerCounterKind> kind{ ProfilerCounterKind::Counter };
+};
+
+// Hardware counter ring slot, same rules as ProfilerSlot
+struct ProfilerHwSlot
+{
+	std::atomic<ProfilerScopeId> scopeId{ ProfilerScopes::UNKNOWN_SCOPE };
+	std::atomic<u64> cycles{ 0 };
+	std::atomic<u64> instructions{ 0 };
+	std::atomic<u64> cacheMisses{ 0 };
+	std::atomic<u64> branchMisses{ 0 };
+};
+
+// Job ring slot, written by the worker once the job ran, same rules as ProfilerSlot
+struct ProfilerJobSlot
+{
+	std::atomic<u64> enqueueTicks{ 0 };
+	std::atomic<u64> startTicks{ 0 };
+	std::atomic<u64> endTicks{ 0 };
+	std::atomic<ProfilerScopeId> scopeId{ ProfilerScopes::UNKNOWN_SCOPE };
+	std::atomic<u8> producerThread{ 0 };
+};
+
+// Per-thread profiling data. The owner appends scopes to a fixed ring, nothing allocates after
+// registration. Publishing copies the scopes finished since the last frame into a back buffer and
+// swaps it with lastEntries.
+struct ProfilerThreadData
+{
+	static constexpr u64 RING_SIZE = 8192;	// scopes, a frame's worth per thread with margin
+	static constexpr u64 RING_MASK = RING_SIZE - 1;
+	static_assert((RING_SIZE & RING_MASK) == 0, "RING_SIZE must be a power of two");
+	static constexpr u64 COUNTER_RING_SIZE = 1024;
+	static constexpr u64 COUNTER_RING_MASK = COUNTER_RING_SIZE - 1;
+	static_assert((COUNTER_RING_SIZE & COUNTER_RING_MASK) == 0, "COUNTER_RING_SIZE must be a power of two");
+	static constexpr u64 HW_RING_SIZE = 1024;
+	static constexpr u64 HW_RING_MASK = HW_RING_SIZE - 1;
+	static_assert((HW_RING_SIZE & HW_RING_MASK) == 0, "HW_RING_SIZE must be a power of two");
+	static constexpr u64 JOB_RING_SIZE = 2048;
+	static constexpr u64 JOB_RING_MASK = JOB_RING_SIZE - 1;
+	static_assert((JOB_RING_SIZE & JOB_RING_MASK) == 0, "JOB_RING_SIZE must be a power of two");
+
+	ProfilerSlot slots[RING_SIZE];
+	std::atomic<u64> writeIndex{ 0 };	// owner only writes, publisher reads
+	u8 depth = 0;						// owner only
+
+	ProfilerCounterSlot counterSlots[COUNTER_RING_SIZE];
+	std::atomic<u64> counterWriteIndex{ 0 };
+
+	ProfilerHwSlot hwSlots[HW_RING_SIZE];
+	std::atomic<u64> hwWriteIndex{ 0 };
+	ProfilerHwGroup hwGroup;	// owner only
+
+	ProfilerJobSlot jobSlots[JOB_RING_SIZE];
+	std::atomic<u64> jobWriteIndex{ 0 };
+
+	std::thread::id threadId;
+	u8 threadIndex = 0;
+
+	// Publisher only
+	u64 readIndex = 0;
+	u64 numDropped = 0;
+	std::vector<ProfilerEntry> publishEntries;
+	u64 counterReadIndex = 0;
+	std::vector<ProfilerCounterSample> publishCounters;
+	u64 hwReadIndex = 0;
+	std::vector<ProfilerHwSample> publishHwSamples;
+	u64 jobReadIndex = 0;
+	std::vector<ProfilerJobFlow> publishJobs;
+	std::unordered_map<std::string, ProfilerSectionSamples, ProfilerStringHash, std::equal_to<>> sectionSamples;
+
+	// Swapped in under Profiler::m_threadDataMutex
 	std::vector<ProfilerEntry> lastEntries;
-	u8 depth = 0;
+	std::vector<ProfilerCounterSample> lastCounters;
+	std::vector<ProfilerHwSample> lastHwSamples;
+	std::vector<ProfilerJobFlow> lastJobs;
 };
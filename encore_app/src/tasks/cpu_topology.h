@@ -0,0 +1,258 @@
+#pragma once
+
+#include "core/core_minimal.h"
+
+#include "utils/command_line.h"
+#include "utils/utils_math.h"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// Which logical CPUs share a physical core. Linux reads /sys/devices/system/cpu, Windows asks
+// GetLogicalProcessorInformationEx. Anywhere else every logical CPU counts as its own core.
+struct CpuTopology
+{
+	struct Core
+	{
+		u32 packageId = 0;
+		u32 coreId = 0;
+		std::vector<u32> cpus;	// logical CPUs (SMT siblings), lowest first
+	};
+
+	std::vector<Core> cores;	// ordered by their first logical CPU
+	u32 numLogicalCpus = 0;
+
+	bool HasSmt() const { return numLogicalCpus > cores.size(); }
+
+	static CpuTopology Detect()
+	{
+		CpuTopology topology;
+#if defined(__linux__)
+		topology.ReadLinuxSysfs();
+#elif defined(_WIN32)
+		topology.ReadWindowsProcessorInfo();
+#endif
+		if (topology.cores.empty())
+		{
+			topology.AssumeNoSmt();
+		}
+		return topology;
+	}
+
+private:
+	void AssumeNoSmt()
+	{
+		cores.clear();
+		numLogicalCpus = utils::Max(1u, std::thread::hardware_concurrency());
+		for (u32 cpu = 0; cpu < numLogicalCpus; cpu++)
+		{
+			cores.push_back({ 0, cpu, { cpu } });
+		}
+	}
+
+#if defined(__linux__)
+	static bool ReadU32(const std::string& path, u32& rOutValue)
+	{
+		std::ifstream file(path);
+		return (bool)(file >> rOutValue);
+	}
+
+	// "0-3,6,8-11"
+	static std::vector<u32> ParseCpuList(const std::string& list)
+	{
+		std::vector<u32> cpus;
+		u64 position = 0;
+		while (position < list.size())
+		{
+			u64 end = list.find(',', position);
+			if (end == std::string::npos)
+			{
+				end = list.size();
+			}
+
+			const std::string range = list.substr(position, end - position);
+			const u64 dash = range.find('-');
+			const u32 first = (u32)std::strtoul(range.c_str(), nullptr, 10);
+			const u32 last = dash != std::string::npos ? (u32)std::strtoul(range.c_str() + dash + 1, nullptr, 10) : first;
+			for (u32 cpu = first; cpu <= last; cpu++)
+			{
+				cpus.push_back(cpu);
+			}
+			position = end + 1;
+		}
+		return cpus;
+	}
+
+	void ReadLinuxSysfs()
+	{
+		std::ifstream onlineFile("/sys/devices/system/cpu/online");
+		std::string online;
+		if (!std::getline(onlineFile, online))
+		{
+			return;
+		}
+
+		for (u32 cpu : ParseCpuList(online))
+		{
+			const std::string topologyPath = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+			u32 packageId = 0;
+			u32 coreId = cpu;
+			ReadU32(topologyPath + "physical_package_id", packageId);
+			ReadU32(topologyPath + "core_id", coreId);
+
+			auto it = std::find_if(cores.begin(), cores.end(), [&](const Core& core) {
+				return core.packageId == packageId && core.coreId == coreId;
+			});
+			if (it == cores.end())
+			{
+				cores.push_back({ packageId, coreId, { cpu } });
+			}
+			else
+			{
+				it->cpus.push_back(cpu);
+			}
+			numLogicalCpus++;
+		}
+	}
+#endif
+
+#if defined(_WIN32)
+	void ReadWindowsProcessorInfo()
+	{
+		DWORD size = 0;
+		GetLogicalProcessorInformationEx(RelationProcessorCore, nullptr, &size);
+		if (size == 0)
+		{
+			return;
+		}
+
+		std::vector<u8> buffer(size);
+		auto* pInfo = reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data());
+		if (!GetLogicalProcessorInformationEx(RelationProcessorCore, pInfo, &size))
+		{
+			return;
+		}
+
+		// One record per physical core, its mask holds the SMT siblings. Group 0 only, like utils::PinThreadToCpu.
+		for (DWORD offset = 0; offset < size;)
+		{
+			auto* pCore = reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data() + offset);
+			offset += pCore->Size;
+
+			if (pCore->Processor.GroupMask[0].Group != 0)
+			{
+				continue;
+			}
+
+			Core core;
+			core.coreId = (u32)cores.size();
+			const KAFFINITY mask = pCore->Processor.GroupMask[0].Mask;
+			for (u32 cpu = 0; cpu < 64; cpu++)
+			{
+				if (mask & ((KAFFINITY)1 << cpu))
+				{
+					core.cpus.push_back(cpu);
+				}
+			}
+
+			numLogicalCpus += (u32)core.cpus.size();
+			cores.push_back(std::move(core));
+		}
+	}
+#endif
+};
+
+// How the task workers are spread over the CPU. Without pinning the OS places the threads and
+// the worker count is maxWorkers (hardware_concurrency if 0), the other knobs only apply to pinning.
+//
+// Command line: --pin-workers, --pin-smt (use SMT siblings too), --no-reserve-main-core, --workers=N
+struct WorkerPlacement
+{
+	bool bPinWorkers = false;
+	// One worker per physical core, siblings share execution units and caches with the worker next door
+	bool bSkipSmtSiblings = true;
+	// Pin the main thread to the first core and keep workers off it
+	bool bReserveMainThreadCore = true;
+	// 0 = as many as the placement allows
+	u32 maxWorkers = 0;
+
+	static WorkerPlacement FromCommandLine()
+	{
+		const CommandLine& commandLine = CommandLine::GetInstance();
+
+		WorkerPlacement placement;
+		placement.bPinWorkers = commandLine.HasFlag("pin-workers");
+		placement.bSkipSmtSiblings = !commandLine.HasFlag("pin-smt");
+		placement.bReserveMainThreadCore = !commandLine.HasFlag("no-reserve-main-core");
+		placement.maxWorkers = commandLine.GetU32("workers", 0);
+		return placement;
+	}
+};
+
+// Result of applying a WorkerPlacement to a CpuTopology
+struct WorkerLayout
+{
+	u32 numWorkers = 0;
+	std::vector<u32> workerCpus;	// one per worker when pinning, empty otherwise
+	i32 mainThreadCpu = -1;			// -1 leaves the main thread alone
+
+	static WorkerLayout Plan(const CpuTopology& topology, const WorkerPlacement& placement)
+	{
+		WorkerLayout layout;
+
+		if (!placement.bPinWorkers)
+		{
+			layout.numWorkers = placement.maxWorkers > 0 ? placement.maxWorkers : utils::Max(1u, std::thread::hardware_concurrency());
+			return layout;
+		}
+
+		u64 firstWorkerCore = 0;
+		if (placement.bReserveMainThreadCore && topology.cores.size() > 1)
+		{
+			layout.mainThreadCpu = (i32)topology.cores[0].cpus[0];
+			firstWorkerCore = 1;
+		}
+
+		for (u64 i = firstWorkerCore; i < topology.cores.size(); i++)
+		{
+			const std::vector<u32>& cpus = topology.cores[i].cpus;
+			const u64 numCpus = placement.bSkipSmtSiblings ? 1 : cpus.size();
+			layout.workerCpus.insert(layout.workerCpus.end(), cpus.begin(), cpus.begin() + numCpus);
+		}
+
+		if (placement.maxWorkers > 0 && layout.workerCpus.size() > placement.maxWorkers)
+		{
+			layout.workerCpus.resize(placement.maxWorkers);
+		}
+
+		layout.numWorkers = (u32)layout.workerCpus.size();
+		return layout;
+	}
+
+	void Print(const CpuTopology& topology) const
+	{
+		LOG_INFO("CPU: %u logical CPUs on %u physical cores%s", topology.numLogicalCpus, (u32)topology.cores.size(),
+			topology.HasSmt() ? " (SMT)" : "");
+
+		if (workerCpus.empty())
+		{
+			LOG_INFO("Task workers: %u, not pinned", numWorkers);
+			return;
+		}
+
+		std::string cpus;
+		for (u32 cpu : workerCpus)
+		{
+			cpus += (cpus.empty() ? "" : ",") + std::to_string(cpu);
+		}
+		LOG_INFO("Task workers: %u pinned to CPUs %s, main thread %s", numWorkers, cpus.c_str(),
+			mainThreadCpu >= 0 ? std::to_string(mainThreadCpu).c_str() : "not pinned");
+	}
+};
@@ -0,0 +1,321 @@
+#pragma once
+
+#include "core/core_minimal.h"
+
+#include "thread_pool.h"
+#include "profiler/profiler_section.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <utils/utils_thread.h>
+
+enum class IoStatus : u8
+{
+	Ok,
+	NotFound,
+	Failed,
+	Cancelled
+};
+
+struct IoReadResult
+{
+	std::string path;
+	std::vector<u8> data;
+	IoStatus status = IoStatus::Ok;
+
+	bool IsOk() const { return status == IoStatus::Ok; }
+};
+
+// Returned by IoLane::ReadFile. Cancel is safe from any thread: a read still queued is dropped, one in
+// progress stops at the next chunk, and a completion not started yet is skipped. A callback
+// already running finishes.
+class IoRequest
+{
+public:
+	void Cancel() { m_bCancelled.store(true, std::memory_order_relaxed); }
+	bool IsCancelled() const { return m_bCancelled.load(std::memory_order_relaxed); }
+
+	// The callback ran, or the request was dropped after a Cancel
+	bool IsDone() const { return m_bDone.load(std::memory_order_acquire); }
+
+private:
+	friend class IoLane;
+
+	std::atomic<bool> m_bCancelled{ false };
+	std::atomic<bool> m_bDone{ false };
+};
+
+using IoRequestHandle = std::shared_ptr<IoRequest>;
+
+// Asynchronous file reads on a dedicated thread, so disk waits never sit on the main thread or
+// hold a pool worker. Reads are served highest priority first (FIFO within a priority). The
+// completion callback is queued on the ThreadPool with the same priority, on the main thread lane
+// for GL uploads or any worker for decoding.
+//
+//	ioLane.ReadFile(path, [](IoReadResult& result) { Decode(result.data); });
+//
+// From a coroutine:
+//
+//	IoReadResult file = co_await ioLane.ReadFileAsync(path, TaskPriority::High);
+class IoLane
+{
+public:
+	using CompletionFunction = std::function<void(IoReadResult& result)>;
+
+	explicit IoLane(ThreadPool& pool, const std::string& threadName = "IO")
+		: m_pool(pool)
+	{
+		m_thread = std::thread(&IoLane::Run, this, threadName);
+	}
+
+	~IoLane()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_bStop = true;
+		}
+		m_condition.notify_one();
+
+		if (m_thread.joinable())
+		{
+			m_thread.join();
+		}
+
+		// Whatever never got read is dropped, see Drop. Moved out first: a resumed coroutine may
+		// queue another read, which is dropped right away now that m_bStop is set.
+		for (auto& queue : m_queues)
+		{
+			std::deque<PendingRead> dropped;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				dropped.swap(queue);
+			}
+			for (PendingRead& read : dropped)
+			{
+				Drop(read);
+			}
+		}
+	}
+
+	NO_COPY(IoLane);
+	NO_MOVE(IoLane);
+
+	IoRequestHandle ReadFile(std::string path, CompletionFunction onComplete,
+		TaskPriority priority = TaskPriority::Normal, TaskAffinity callbackAffinity = TaskAffinity::AnyThread)
+	{
+		return Queue({ std::move(path), std::move(onComplete), priority, callbackAffinity, std::make_shared<IoRequest>() });
+	}
+
+	// co_await gives the IoReadResult. The coroutine resumes on a pool worker at the read's priority.
+	// A read dropped because the lane shut down resumes it with IoStatus::Cancelled, on the thread
+	// destroying the lane (or queuing the read, once it is shutting down).
+	struct ReadFileAwaiter
+	{
+		IoLane& ioLane;
+		std::string path;
+		TaskPriority priority;
+		IoReadResult result;
+
+		bool await_ready() const noexcept { return false; }
+
+		void await_suspend(std::coroutine_handle<> handle)
+		{
+			ioLane.Queue({ path, [this, handle](IoReadResult& readResult) {
+				result = std::move(readResult);
+				handle.resume();
+			}, priority, TaskAffinity::AnyThread, std::make_shared<IoRequest>(), true });
+		}
+
+		IoReadResult await_resume() { return std::move(result); }
+	};
+
+	ReadFileAwaiter ReadFileAsync(std::string path, TaskPriority priority = TaskPriority::Normal)
+	{
+		return ReadFileAwaiter{ *this, std::move(path), priority, {} };
+	}
+
+	// Queued or being read, completions not counted
+	u32 GetNumPending() const { return m_numPending.load(std::memory_order_relaxed); }
+	u64 GetTotalBytesRead() const { return m_totalBytesRead.load(std::memory_order_relaxed); }
+
+	ThreadPool& GetThreadPool() { return m_pool; }
+
+private:
+	// Large files are read in chunks so a cancel doesn't wait for the whole file
+	static constexpr u64 READ_CHUNK_SIZE = MB(1);
+
+	struct PendingRead
+	{
+		std::string path;
+		CompletionFunction onComplete;
+		TaskPriority priority;
+		TaskAffinity affinity;
+		IoRequestHandle handle;
+		bool bAlwaysComplete = false;	// the callback also runs for cancelled and dropped reads (awaiters must resume)
+	};
+
+	IoRequestHandle Queue(PendingRead read)
+	{
+		IoRequestHandle handle = read.handle;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			if (!m_bStop)
+			{
+				m_numPending.fetch_add(1, std::memory_order_relaxed);
+				m_queues[(u8)read.priority].push_back(std::move(read));
+				lock.unlock();
+				m_condition.notify_one();
+				return handle;
+			}
+		}
+
+		Drop(read);
+		return handle;
+	}
+
+	// Never read, the lane is shutting down. The callback runs here as Cancelled, unless its owner
+	// already cancelled it (then it's skipped as usual). Owners waiting on IsDone() are released.
+	void Drop(PendingRead& read)
+	{
+		if (read.bAlwaysComplete || !read.handle->IsCancelled())
+		{
+			IoReadResult result;
+			result.path = read.path;
+			result.status = IoStatus::Cancelled;
+			read.onComplete(result);
+		}
+		read.handle->m_bDone.store(true, std::memory_order_release);
+	}
+
+	bool PopRead(PendingRead& outRead)
+	{
+		for (auto& queue : m_queues)
+		{
+			if (!queue.empty())
+			{
+				outRead = std::move(queue.front());
+				queue.pop_front();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void Run(const std::string& threadName)
+	{
+		utils::NameThread(threadName);
+		PROFILE_SET_THREAD_NAME(threadName.c_str());
+
+		while (true)
+		{
+			PendingRead read;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_condition.wait(lock, [this, &read]() { return m_bStop || PopRead(read); });
+
+				if (m_bStop)
+				{
+					return;
+				}
+			}
+
+			IoReadResult result;
+			result.path = read.path;
+			result.status = read.handle->IsCancelled() ? IoStatus::Cancelled : ReadWholeFile(read.path, result.data, *read.handle);
+			m_numPending.fetch_sub(1, std::memory_order_relaxed);
+
+			if (result.status == IoStatus::Cancelled && !read.bAlwaysComplete)
+			{
+				read.handle->m_bDone.store(true, std::memory_order_release);
+				continue;
+			}
+
+			Complete(read, std::move(result));
+		}
+	}
+
+	IoStatus ReadWholeFile(const std::string& path, std::vector<u8>& outData, const IoRequest& request)
+	{
+		PROFILE_SCOPE("IoLane Read");
+
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file.is_open())
+		{
+			LOG_ERROR("IoLane: couldn't open '%s'", path.c_str());
+			return IoStatus::NotFound;
+		}
+
+		const std::streamoff end = file.tellg();
+		if (end < 0)
+		{
+			LOG_ERROR("IoLane: couldn't get the size of '%s'", path.c_str());
+			return IoStatus::Failed;
+		}
+
+		const u64 size = (u64)end;
+		file.seekg(0, std::ios::beg);
+		outData.resize(size);
+
+		for (u64 offset = 0; offset < size; offset += READ_CHUNK_SIZE)
+		{
+			if (request.IsCancelled())
+			{
+				outData.clear();
+				return IoStatus::Cancelled;
+			}
+
+			const u64 chunkSize = utils::Min(READ_CHUNK_SIZE, size - offset);
+			if (!file.read(reinterpret_cast<char*>(outData.data() + offset), chunkSize))
+			{
+				LOG_ERROR("IoLane: read failed for '%s' at %llu of %llu bytes", path.c_str(), offset, size);
+				outData.clear();
+				return IoStatus::Failed;
+			}
+			m_totalBytesRead.fetch_add(chunkSize, std::memory_order_relaxed);
+		}
+		return IoStatus::Ok;
+	}
+
+	// A pool that already stopped refuses the completion: it runs here instead, as Cancelled, so
+	// callbacks and awaiters still hear back (an IoLane should go before its pool, as in TaskSchedulerSystem)
+	void Complete(PendingRead& read, IoReadResult result)
+	{
+		// TaskFunction must be copyable, the result travels by shared_ptr
+		auto pResult = std::make_shared<IoReadResult>(std::move(result));
+		auto completion = [onComplete = std::move(read.onComplete), handle = read.handle, bAlways = read.bAlwaysComplete, pResult](float) {
+			if (bAlways || !handle->IsCancelled())
+			{
+				onComplete(*pResult);
+			}
+			handle->m_bDone.store(true, std::memory_order_release);
+		};
+
+		if (!m_pool.Enqueue(TaskPayload{ completion, 0.0f, read.priority, read.affinity }))
+		{
+			pResult->data.clear();
+			pResult->status = IoStatus::Cancelled;
+			completion(0.0f);
+		}
+	}
+
+	ThreadPool& m_pool;
+	std::thread m_thread;
+
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::deque<PendingRead> m_queues[(u8)TaskPriority::Count];
+	bool m_bStop = false;
+
+	std::atomic<u32> m_numPending{ 0 };
+	std::atomic<u64> m_totalBytesRead{ 0 };
+};
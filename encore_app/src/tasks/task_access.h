@@ -0,0 +1,163 @@
+#pragma once
+
+#include "core/core_minimal.h"
+
+#include "memory/base_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <initializer_list>
+#include <mutex>
+#include <typeinfo>
+#include <vector>
+
+// Tasks declare which component (or any resource) types they read and write:
+//
+//	task->DeclareAccess({ Read<MoveComponent>(), Write<AnimatedSpriteComponent>() });
+//
+// TaskSchedulerSystem derives the dependencies from these when building the execution plan.
+// Read/Read never conflicts, anything involving a Write is ordered by registration order.
+// In debug builds, going through ReadPool<T>() / WritePool<T>() or TASK_ACCESS_READ/WRITE from inside a
+// task checks the access was declared.
+
+using ResourceTypeId = u32;
+
+enum class AccessMode : u8
+{
+	Read,
+	Write
+};
+
+namespace task_access_detail
+{
+	inline std::atomic<ResourceTypeId> g_nextResourceTypeId{ 0 };
+}
+
+template<typename T>
+ResourceTypeId GetResourceTypeId()
+{
+	static const ResourceTypeId id = task_access_detail::g_nextResourceTypeId.fetch_add(1);
+	return id;
+}
+
+struct ResourceAccess
+{
+	ResourceTypeId typeId;
+	AccessMode mode;
+	const char* typeName;
+};
+
+template<typename T>
+ResourceAccess Read() { return { GetResourceTypeId<T>(), AccessMode::Read, typeid(T).name() }; }
+
+template<typename T>
+ResourceAccess Write() { return { GetResourceTypeId<T>(), AccessMode::Write, typeid(T).name() }; }
+
+class TaskAccessDeclaration
+{
+public:
+	explicit TaskAccessDeclaration(const char* pTaskName) : m_pTaskName(pTaskName) {}
+
+	void Declare(ResourceAccess access)
+	{
+		for (ResourceAccess& existing : m_accesses)
+		{
+			if (existing.typeId == access.typeId)
+			{
+				// Write wins over Read
+				if (access.mode == AccessMode::Write)
+				{
+					existing.mode = AccessMode::Write;
+				}
+				return;
+			}
+		}
+		m_accesses.push_back(access);
+	}
+
+	// A declared Write also allows reading
+	bool Allows(ResourceTypeId typeId, AccessMode mode) const
+	{
+		for (const ResourceAccess& access : m_accesses)
+		{
+			if (access.typeId == typeId)
+			{
+				return mode == AccessMode::Read || access.mode == AccessMode::Write;
+			}
+		}
+		return false;
+	}
+
+	const std::vector<ResourceAccess>& GetAccesses() const { return m_accesses; }
+	bool IsEmpty() const { return m_accesses.empty(); }
+
+#if ENC_DEBUG
+	void Validate(ResourceTypeId typeId, AccessMode mode, const char* typeName) const
+	{
+		if (Allows(typeId, mode))
+		{
+			return;
+		}
+
+		// Report each offending type once per task, not every frame
+		std::lock_guard<std::mutex> lock(m_reportedMutex);
+		if (std::find(m_reported.begin(), m_reported.end(), typeId) != m_reported.end())
+		{
+			return;
+		}
+		m_reported.push_back(typeId);
+
+		LOG_ERROR("Task '%s' %s '%s' without declaring it. Add %s<%s>() to its DeclareAccess.",
+			m_pTaskName, mode == AccessMode::Write ? "writes" : "reads", typeName,
+			mode == AccessMode::Write ? "Write" : "Read", typeName);
+	}
+#endif
+
+private:
+	const char* m_pTaskName;
+	std::vector<ResourceAccess> m_accesses;
+
+#if ENC_DEBUG
+	// Chunk jobs and spawned children of one task can report at the same time
+	mutable std::mutex m_reportedMutex;
+	mutable std::vector<ResourceTypeId> m_reported;
+#endif
+};
+
+#if ENC_DEBUG
+namespace task_access_detail
+{
+	// Declaration of the task running on this thread, null outside of the task graph
+	inline thread_local const TaskAccessDeclaration* tl_pExecutingAccess = nullptr;
+
+	template<typename T>
+	void ValidateAccess(AccessMode mode)
+	{
+		if (tl_pExecutingAccess)
+		{
+			tl_pExecutingAccess->Validate(GetResourceTypeId<T>(), mode, typeid(T).name());
+		}
+	}
+}
+
+#define TASK_ACCESS_READ(Type) task_access_detail::ValidateAccess<Type>(AccessMode::Read)
+#define TASK_ACCESS_WRITE(Type) task_access_detail::ValidateAccess<Type>(AccessMode::Write)
+#else
+#define TASK_ACCESS_READ(Type) ((void)0)
+#define TASK_ACCESS_WRITE(Type) ((void)0)
+#endif
+
+// Checked pool accessors for code running inside tasks
+template<typename T>
+const Pool<T>* ReadPool()
+{
+	TASK_ACCESS_READ(T);
+	return T::GetPool();
+}
+
+template<typename T>
+Pool<T>* WritePool()
+{
+	TASK_ACCESS_WRITE(T);
+	return T::GetPool();
+}
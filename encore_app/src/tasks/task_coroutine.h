@@ -0,0 +1,587 @@
+#pragma once
+
+#include "core/core_minimal.h"
+
+#include "task_access.h"
+#include "thread_pool.h"
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// Coroutine jobs on top of the ThreadPool.
+//
+// Task<T> is lazy: nothing runs until it is co_awaited (or handed to TaskSchedulerSystem::Launch).
+// Awaiting one of the awaiters below suspends the coroutine and frees the worker, the coroutine
+// is resumed on whichever thread finishes the awaited work.
+//
+//	Task<void> BuildFrame(ThreadPool& pool)
+//	{
+//		co_await ParallelFor(pool, count, 256, [](u32 begin, u32 end) { /* extract */ });
+//		co_await ParallelFor(pool, count, 256, [](u32 begin, u32 end) { /* cull */ });
+//		co_await SwitchToMainThread(pool);
+//		// upload
+//	}
+//
+// Note: don't keep a PROFILE_SCOPE alive across a co_await, the coroutine may resume on another thread.
+// Graph tasks get theirs from TaskContext instead: reopened around every resumed segment, see below.
+
+template<typename T = void>
+class Task;
+
+// The graph task a coroutine runs for. A coroutine hops threads at every co_await, so the awaiters
+// below capture this when suspending and hand it to the jobs they queue and to the resumed segment.
+struct TaskContext
+{
+	ProfilerScopeId scopeId = ProfilerScopes::UNKNOWN_SCOPE;
+	const TaskAccessDeclaration* pAccess = nullptr;	// checked in debug builds, see task_access.h
+};
+
+namespace coro_detail
+{
+	struct PromiseBase
+	{
+		// Resume whoever awaited us when we finish (symmetric transfer, no stack growth)
+		struct FinalAwaiter
+		{
+			bool await_ready() const noexcept { return false; }
+
+			template<typename TPromise>
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<TPromise> handle) noexcept
+			{
+				return handle.promise().m_continuation;
+			}
+
+			void await_resume() const noexcept {}
+		};
+
+		std::suspend_always initial_suspend() const noexcept { return {}; }
+		FinalAwaiter final_suspend() const noexcept { return {}; }
+		void unhandled_exception() const noexcept { std::terminate(); }
+
+		std::coroutine_handle<> m_continuation = std::noop_coroutine();
+	};
+
+	template<typename T>
+	struct Promise : PromiseBase
+	{
+		Task<T> get_return_object() noexcept;
+
+		template<typename U>
+		void return_value(U&& value) { m_value.emplace(std::forward<U>(value)); }
+
+		T TakeValue()
+		{
+			AssertMsg(m_value.has_value(), "Task finished without a value");
+			return std::move(*m_value);
+		}
+
+		std::optional<T> m_value;
+	};
+
+	template<>
+	struct Promise<void> : PromiseBase
+	{
+		Task<void> get_return_object() noexcept;
+
+		void return_void() const noexcept {}
+		void TakeValue() const noexcept {}
+	};
+
+	// What the coroutine on this thread is running for, set while a segment of it runs
+	inline thread_local TaskContext tl_taskContext;
+
+	// Runs func with context current on this thread, restores the previous one after
+	template<typename TFunc>
+	void RunInContext(const TaskContext& context, TFunc&& func)
+	{
+		const TaskContext previous = tl_taskContext;
+		tl_taskContext = context;
+#if ENC_DEBUG
+		task_access_detail::tl_pExecutingAccess = context.pAccess;
+#endif
+		func();
+#if ENC_DEBUG
+		task_access_detail::tl_pExecutingAccess = previous.pAccess;
+#endif
+		tl_taskContext = previous;
+	}
+
+	// Resumes a coroutine with its context, opening the task's profiler scope for that segment only.
+	// Already inside the same task (a child finishing inline), the open scope covers it.
+	inline void ResumeSegment(std::coroutine_handle<> handle, const TaskContext& context)
+	{
+		const bool bOpenScope = context.scopeId != ProfilerScopes::UNKNOWN_SCOPE && context.scopeId != tl_taskContext.scopeId;
+		RunInContext(context, [&]() {
+			if (bOpenScope)
+			{
+				PROFILE_SCOPE_ID(context.scopeId);
+				handle.resume();
+			}
+			else
+			{
+				handle.resume();
+			}
+		});
+	}
+
+	// Self destroying coroutine used to start a Task from non coroutine code
+	struct DetachedTask
+	{
+		struct promise_type
+		{
+			DetachedTask get_return_object() const noexcept { return {}; }
+			std::suspend_never initial_suspend() const noexcept { return {}; }
+			std::suspend_never final_suspend() const noexcept { return {}; }
+			void return_void() const noexcept {}
+			void unhandled_exception() const noexcept { std::terminate(); }
+		};
+	};
+}
+
+template<typename T>
+class Task
+{
+public:
+	using promise_type = coro_detail::Promise<T>;
+	using Handle = std::coroutine_handle<promise_type>;
+
+	Task() = default;
+	explicit Task(Handle handle) : m_handle(handle) {}
+
+	Task(Task&& other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+	Task& operator=(Task&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Destroy();
+			m_handle = std::exchange(other.m_handle, nullptr);
+		}
+		return *this;
+	}
+
+	~Task() { Destroy(); }
+
+	NO_COPY(Task);
+
+	bool IsValid() const { return m_handle != nullptr; }
+	bool IsDone() const { return !m_handle || m_handle.done(); }
+
+	// co_await task: starts it on the current thread, resumes us when it completes
+	auto operator co_await() & noexcept { return Awaiter{ m_handle }; }
+	auto operator co_await() && noexcept { return Awaiter{ m_handle }; }
+
+private:
+	struct Awaiter
+	{
+		Handle handle;
+
+		bool await_ready() const noexcept { return !handle || handle.done(); }
+
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+		{
+			handle.promise().m_continuation = awaiting;
+			return handle;
+		}
+
+		T await_resume() { return handle.promise().TakeValue(); }
+	};
+
+	void Destroy()
+	{
+		if (m_handle)
+		{
+			m_handle.destroy();
+			m_handle = nullptr;
+		}
+	}
+
+	Handle m_handle = nullptr;
+};
+
+namespace coro_detail
+{
+	template<typename T>
+	Task<T> Promise<T>::get_return_object() noexcept
+	{
+		return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+	}
+
+	inline Task<void> Promise<void>::get_return_object() noexcept
+	{
+		return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+	}
+}
+
+// Resumes the coroutine on a pool worker (or the main thread lane) at the given priority
+struct SwitchToThreadPool
+{
+	SwitchToThreadPool(ThreadPool& pool, TaskPriority priority = TaskPriority::Normal, TaskAffinity affinity = TaskAffinity::AnyThread,
+		const TaskContext& context = coro_detail::tl_taskContext)
+		: m_pool(pool), m_priority(priority), m_affinity(affinity), m_context(context)
+	{}
+
+	bool await_ready() const noexcept { return false; }
+
+	void await_suspend(std::coroutine_handle<> handle)
+	{
+		m_pool.Enqueue(TaskPayload{ [handle, context = m_context](float) { coro_detail::ResumeSegment(handle, context); },
+			0.0f, m_priority, m_affinity, m_context.scopeId });
+	}
+
+	void await_resume() const noexcept {}
+
+	ThreadPool& m_pool;
+	TaskPriority m_priority;
+	TaskAffinity m_affinity;
+	TaskContext m_context;
+};
+
+// Resumes the coroutine on the main thread lane (GL / SDL work)
+struct SwitchToMainThread
+{
+	explicit SwitchToMainThread(ThreadPool& pool) : m_pool(pool), m_context(coro_detail::tl_taskContext) {}
+
+	bool await_ready() const noexcept { return m_pool.IsMainThread(); }
+
+	void await_suspend(std::coroutine_handle<> handle)
+	{
+		m_pool.Enqueue(TaskPayload{ [handle, context = m_context](float) { coro_detail::ResumeSegment(handle, context); },
+			0.0f, TaskPriority::High, TaskAffinity::MainThread, m_context.scopeId });
+	}
+
+	void await_resume() const noexcept {}
+
+	ThreadPool& m_pool;
+	TaskContext m_context;
+};
+
+// Splits [0, count) in chunks of grainSize and runs them on the pool.
+// The awaiting coroutine is resumed by whichever worker finishes the last chunk.
+class ParallelFor
+{
+public:
+	using RangeFunction = std::function<void(u32 begin, u32 end)>;
+
+	ParallelFor(ThreadPool& pool, u32 count, u32 grainSize, RangeFunction func, TaskPriority priority = TaskPriority::High)
+		: m_pool(pool), m_count(count), m_grainSize(utils::Max(1u, grainSize)), m_func(std::move(func)), m_priority(priority)
+		, m_context(coro_detail::tl_taskContext)
+	{}
+
+	NO_COPY(ParallelFor);
+	NO_MOVE(ParallelFor);
+
+	bool await_ready() const noexcept { return m_count == 0; }
+
+	bool await_suspend(std::coroutine_handle<> handle)
+	{
+		m_continuation = handle;
+
+		const u32 numChunks = (m_count + m_grainSize - 1) / m_grainSize;
+
+		// +1 keeps us alive until every chunk is queued, a chunk may finish before the loop does
+		m_remaining.store(numChunks + 1, std::memory_order_relaxed);
+
+		for (u32 chunk = 0; chunk < numChunks; chunk++)
+		{
+			const u32 begin = chunk * m_grainSize;
+			const u32 end = utils::Min(begin + m_grainSize, m_count);
+			m_pool.Enqueue(TaskPayload{ [this, begin, end](float) {
+				coro_detail::RunInContext(m_context, [&]() { m_func(begin, end); });
+				if (m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				{
+					coro_detail::ResumeSegment(m_continuation, m_context);
+				}
+			}, 0.0f, m_priority, TaskAffinity::AnyThread, m_context.scopeId });
+		}
+
+		// Everything already finished: don't suspend, carry on right here
+		return m_remaining.fetch_sub(1, std::memory_order_acq_rel) != 1;
+	}
+
+	void await_resume() const noexcept {}
+
+private:
+	ThreadPool& m_pool;
+	u32 m_count;
+	u32 m_grainSize;
+	RangeFunction m_func;
+	TaskPriority m_priority;
+	TaskContext m_context;
+
+	std::atomic<u32> m_remaining{ 0 };
+	std::coroutine_handle<> m_continuation;
+};
+
+// Folds [0, count) in chunks of grainSize, co_await gives the combined result.
+// Partial results are combined in chunk order, so the result doesn't depend on which worker ran what.
+//
+//	const u32 numVisible = co_await ParallelReduce(pool, count, 256, 0u,
+//		[](u32 begin, u32 end) { return CountVisible(begin, end); },
+//		[](u32 a, u32 b) { return a + b; });
+template<typename T>
+class ParallelReduce
+{
+public:
+	using RangeFunction = std::function<T(u32 begin, u32 end)>;
+	using CombineFunction = std::function<T(const T& a, const T& b)>;
+
+	ParallelReduce(ThreadPool& pool, u32 count, u32 grainSize, T identity, RangeFunction func, CombineFunction combine,
+		TaskPriority priority = TaskPriority::High)
+		: m_pool(pool), m_count(count), m_grainSize(utils::Max(1u, grainSize)), m_identity(std::move(identity))
+		, m_func(std::move(func)), m_combine(std::move(combine)), m_priority(priority), m_context(coro_detail::tl_taskContext)
+	{}
+
+	NO_COPY(ParallelReduce);
+	NO_MOVE(ParallelReduce);
+
+	bool await_ready() const noexcept { return m_count == 0; }
+
+	bool await_suspend(std::coroutine_handle<> handle)
+	{
+		m_continuation = handle;
+
+		const u32 numChunks = (m_count + m_grainSize - 1) / m_grainSize;
+		m_partials.assign(numChunks, m_identity);
+		m_remaining.store(numChunks + 1, std::memory_order_relaxed);
+
+		for (u32 chunk = 0; chunk < numChunks; chunk++)
+		{
+			const u32 begin = chunk * m_grainSize;
+			const u32 end = utils::Min(begin + m_grainSize, m_count);
+			m_pool.Enqueue(TaskPayload{ [this, chunk, begin, end](float) {
+				coro_detail::RunInContext(m_context, [&]() { m_partials[chunk] = m_func(begin, end); });
+				if (m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				{
+					coro_detail::ResumeSegment(m_continuation, m_context);
+				}
+			}, 0.0f, m_priority, TaskAffinity::AnyThread, m_context.scopeId });
+		}
+
+		return m_remaining.fetch_sub(1, std::memory_order_acq_rel) != 1;
+	}
+
+	T await_resume()
+	{
+		T result = m_identity;
+		for (const T& partial : m_partials)
+		{
+			result = m_combine(result, partial);
+		}
+		return result;
+	}
+
+private:
+	ThreadPool& m_pool;
+	u32 m_count;
+	u32 m_grainSize;
+	T m_identity;
+	RangeFunction m_func;
+	CombineFunction m_combine;
+	TaskPriority m_priority;
+	TaskContext m_context;
+
+	std::vector<T> m_partials;
+	std::atomic<u32> m_remaining{ 0 };
+	std::coroutine_handle<> m_continuation;
+};
+
+// T comes from the identity, the lambdas convert to the std::function members
+template<typename T, typename TFunc, typename TCombine, typename... TRest>
+ParallelReduce(ThreadPool&, u32, u32, T, TFunc, TCombine, TRest...) -> ParallelReduce<T>;
+
+// Exclusive prefix scan of pInput into pOutput (may be the same array), co_await gives the total.
+// pOutput[i] is the combination of every element before i, pOutput[0] is the identity.
+//
+// Two passes over the pool: each chunk sums its elements, the chunk sums are scanned on one thread
+// (there are few of them), then each chunk scans its elements starting from its chunk offset.
+// Typical use is turning per chunk counts into write offsets, so parallel producers can fill
+// one contiguous array without locks:
+//
+//	const u32 total = co_await ParallelExclusiveScan(pool, counts.data(), offsets.data(), numChunks, 1024, 0u,
+//		[](u32 a, u32 b) { return a + b; });
+template<typename T>
+class ParallelExclusiveScan
+{
+public:
+	using CombineFunction = std::function<T(const T& a, const T& b)>;
+
+	ParallelExclusiveScan(ThreadPool& pool, const T* pInput, T* pOutput, u32 count, u32 grainSize, T identity, CombineFunction combine,
+		TaskPriority priority = TaskPriority::High)
+		: m_pool(pool), m_pInput(pInput), m_pOutput(pOutput), m_count(count), m_grainSize(utils::Max(1u, grainSize))
+		, m_identity(identity), m_combine(std::move(combine)), m_priority(priority), m_context(coro_detail::tl_taskContext), m_total(identity)
+	{}
+
+	NO_COPY(ParallelExclusiveScan);
+	NO_MOVE(ParallelExclusiveScan);
+
+	bool await_ready() const noexcept { return m_count == 0; }
+
+	bool await_suspend(std::coroutine_handle<> handle)
+	{
+		m_continuation = handle;
+		m_numChunks = (m_count + m_grainSize - 1) / m_grainSize;
+
+		// Not worth a trip through the pool
+		if (m_numChunks == 1)
+		{
+			m_total = ScanChunk(0, m_count, m_identity);
+			return false;
+		}
+
+		m_partials.assign(m_numChunks, m_identity);
+		m_remaining.store(m_numChunks + 1, std::memory_order_relaxed);
+
+		for (u32 chunk = 0; chunk < m_numChunks; chunk++)
+		{
+			m_pool.Enqueue(TaskPayload{ [this, chunk](float) {
+				const u32 begin = chunk * m_grainSize;
+				const u32 end = utils::Min(begin + m_grainSize, m_count);
+
+				T sum = m_identity;
+				for (u32 i = begin; i < end; i++)
+				{
+					sum = m_combine(sum, m_pInput[i]);
+				}
+				m_partials[chunk] = sum;
+
+				if (m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1 && DispatchScan())
+				{
+					coro_detail::ResumeSegment(m_continuation, m_context);
+				}
+			}, 0.0f, m_priority, TaskAffinity::AnyThread, m_context.scopeId });
+		}
+
+		// Whoever finishes the first pass starts the second, that may be us
+		if (m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			return !DispatchScan();
+		}
+		return true;
+	}
+
+	T await_resume() const { return m_total; }
+
+private:
+	// Writes the exclusive scan of [begin, end) starting from offset, returns the running total
+	T ScanChunk(u32 begin, u32 end, T offset) const
+	{
+		for (u32 i = begin; i < end; i++)
+		{
+			const T value = m_pInput[i];
+			m_pOutput[i] = offset;
+			offset = m_combine(offset, value);
+		}
+		return offset;
+	}
+
+	// Second pass. Returns true if it's already complete and the caller should resume the coroutine.
+	bool DispatchScan()
+	{
+		// Chunk sums become chunk offsets
+		T offset = m_identity;
+		for (T& partial : m_partials)
+		{
+			const T sum = partial;
+			partial = offset;
+			offset = m_combine(offset, sum);
+		}
+		m_total = offset;
+
+		m_remaining.store(m_numChunks + 1, std::memory_order_relaxed);
+		for (u32 chunk = 0; chunk < m_numChunks; chunk++)
+		{
+			m_pool.Enqueue(TaskPayload{ [this, chunk](float) {
+				const u32 begin = chunk * m_grainSize;
+				ScanChunk(begin, utils::Min(begin + m_grainSize, m_count), m_partials[chunk]);
+
+				if (m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				{
+					coro_detail::ResumeSegment(m_continuation, m_context);
+				}
+			}, 0.0f, m_priority, TaskAffinity::AnyThread, m_context.scopeId });
+		}
+
+		return m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1;
+	}
+
+	ThreadPool& m_pool;
+	const T* m_pInput;
+	T* m_pOutput;
+	u32 m_count;
+	u32 m_grainSize;
+	u32 m_numChunks = 0;
+	T m_identity;
+	CombineFunction m_combine;
+	TaskPriority m_priority;
+	TaskContext m_context;
+	T m_total;
+
+	std::vector<T> m_partials;
+	std::atomic<u32> m_remaining{ 0 };
+	std::coroutine_handle<> m_continuation;
+};
+
+template<typename T, typename TCombine, typename... TRest>
+ParallelExclusiveScan(ThreadPool&, const T*, T*, u32, u32, T, TCombine, TRest...) -> ParallelExclusiveScan<T>;
+
+// Runs every child task concurrently on the pool, resumes the awaiting coroutine once all are done
+class WhenAll
+{
+public:
+	WhenAll(ThreadPool& pool, std::vector<Task<void>> tasks, TaskPriority priority = TaskPriority::High)
+		: m_pool(pool), m_tasks(std::move(tasks)), m_priority(priority)
+	{}
+
+	NO_COPY(WhenAll);
+	NO_MOVE(WhenAll);
+
+	bool await_ready() const noexcept { return m_tasks.empty(); }
+
+	bool await_suspend(std::coroutine_handle<> handle)
+	{
+		m_continuation = handle;
+		m_remaining.store((u32)m_tasks.size() + 1, std::memory_order_relaxed);
+
+		for (Task<void>& task : m_tasks)
+		{
+			RunChild(task);
+		}
+
+		return m_remaining.fetch_sub(1, std::memory_order_acq_rel) != 1;
+	}
+
+	void await_resume() const noexcept {}
+
+private:
+	coro_detail::DetachedTask RunChild(Task<void>& task)
+	{
+		co_await SwitchToThreadPool(m_pool, m_priority);
+		co_await task;
+
+		if (m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			m_continuation.resume();
+		}
+	}
+
+	ThreadPool& m_pool;
+	std::vector<Task<void>> m_tasks;
+	TaskPriority m_priority;
+
+	std::atomic<u32> m_remaining{ 0 };
+	std::coroutine_handle<> m_continuation;
+};
+
+// Starts a task on the pool and lets it run to completion on its own. The context names it in the
+// profiler, every segment of it runs inside context.scopeId.
+inline coro_detail::DetachedTask LaunchTask(ThreadPool& pool, Task<void> task,
+	TaskPriority priority = TaskPriority::Normal, TaskAffinity affinity = TaskAffinity::AnyThread, TaskContext context = {})
+{
+	co_await SwitchToThreadPool(pool, priority, affinity, context);
+	co_await task;
+}
@@ -0,0 +1,386 @@
+#pragma once
+
+#include "core/core_minimal.h"
+
+#include "task_types.h"
+
+#include <utils/utils_math.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// One frame of the task graph as it actually ran: per task duration and dependencies.
+// Captured with TaskSchedulerSystem::CaptureGraphSnapshot.
+struct TaskGraphSnapshot
+{
+	struct Node
+	{
+		std::string name;
+		u64 durationNs = 0;			// 0 if the task was skipped (disabled, not due)
+		u32 level = 0;				// layer in the execution plan
+		TaskPriority priority = TaskPriority::Normal;
+		TaskAffinity affinity = TaskAffinity::AnyThread;
+		std::vector<u32> dependencies;	// indices into nodes
+	};
+
+	std::vector<Node> nodes;
+	u64 wallTimeNs = 0;				// measured, BeginTaskGraph to the last task done
+	u32 numWorkers = 0;
+};
+
+// Averages snapshots over several frames, so one hitch doesn't drive the prediction.
+// Starts over if the graph changes shape.
+class TaskGraphRecorder
+{
+public:
+	void AddFrame(const TaskGraphSnapshot& snapshot)
+	{
+		if (!IsSameGraph(snapshot))
+		{
+			m_sum = snapshot;
+			m_numFrames = 1;
+			return;
+		}
+
+		for (u64 i = 0; i < snapshot.nodes.size(); i++)
+		{
+			m_sum.nodes[i].durationNs += snapshot.nodes[i].durationNs;
+		}
+		m_sum.wallTimeNs += snapshot.wallTimeNs;
+		m_numFrames++;
+	}
+
+	TaskGraphSnapshot GetAverage() const
+	{
+		TaskGraphSnapshot average = m_sum;
+		if (m_numFrames > 1)
+		{
+			for (TaskGraphSnapshot::Node& node : average.nodes)
+			{
+				node.durationNs /= m_numFrames;
+			}
+			average.wallTimeNs /= m_numFrames;
+		}
+		return average;
+	}
+
+	u32 GetNumFrames() const { return m_numFrames; }
+	void Clear() { m_sum = {}; m_numFrames = 0; }
+
+private:
+	bool IsSameGraph(const TaskGraphSnapshot& snapshot) const
+	{
+		if (m_numFrames == 0 || snapshot.nodes.size() != m_sum.nodes.size())
+		{
+			return false;
+		}
+
+		for (u64 i = 0; i < snapshot.nodes.size(); i++)
+		{
+			if (snapshot.nodes[i].name != m_sum.nodes[i].name || snapshot.nodes[i].dependencies != m_sum.nodes[i].dependencies)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	TaskGraphSnapshot m_sum;
+	u32 m_numFrames = 0;
+};
+
+// Replays recorded durations on a simulated machine to predict how the frame scales with cores.
+//
+// Two policies are simulated:
+//  - Layered: what TaskSchedulerSystem does today, every layer waits for the previous one.
+//  - Dependency driven: a task starts as soon as its own dependencies are done,
+//    picking the task with the longest remaining chain first.
+// Main thread tasks always run on the main thread lane, next to the simulated workers.
+// The critical path is the lower bound no amount of cores gets below.
+class TaskGraphSimulator
+{
+public:
+	struct ScalingResult
+	{
+		u32 numCores = 0;
+		u64 layeredNs = 0;
+		u64 dependencyDrivenNs = 0;
+	};
+
+	explicit TaskGraphSimulator(const TaskGraphSnapshot& snapshot)
+		: m_snapshot(snapshot)
+	{
+		BuildTopologicalOrder();
+		ComputeCriticalPath();
+	}
+
+	u64 GetTotalWorkNs() const
+	{
+		u64 total = 0;
+		for (const TaskGraphSnapshot::Node& node : m_snapshot.nodes)
+		{
+			total += node.durationNs;
+		}
+		return total;
+	}
+
+	u64 GetCriticalPathNs() const { return m_criticalPathNs; }
+
+	// Node indices, first to last
+	const std::vector<u32>& GetCriticalPath() const { return m_criticalPath; }
+
+	bool IsOnCriticalPath(u32 nodeIndex) const
+	{
+		return std::find(m_criticalPath.begin(), m_criticalPath.end(), nodeIndex) != m_criticalPath.end();
+	}
+
+	u64 SimulateLayered(u32 numCores) const
+	{
+		numCores = utils::Max(1u, numCores);
+
+		u32 maxLevel = 0;
+		for (const TaskGraphSnapshot::Node& node : m_snapshot.nodes)
+		{
+			maxLevel = utils::Max(maxLevel, node.level);
+		}
+
+		u64 frameNs = 0;
+		std::vector<u64> coreBusyUntil(numCores);
+		for (u32 level = 0; level <= maxLevel; level++)
+		{
+			std::fill(coreBusyUntil.begin(), coreBusyUntil.end(), 0);
+			u64 mainThreadNs = 0;
+
+			// FIFO per priority, like the pool: each task goes to the first free core
+			for (u8 priority = 0; priority < (u8)TaskPriority::Count; priority++)
+			{
+				for (u32 index : m_order)
+				{
+					const TaskGraphSnapshot::Node& node = m_snapshot.nodes[index];
+					if (node.level != level || (u8)node.priority != priority)
+					{
+						continue;
+					}
+
+					if (node.affinity == TaskAffinity::MainThread)
+					{
+						mainThreadNs += node.durationNs;
+						continue;
+					}
+
+					auto core = std::min_element(coreBusyUntil.begin(), coreBusyUntil.end());
+					*core += node.durationNs;
+				}
+			}
+
+			const u64 workersNs = *std::max_element(coreBusyUntil.begin(), coreBusyUntil.end());
+			frameNs += utils::Max(workersNs, mainThreadNs);
+		}
+		return frameNs;
+	}
+
+	u64 SimulateDependencyDriven(u32 numCores) const
+	{
+		numCores = utils::Max(1u, numCores);
+
+		const u32 numNodes = (u32)m_snapshot.nodes.size();
+		std::vector<u32> pendingDependencies(numNodes);
+		std::vector<std::vector<u32>> dependents(numNodes);
+		for (u32 i = 0; i < numNodes; i++)
+		{
+			pendingDependencies[i] = (u32)m_snapshot.nodes[i].dependencies.size();
+			for (u32 dependency : m_snapshot.nodes[i].dependencies)
+			{
+				dependents[dependency].push_back(i);
+			}
+		}
+
+		// Ready list, kept sorted by priority then longest remaining chain
+		std::vector<u32> ready;
+		for (u32 i = 0; i < numNodes; i++)
+		{
+			if (pendingDependencies[i] == 0)
+			{
+				ready.push_back(i);
+			}
+		}
+
+		struct Running
+		{
+			u32 node;
+			u64 endNs;
+			bool bMainThread;
+		};
+		std::vector<Running> running;
+
+		u64 now = 0;
+		u32 busyWorkers = 0;
+		bool bMainThreadBusy = false;
+		u32 numDone = 0;
+
+		while (numDone < numNodes)
+		{
+			std::sort(ready.begin(), ready.end(), [this](u32 a, u32 b) {
+				const TaskGraphSnapshot::Node& nodeA = m_snapshot.nodes[a];
+				const TaskGraphSnapshot::Node& nodeB = m_snapshot.nodes[b];
+				if (nodeA.priority != nodeB.priority)
+				{
+					return nodeA.priority < nodeB.priority;
+				}
+				return m_bottomLevelNs[a] > m_bottomLevelNs[b];
+			});
+
+			// Start whatever fits on a free lane
+			for (u64 i = 0; i < ready.size();)
+			{
+				const u32 index = ready[i];
+				const bool bMainThread = m_snapshot.nodes[index].affinity == TaskAffinity::MainThread;
+				const bool bLaneFree = bMainThread ? !bMainThreadBusy : busyWorkers < numCores;
+				if (!bLaneFree)
+				{
+					i++;
+					continue;
+				}
+
+				running.push_back({ index, now + m_snapshot.nodes[index].durationNs, bMainThread });
+				if (bMainThread) { bMainThreadBusy = true; }
+				else { busyWorkers++; }
+				ready.erase(ready.begin() + i);
+			}
+
+			AssertMsg(!running.empty(), "Simulated graph stalled, snapshot has a cycle");
+			if (running.empty())
+			{
+				break;
+			}
+
+			// Advance to the next task finishing
+			auto next = std::min_element(running.begin(), running.end(), [](const Running& a, const Running& b) { return a.endNs < b.endNs; });
+			const Running done = *next;
+			running.erase(next);
+
+			now = done.endNs;
+			numDone++;
+			if (done.bMainThread) { bMainThreadBusy = false; }
+			else { busyWorkers--; }
+
+			for (u32 dependent : dependents[done.node])
+			{
+				if (--pendingDependencies[dependent] == 0)
+				{
+					ready.push_back(dependent);
+				}
+			}
+		}
+
+		return now;
+	}
+
+	std::vector<ScalingResult> SimulateScaling(u32 maxCores) const
+	{
+		std::vector<ScalingResult> results;
+		for (u32 cores = 1; cores <= maxCores; cores++)
+		{
+			results.push_back({ cores, SimulateLayered(cores), SimulateDependencyDriven(cores) });
+		}
+		return results;
+	}
+
+	void PrintReport(u32 maxCores) const
+	{
+		LOG_INFO("Task graph: %u tasks, total work %.3f ms, critical path %.3f ms, measured %.3f ms on %u workers",
+			(u32)m_snapshot.nodes.size(), NsToMs(GetTotalWorkNs()), NsToMs(m_criticalPathNs),
+			NsToMs(m_snapshot.wallTimeNs), m_snapshot.numWorkers);
+
+		std::string path;
+		for (u32 index : m_criticalPath)
+		{
+			path += (path.empty() ? "" : " -> ") + m_snapshot.nodes[index].name;
+		}
+		LOG_INFO("Critical path: %s", path.c_str());
+
+		const u64 serialNs = utils::Max<u64>(1, GetTotalWorkNs());
+		for (const ScalingResult& result : SimulateScaling(maxCores))
+		{
+			LOG_INFO("%2u cores: layered %.3f ms (x%.2f), dependency driven %.3f ms (x%.2f)",
+				result.numCores,
+				NsToMs(result.layeredNs), (f32)serialNs / utils::Max<u64>(1, result.layeredNs),
+				NsToMs(result.dependencyDrivenNs), (f32)serialNs / utils::Max<u64>(1, result.dependencyDrivenNs));
+		}
+	}
+
+private:
+	static f32 NsToMs(u64 ns) { return (f32)ns / 1'000'000.0f; }
+
+	// Levels come from the execution plan, sorting by them gives a valid topological order
+	void BuildTopologicalOrder()
+	{
+		m_order.resize(m_snapshot.nodes.size());
+		for (u32 i = 0; i < m_order.size(); i++)
+		{
+			m_order[i] = i;
+		}
+		std::stable_sort(m_order.begin(), m_order.end(), [this](u32 a, u32 b) {
+			return m_snapshot.nodes[a].level < m_snapshot.nodes[b].level;
+		});
+	}
+
+	// Longest chain of durations from each node to the end of the graph (bottom level)
+	void ComputeCriticalPath()
+	{
+		const u32 numNodes = (u32)m_snapshot.nodes.size();
+		m_bottomLevelNs.assign(numNodes, 0);
+		std::vector<u32> next(numNodes, UINT32_MAX);
+
+		std::vector<std::vector<u32>> dependents(numNodes);
+		for (u32 i = 0; i < numNodes; i++)
+		{
+			for (u32 dependency : m_snapshot.nodes[i].dependencies)
+			{
+				dependents[dependency].push_back(i);
+			}
+		}
+
+		for (auto it = m_order.rbegin(); it != m_order.rend(); ++it)
+		{
+			const u32 index = *it;
+			for (u32 dependent : dependents[index])
+			{
+				if (next[index] == UINT32_MAX || m_bottomLevelNs[dependent] > m_bottomLevelNs[next[index]])
+				{
+					next[index] = dependent;
+				}
+			}
+			const u64 longestTail = next[index] != UINT32_MAX ? m_bottomLevelNs[next[index]] : 0;
+			m_bottomLevelNs[index] = m_snapshot.nodes[index].durationNs + longestTail;
+		}
+
+		m_criticalPath.clear();
+		m_criticalPathNs = 0;
+
+		u32 start = UINT32_MAX;
+		for (u32 i = 0; i < numNodes; i++)
+		{
+			if (m_snapshot.nodes[i].dependencies.empty() && (start == UINT32_MAX || m_bottomLevelNs[i] > m_bottomLevelNs[start]))
+			{
+				start = i;
+			}
+		}
+
+		for (u32 index = start; index != UINT32_MAX; index = next[index])
+		{
+			m_criticalPath.push_back(index);
+		}
+		if (start != UINT32_MAX)
+		{
+			m_criticalPathNs = m_bottomLevelNs[start];
+		}
+	}
+
+	TaskGraphSnapshot m_snapshot;
+	std::vector<u32> m_order;
+	std::vector<u64> m_bottomLevelNs;
+	std::vector<u32> m_criticalPath;
+	u64 m_criticalPathNs = 0;
+};
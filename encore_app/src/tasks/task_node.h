@@ -2,6 +2,15 @@
 
 #include "core/core_minimal.h"
 
+#include "task_access.h"
+#include "task_coroutine.h"
+#include "task_spawner.h"
+#include "task_types.h"
+
+#include <profiler/profiler_scope.h>
+#include <utils/utils_time.h>
+
+#include <algorithm>
 #include <functional>
 #include <string>
 #include <memory>
@@ -9,35 +18,266 @@
 #include <atomic>
 
 
-using TaskFunction = std::function<void(float dt)>;
+using CoroutineTaskFunction = std::function<Task<void>(float dt)>;
+using SpawnTaskFunction = std::function<void(float dt, TaskSpawner& spawner)>;
+
+// On/off switch for a task, or shared by a group of them (editor-only tasks, a paused system).
+// A disabled task is skipped and counts as done for its dependents, no plan rebuild needed.
+class TaskCondition
+{
+public:
+	explicit TaskCondition(bool bEnabled = true) : m_bEnabled(bEnabled) {}
+
+	void SetEnabled(bool bEnabled) { m_bEnabled.store(bEnabled, std::memory_order_relaxed); }
+	bool IsEnabled() const { return m_bEnabled.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<bool> m_bEnabled;
+};
+
+class TaskNode;
+
+// Implemented by the scheduler owning the nodes, keeps a built execution plan in sync
+// when edges or accesses change afterwards
+class TaskGraphListener
+{
+public:
+	virtual ~TaskGraphListener() = default;
+
+	// Return false to reject the edge (it would close a cycle)
+	virtual bool OnDependencyAdded(TaskNode& task, TaskNode& dependency) = 0;
+	virtual void OnAccessDeclared(TaskNode& task, std::initializer_list<ResourceAccess> accesses) = 0;
+};
 
 class TaskNode
 {
 public:
-	TaskNode(const std::string& name, TaskFunction func)
-		: m_name(name), m_func(func), m_completed(false)
+	TaskNode(const std::string& name, TaskFunction func,
+		TaskPriority priority = TaskPriority::Normal, TaskAffinity affinity = TaskAffinity::AnyThread)
+		: m_name(name), m_func(func), m_completed(false), m_priority(priority), m_affinity(affinity), m_access(m_name.c_str())
+	{
+	}
+
+	TaskNode(const std::string& name, CoroutineTaskFunction func,
+		TaskPriority priority = TaskPriority::Normal, TaskAffinity affinity = TaskAffinity::AnyThread)
+		: m_name(name), m_coroutineFunc(func), m_completed(false), m_priority(priority), m_affinity(affinity), m_access(m_name.c_str())
+	{
+	}
+
+	TaskNode(const std::string& name, SpawnTaskFunction func,
+		TaskPriority priority = TaskPriority::Normal, TaskAffinity affinity = TaskAffinity::AnyThread)
+		: m_name(name), m_spawnFunc(func), m_completed(false), m_priority(priority), m_affinity(affinity), m_access(m_name.c_str())
 	{
 	}
 
 	void AddDependency(std::shared_ptr<TaskNode> dependency)
 	{
+		if (std::find(m_dependencies.begin(), m_dependencies.end(), dependency) != m_dependencies.end()) { return; }
+
+		// Already inferred: make it manual, a plan rebuild clears inferred edges
+		auto inferred = std::find(m_inferredDependencies.begin(), m_inferredDependencies.end(), dependency);
+		if (inferred != m_inferredDependencies.end())
+		{
+			m_inferredDependencies.erase(inferred);
+			m_dependencies.push_back(dependency);
+			return;
+		}
+
+		if (m_pListener && !m_pListener->OnDependencyAdded(*this, *dependency)) { return; }
+
 		m_dependencies.push_back(dependency);
+		dependency->m_dependents.push_back(this);
+	}
+
+	// Component / resource types this task touches, see task_access.h
+	void DeclareAccess(std::initializer_list<ResourceAccess> accesses)
+	{
+		for (const ResourceAccess& access : accesses)
+		{
+			m_access.Declare(access);
+		}
+
+		if (m_pListener)
+		{
+			m_pListener->OnAccessDeclared(*this, accesses);
+		}
+	}
+
+	const TaskAccessDeclaration& GetAccess() const { return m_access; }
+
+	// Dependencies derived from access declarations, rebuilt with the execution plan. Skipped when
+	// the edge already exists, manual edges stay manual.
+	void AddInferredDependency(std::shared_ptr<TaskNode> dependency)
+	{
+		if (DependsOn(dependency)) { return; }
+		if (m_pListener && !m_pListener->OnDependencyAdded(*this, *dependency)) { return; }
+
+		m_inferredDependencies.push_back(dependency);
+		dependency->m_dependents.push_back(this);
+	}
+
+	void ClearInferredDependencies()
+	{
+		for (auto& dependency : m_inferredDependencies)
+		{
+			dependency->RemoveDependent(this);
+		}
+		m_inferredDependencies.clear();
+	}
+
+	// Drops every edge to and from this node
+	void Unlink()
+	{
+		for (auto& dependency : m_dependencies)
+		{
+			dependency->RemoveDependent(this);
+		}
+		for (auto& dependency : m_inferredDependencies)
+		{
+			dependency->RemoveDependent(this);
+		}
+		for (TaskNode* pDependent : m_dependents)
+		{
+			pDependent->RemoveDependency(this);
+		}
+
+		m_dependencies.clear();
+		m_inferredDependencies.clear();
+		m_dependents.clear();
+	}
+
+	bool DependsOn(const std::shared_ptr<TaskNode>& task) const
+	{
+		return std::find(m_dependencies.begin(), m_dependencies.end(), task) != m_dependencies.end()
+			|| std::find(m_inferredDependencies.begin(), m_inferredDependencies.end(), task) != m_inferredDependencies.end();
 	}
 
 	void Execute(float dt)
 	{
 		if (!m_completed.load())
 		{
+#if ENC_DEBUG
+			task_access_detail::tl_pExecutingAccess = &m_access;
+#endif
 			m_func(dt);
+#if ENC_DEBUG
+			task_access_detail::tl_pExecutingAccess = nullptr;
+#endif
 			m_completed.store(true);
 		}
 	}
 
+	// Coroutine tasks may suspend on sub-jobs, they're complete once the coroutine returns.
+	// Launched with GetTaskContext, each segment between two co_awaits runs inside the task's profiler
+	// scope and declared accesses, so do the chunk jobs of its ParallelFor / Reduce / Scan.
+	Task<void> ExecuteAsync(float dt)
+	{
+		if (!m_completed.load())
+		{
+			co_await m_coroutineFunc(dt);
+			m_completed.store(true);
+		}
+	}
+
+	bool IsCoroutine() const { return (bool)m_coroutineFunc; }
+
+	// Spawning tasks are complete once their body and every child spawned from it are done,
+	// the scheduler calls MarkCompleted from the spawner's completion
+	void ExecuteSpawning(float dt)
+	{
+#if ENC_DEBUG
+		task_access_detail::tl_pExecutingAccess = &m_access;
+#endif
+		m_spawnFunc(dt, m_spawner);
+#if ENC_DEBUG
+		task_access_detail::tl_pExecutingAccess = nullptr;
+#endif
+	}
+
+	bool IsSpawning() const { return (bool)m_spawnFunc; }
+	TaskSpawner& GetSpawner() { return m_spawner; }
+	void MarkCompleted() { m_completed.store(true); }
+
+	// Per task switch, or a condition shared with other tasks
+	void SetEnabled(bool bEnabled)
+	{
+		AssertMsg(m_pCondition == &m_condition, "Task uses a shared condition, toggle that one instead");
+		m_condition.SetEnabled(bEnabled);
+	}
+
+	void SetCondition(std::shared_ptr<TaskCondition> condition)
+	{
+		m_sharedCondition = std::move(condition);
+		m_pCondition = m_sharedCondition ? m_sharedCondition.get() : &m_condition;
+	}
+
+	bool IsEnabled() const { return m_pCondition->IsEnabled(); }
+
 	void Reset()
 	{
 		m_completed.store(false);
+		m_lastStartNs.store(0, std::memory_order_relaxed);
+		m_lastEndNs.store(0, std::memory_order_relaxed);
+	}
+
+	// Wall clock of the last run (utils::GetTimeNs), zero if it was skipped. Coroutine and spawning
+	// tasks include the time spent waiting on their sub-jobs. Atomic so the editor can read it mid-frame.
+	void BeginTiming() { m_lastStartNs.store(utils::GetTimeNs(), std::memory_order_relaxed); }
+	void EndTiming() { m_lastEndNs.store(utils::GetTimeNs(), std::memory_order_relaxed); }
+
+	u64 GetLastStartNs() const { return m_lastStartNs.load(std::memory_order_relaxed); }
+	u64 GetLastEndNs() const { return m_lastEndNs.load(std::memory_order_relaxed); }
+	u64 GetLastDurationNs() const
+	{
+		const u64 start = GetLastStartNs();
+		const u64 end = GetLastEndNs();
+		return end > start ? end - start : 0;
+	}
+
+	const TaskSchedule& GetSchedule() const { return m_schedule; }
+
+	// Called by the scheduler on the main thread before the graph is kicked
+	void UpdateSchedule(float dt, u64 frameIndex)
+	{
+		m_accumulatedTime += dt;
+
+		switch (m_schedule.mode)
+		{
+		case TaskSchedule::Mode::EveryFrame:
+			m_bDueThisFrame = true;
+			break;
+		case TaskSchedule::Mode::EveryNFrames:
+			m_bDueThisFrame = (frameIndex % m_schedule.frameInterval) == m_framePhase;
+			break;
+		case TaskSchedule::Mode::FixedRate:
+			m_timeUntilRun -= dt;
+			m_bDueThisFrame = m_timeUntilRun <= 0.0f;
+			if (m_bDueThisFrame)
+			{
+				// Keep the cadence, but don't try to catch up after a long stall
+				m_timeUntilRun += m_schedule.interval;
+				if (m_timeUntilRun <= 0.0f)
+				{
+					m_timeUntilRun = m_schedule.interval;
+				}
+			}
+			break;
+		}
+
+		// Only a run consumes the accumulated time, a due but disabled task keeps it until it runs.
+		// Enabled is sampled here, once per frame, so the decision and the dt can't disagree.
+		m_bRunsThisFrame = m_bDueThisFrame && IsEnabled();
+		if (m_bRunsThisFrame)
+		{
+			m_runDeltaTime = m_accumulatedTime;
+			m_accumulatedTime = 0.0f;
+		}
 	}
 
+	// Enabled and due this frame, as of UpdateSchedule
+	bool ShouldRun() const { return m_bRunsThisFrame; }
+	float GetRunDeltaTime() const { return m_runDeltaTime; }
+
 	bool IsComplete() const
 	{
 		return m_completed.load();
@@ -48,11 +288,98 @@ public:
 		return m_dependencies;
 	}
 
+	const std::vector<std::shared_ptr<TaskNode>>& GetInferredDependencies() const
+	{
+		return m_inferredDependencies;
+	}
+
+	u32 GetNumDependencies() const { return (u32)(m_dependencies.size() + m_inferredDependencies.size()); }
+
+	// Tasks depending on this one, manual or inferred. Owned by the scheduler.
+	const std::vector<TaskNode*>& GetDependents() const { return m_dependents; }
+
+	// Bookkeeping for the scheduler owning the node
+	void SetGraphListener(TaskGraphListener* pListener) { m_pListener = pListener; }
+	void SetGraphIndex(u32 index) { m_graphIndex = index; }
+	u32 GetGraphIndex() const { return m_graphIndex; }
+	void SetLevel(u32 level) { m_level = level; }
+	u32 GetLevel() const { return m_level; }
+	void SetVisitMark(u32 mark) { m_visitMark = mark; }
+	u32 GetVisitMark() const { return m_visitMark; }
+
 	const std::string& GetName() const { return m_name; }
+	ProfilerScopeId GetProfilerScopeId() const { return m_profilerScopeId; }
+	TaskContext GetTaskContext() const { return { m_profilerScopeId, &m_access }; }
+
+	void SetPriority(TaskPriority priority) { m_priority = priority; }
+	TaskPriority GetPriority() const { return m_priority; }
+
+	void SetAffinity(TaskAffinity affinity) { m_affinity = affinity; }
+	TaskAffinity GetAffinity() const { return m_affinity; }
+
+private:
+	friend class TaskSchedulerSystem;
+
+	// Through TaskSchedulerSystem::SetSchedule, which resolves an automatic (negative) phase first
+	void SetSchedule(const TaskSchedule& schedule)
+	{
+		AssertMsg(schedule.phase >= 0.0f && schedule.phase < 1.0f, "Schedule phase must be in [0, 1)");
+
+		m_schedule = schedule;
+		m_accumulatedTime = 0.0f;
+		m_framePhase = (u32)(schedule.phase * schedule.frameInterval);
+		m_timeUntilRun = schedule.phase * schedule.interval;
+	}
+
+	void RemoveDependent(TaskNode* pDependent)
+	{
+		auto it = std::find(m_dependents.begin(), m_dependents.end(), pDependent);
+		if (it != m_dependents.end())
+		{
+			*it = m_dependents.back();
+			m_dependents.pop_back();
+		}
+	}
+
+	void RemoveDependency(TaskNode* pDependency)
+	{
+		auto matches = [pDependency](const std::shared_ptr<TaskNode>& task) { return task.get() == pDependency; };
+		std::erase_if(m_dependencies, matches);
+		std::erase_if(m_inferredDependencies, matches);
+	}
 
 private:
 	std::string m_name;
+	ProfilerScopeId m_profilerScopeId = ProfilerScopes::Intern(m_name);	// names are interned once, not per run
 	TaskFunction m_func;
+	CoroutineTaskFunction m_coroutineFunc;
+	SpawnTaskFunction m_spawnFunc;
+	TaskSpawner m_spawner;
 	std::atomic<bool> m_completed;
+	TaskPriority m_priority;
+	TaskAffinity m_affinity;
+	TaskAccessDeclaration m_access;
 	std::vector<std::shared_ptr<TaskNode>> m_dependencies;
+	std::vector<std::shared_ptr<TaskNode>> m_inferredDependencies;
+	std::vector<TaskNode*> m_dependents;
+
+	TaskSchedule m_schedule;
+	f32 m_accumulatedTime = 0.0f;
+	f32 m_timeUntilRun = 0.0f;
+	f32 m_runDeltaTime = 0.0f;
+	u32 m_framePhase = 0;
+	bool m_bDueThisFrame = true;
+	bool m_bRunsThisFrame = true;
+
+	std::atomic<u64> m_lastStartNs{ 0 };
+	std::atomic<u64> m_lastEndNs{ 0 };
+
+	TaskCondition m_condition;
+	std::shared_ptr<TaskCondition> m_sharedCondition;
+	const TaskCondition* m_pCondition = &m_condition;
+
+	TaskGraphListener* m_pListener = nullptr;
+	u32 m_graphIndex = 0;
+	u32 m_level = 0;
+	u32 m_visitMark = 0;
 };
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "core/core_minimal.h"
+
+#include "task_access.h"
+#include "thread_pool.h"
+
+#include <atomic>
+#include <functional>
+
+// Handed to the body of a spawning task node. Children queued through it run on the pool
+// and the node only counts as complete, releasing its dependents, once all of them are done.
+// Children may spawn more children through the same spawner (capture it by reference).
+//
+//	scheduler.CreateSpawningTask("Cull Chunks", [](float dt, TaskSpawner& spawner) {
+//		for (Chunk* pChunk : visibleChunks)
+//		{
+//			spawner.Spawn([pChunk](float dt) { pChunk->Cull(); });
+//		}
+//	});
+class TaskSpawner
+{
+public:
+	using CompletionFunction = std::function<void()>;
+
+	TaskSpawner() = default;
+
+	NO_COPY(TaskSpawner);
+	NO_MOVE(TaskSpawner);
+
+	void Spawn(TaskFunction func)
+	{
+		AssertMsg(m_pPool, "Spawn called outside of the task body");
+
+		m_pending.fetch_add(1, std::memory_order_relaxed);
+		m_pPool->Enqueue(TaskPayload{ [this, func = std::move(func)](float dt) {
+#if ENC_DEBUG
+			// Children act on behalf of the node, same declared accesses
+			task_access_detail::tl_pExecutingAccess = m_pAccess;
+#endif
+			func(dt);
+#if ENC_DEBUG
+			task_access_detail::tl_pExecutingAccess = nullptr;
+#endif
+			Release();
+		}, m_deltaTime, m_priority, TaskAffinity::AnyThread });
+	}
+
+	u32 GetNumPending() const { return m_pending.load(std::memory_order_relaxed); }
+
+	// Scheduler side. The body holds one reference, released once it returns.
+	void Begin(ThreadPool& pool, float dt, TaskPriority priority, const TaskAccessDeclaration* pAccess, CompletionFunction onComplete)
+	{
+		AssertMsg(m_pending.load() == 0, "Spawning task started again before its children finished");
+
+		m_pPool = &pool;
+		m_deltaTime = dt;
+		m_priority = priority;
+		m_pAccess = pAccess;
+		m_onComplete = std::move(onComplete);
+		m_pending.store(1, std::memory_order_relaxed);
+	}
+
+	void Release()
+	{
+		if (m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			// Last one out, the spawner may be reused as soon as the callback returns
+			CompletionFunction onComplete = std::move(m_onComplete);
+			onComplete();
+		}
+	}
+
+private:
+	ThreadPool* m_pPool = nullptr;
+	float m_deltaTime = 0.0f;
+	TaskPriority m_priority = TaskPriority::Normal;
+	const TaskAccessDeclaration* m_pAccess = nullptr;
+	CompletionFunction m_onComplete;
+
+	std::atomic<u32> m_pending{ 0 };
+};
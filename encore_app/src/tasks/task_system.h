@@ -2,12 +2,27 @@
 
 #include "core/core_minimal.h"
 
+#include "cpu_topology.h"
+#include "io_lane.h"
+#include "task_coroutine.h"
+#include "task_graph_simulator.h"
 #include "task_node.h"
 #include "thread_pool.h"
+#include "time_sliced_job.h"
 #include "profiler/profiler_section.h"
 
+#include <cmath>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 
-class TaskSchedulerSystem
+#define COMPILE_DEMO 0
+
+
+// Owns the task graph. The execution plan groups tasks in layers by level (longest chain of
+// dependencies above them). It is built once in O(V + E) by CreateExecutionPlan, then kept up to
+// date as tasks, dependencies and accesses are added or removed, without a full rebuild.
+class TaskSchedulerSystem : public TaskGraphListener
 {
 public:
 	TaskSchedulerSystem(u32 numThreads = std::thread::hardware_concurrency())
@@ -15,35 +30,207 @@ public:
 	{
 	}
 
-	std::shared_ptr<TaskNode> CreateTask(const std::string& name, TaskFunction func)
+	// Worker count and CPU pinning from the machine's topology, see WorkerPlacement
+	explicit TaskSchedulerSystem(const WorkerPlacement& placement)
+		: TaskSchedulerSystem(CpuTopology::Detect(), placement)
 	{
-		auto task = std::make_shared<TaskNode>(name, func);
-		m_taskNodes.push_back(task);
-		DirtyExecutionPlan();
+	}
+
+	std::shared_ptr<TaskNode> CreateTask(const std::string& name, TaskFunction func,
+		TaskPriority priority = TaskPriority::Normal, TaskAffinity affinity = TaskAffinity::AnyThread)
+	{
+		auto task = std::make_shared<TaskNode>(name, func, priority, affinity);
+		AddTaskNode(task);
+		return task;
+	}
+
+	// Runs the task every N frames or at a fixed rate. Without an explicit phase, periodic tasks
+	// are spread over their period (golden ratio sequence) so they don't all land on the same frame.
+	void SetSchedule(const std::shared_ptr<TaskNode>& task, TaskSchedule schedule)
+	{
+		if (schedule.phase < 0.0f)
+		{
+			const f32 goldenRatioConjugate = 0.618034f;
+			const f32 phase = (f32)m_numStaggeredTasks++ * goldenRatioConjugate;
+			schedule.phase = phase - std::floor(phase);
+		}
+		task->SetSchedule(schedule);
+	}
+
+	std::shared_ptr<TaskNode> CreatePeriodicTask(const std::string& name, TaskFunction func, TaskSchedule schedule,
+		TaskPriority priority = TaskPriority::Normal, TaskAffinity affinity = TaskAffinity::AnyThread)
+	{
+		auto task = CreateTask(name, func, priority, affinity);
+		SetSchedule(task, schedule);
+		return task;
+	}
+
+	struct TimeSlicedTask
+	{
+		std::string name;
+		std::shared_ptr<TimeSlicedJob> job;
+	};
+
+	// Graph node running a slice of the job each frame while it has work, see time_sliced_job.h
+	std::shared_ptr<TaskNode> CreateTimeSlicedTask(const std::string& name, std::shared_ptr<TimeSlicedJob> job,
+		TaskPriority priority = TaskPriority::Normal)
+	{
+		auto task = CreateTask(name, [pJob = job.get()](float) { pJob->RunSlice(); }, priority);
+		task->SetCondition(job->GetCondition());
+		m_timeSlicedJobs.push_back({ name, std::move(job) });
+		return task;
+	}
+
+	const std::vector<TimeSlicedTask>& GetTimeSlicedJobs() const { return m_timeSlicedJobs; }
+
+	// Slices that went over their budget, across every time sliced job
+	u64 GetTotalBudgetOverruns() const
+	{
+		u64 overruns = 0;
+		for (const auto& entry : m_timeSlicedJobs)
+		{
+			overruns += entry.job->GetStats().overrunCount;
+		}
+		return overruns;
+	}
+
+	// Task that can fan out child tasks at runtime, see task_spawner.h
+	std::shared_ptr<TaskNode> CreateSpawningTask(const std::string& name, SpawnTaskFunction func,
+		TaskPriority priority = TaskPriority::Normal, TaskAffinity affinity = TaskAffinity::AnyThread)
+	{
+		auto task = std::make_shared<TaskNode>(name, func, priority, affinity);
+		AddTaskNode(task);
 		return task;
 	}
 
+	// Task whose body is a coroutine, it can co_await sub-jobs without blocking its worker
+	std::shared_ptr<TaskNode> CreateCoroutineTask(const std::string& name, CoroutineTaskFunction func,
+		TaskPriority priority = TaskPriority::Normal, TaskAffinity affinity = TaskAffinity::AnyThread)
+	{
+		auto task = std::make_shared<TaskNode>(name, func, priority, affinity);
+		AddTaskNode(task);
+		return task;
+	}
+
+	~TaskSchedulerSystem()
+	{
+		// Workers may still be running graph tasks that reference the plan
+		WaitForTaskGraph();
+
+		for (auto& task : m_taskNodes)
+		{
+			task->SetGraphListener(nullptr);
+		}
+	}
+
 	void ExecuteTaskGraph(float deltaTime)
 	{
 		PROFILE();
 
-		AssertMsg(m_executionPlan.size() != 0 && m_taskNodes.size() > 0, "ExecutionPlan needs to be built");
+		BeginTaskGraph(deltaTime);
+		WaitForTaskGraph();
+	}
+
+	// Kicks the task graph and returns right away. Each layer is queued by whichever
+	// task finishes the previous one, so the calling thread is free until WaitForTaskGraph.
+	void BeginTaskGraph(float deltaTime)
+	{
+		PROFILE();
+
+		AssertMsg(m_bPlanValid && m_taskNodes.size() > 0, "ExecutionPlan needs to be built");
+		AssertMsg(!IsTaskGraphRunning(), "Task graph is already in flight");
 
-		// Reset all tasks
+		// Reset all tasks, decide which periodic ones are due
 		{
 			PROFILE_SCOPE("Reset");
 			for (auto& task : m_taskNodes)
 			{
 				task->Reset();
+				task->UpdateSchedule(deltaTime, m_frameIndex);
 			}
+			m_frameIndex++;
 		}
 
-		// Execute using pre-computed plan
+		m_graphStartNs.store(utils::GetTimeNs(), std::memory_order_relaxed);
+		m_bGraphRunning.store(true, std::memory_order_relaxed);
+		KickLayer(0, deltaTime);
+	}
+
+	// Blocks until the graph kicked by BeginTaskGraph is done, running main thread tasks while we're here
+	void WaitForTaskGraph()
+	{
+		PROFILE();
+
+		while (IsTaskGraphRunning())
 		{
-			PROFILE_SCOPE("Execute Plan");
-			for (const auto& layer : m_executionPlan)
+			if (m_threadPool.ExecuteMainThreadTasks() == 0)
 			{
-				ExecuteLayer(layer, deltaTime);
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	bool IsTaskGraphRunning() const { return m_bGraphRunning.load(std::memory_order_acquire); }
+
+	// Unlinks the task. Its dependents inherit its dependencies so the ordering around it holds.
+	void RemoveTask(const std::shared_ptr<TaskNode>& task)
+	{
+		AssertMsg(!IsTaskGraphRunning(), "Can't change the task graph while it is in flight");
+
+		auto it = std::find(m_taskNodes.begin(), m_taskNodes.end(), task);
+		if (it == m_taskNodes.end())
+		{
+			LOG_WARNING("Task '%s' isn't owned by this scheduler", task->GetName().c_str());
+			return;
+		}
+
+		// A bridged edge is manual only if both edges it replaces were
+		std::vector<std::pair<TaskNode*, bool>> dependents;
+		for (TaskNode* pDependent : task->GetDependents())
+		{
+			const auto& manual = pDependent->GetDependencies();
+			dependents.push_back({ pDependent, std::find(manual.begin(), manual.end(), task) != manual.end() });
+		}
+		const std::vector<std::shared_ptr<TaskNode>> manualDependencies = task->GetDependencies();
+		const std::vector<std::shared_ptr<TaskNode>> inferredDependencies = task->GetInferredDependencies();
+
+		task->Unlink();
+		task->SetGraphListener(nullptr);
+
+		for (auto& [pDependent, bManual] : dependents)
+		{
+			for (auto& dependency : manualDependencies)
+			{
+				bManual ? pDependent->AddDependency(dependency) : pDependent->AddInferredDependency(dependency);
+			}
+			for (auto& dependency : inferredDependencies)
+			{
+				pDependent->AddInferredDependency(dependency);
+			}
+		}
+
+		m_taskNodes.erase(it);
+		for (u32 i = task->GetGraphIndex(); i < m_taskNodes.size(); i++)
+		{
+			m_taskNodes[i]->SetGraphIndex(i);
+		}
+
+		// Keep the last finished timings lined up with the new indices
+		{
+			std::lock_guard<std::mutex> lock(m_completedTimingMutex);
+			if (task->GetGraphIndex() < m_completedDurationsNs.size())
+			{
+				m_completedDurationsNs.erase(m_completedDurationsNs.begin() + task->GetGraphIndex());
+			}
+		}
+
+		// Dependents keep their level, still a valid order, only the next full rebuild compacts it
+		if (m_bPlanValid)
+		{
+			RemoveFromLayer(*task);
+			while (!m_executionPlan.empty() && m_executionPlan.back().empty())
+			{
+				m_executionPlan.pop_back();
 			}
 		}
 	}
@@ -51,114 +238,606 @@ public:
 	void CreateExecutionPlan()
 	{
 		PROFILE();
-		AssertMsg(m_executionPlan.size() == 0, "ExecutionPlan was already built");
-		m_executionPlan = TopologicalSort();
+		AssertMsg(!m_bPlanValid, "ExecutionPlan was already built");
+		InferDependencies();
+		m_bPlanValid = TopologicalSort();
 	}
 
 	void DirtyExecutionPlan()
 	{
+		AssertMsg(!IsTaskGraphRunning(), "Can't change the task graph while it is in flight");
 		m_executionPlan.clear();
+		m_bPlanValid = false;
 	}
 
-private:
-	// Get all tasks that depend on the given task
-	std::vector<std::shared_ptr<TaskNode>> GetDependentTasks(std::shared_ptr<TaskNode> task)
+	bool IsExecutionPlanValid() const { return m_bPlanValid; }
+
+	// Fire and forget job outside of the task graph, e.g. asset decode at TaskPriority::Background
+	void Submit(TaskFunction func, TaskPriority priority = TaskPriority::Normal, TaskAffinity affinity = TaskAffinity::AnyThread)
+	{
+		m_threadPool.Enqueue(TaskPayload{ func, 0.0f, priority, affinity });
+	}
+
+	// Runs jobs queued on the main thread lane. Call once per frame from the main thread.
+	void ExecuteMainThreadTasks()
+	{
+		PROFILE();
+		m_threadPool.ExecuteMainThreadTasks();
+	}
+
+	// Starts a coroutine outside of the task graph, it runs to completion on its own
+	void Launch(Task<void> task, TaskPriority priority = TaskPriority::Normal)
 	{
-		std::vector<std::shared_ptr<TaskNode>> dependents;
+		LaunchTask(m_threadPool, std::move(task), priority);
+	}
 
-		for (auto& otherTask : m_taskNodes)
+	ThreadPool& GetThreadPool() { return m_threadPool; }
+	// File reads off the main thread, completions come back through the thread pool
+	IoLane& GetIoLane() { return m_ioLane; }
+
+	// Durations and edges of the last frame, feed it to a TaskGraphSimulator (or a TaskGraphRecorder first).
+	// Main thread. Captured while the graph is in flight (pipelined frames), tasks that haven't finished yet read 0.
+	// Timings are the last graph that finished, all from the same frame, even with the next one in flight
+	TaskGraphSnapshot CaptureGraphSnapshot() const
+	{
+		TaskGraphSnapshot snapshot;
+		snapshot.numWorkers = m_threadPool.GetNumThreads();
+		snapshot.nodes.reserve(m_taskNodes.size());
+
+		std::lock_guard<std::mutex> lock(m_completedTimingMutex);
+		snapshot.wallTimeNs = GetLastGraphTimeNs();
+
+		for (const auto& task : m_taskNodes)
 		{
-			const auto& deps = otherTask->GetDependencies();
-			if (std::find(deps.begin(), deps.end(), task) != deps.end())
+			TaskGraphSnapshot::Node& node = snapshot.nodes.emplace_back();
+			node.name = task->GetName();
+			node.durationNs = task->GetGraphIndex() < m_completedDurationsNs.size() ? m_completedDurationsNs[task->GetGraphIndex()] : 0;
+			node.level = task->GetLevel();
+			node.priority = task->GetPriority();
+			node.affinity = task->GetAffinity();
+
+			for (const auto& dependency : task->GetDependencies())
+			{
+				node.dependencies.push_back(dependency->GetGraphIndex());
+			}
+			for (const auto& dependency : task->GetInferredDependencies())
 			{
-				dependents.push_back(otherTask);
+				node.dependencies.push_back(dependency->GetGraphIndex());
 			}
 		}
+		return snapshot;
+	}
+
+	// Duration of the last graph that finished, kept while the next one runs (pipelined frames)
+	u64 GetLastGraphTimeNs() const { return m_lastGraphTimeNs.load(std::memory_order_relaxed); }
 
-		return dependents;
+private:
+	TaskSchedulerSystem(const CpuTopology& topology, const WorkerPlacement& placement)
+		: TaskSchedulerSystem(topology, WorkerLayout::Plan(topology, placement))
+	{
 	}
 
-	std::vector<std::vector<std::shared_ptr<TaskNode>>> TopologicalSort()
+	// Constructed on the main thread
+	TaskSchedulerSystem(const CpuTopology& topology, const WorkerLayout& layout)
+		: m_threadPool(PinMainThreadAndGetNumWorkers(layout), "TaskWorker", layout.workerCpus)
 	{
-		std::vector<std::vector<std::shared_ptr<TaskNode>>> layers;
+		layout.Print(topology);
+	}
 
-		// Calculate in-degrees for each task
-		std::unordered_map<std::shared_ptr<TaskNode>, u64> inDegree;
-		for (auto& task : m_taskNodes)
+	// Runs from the pool's initializer: the main thread is pinned before the workers start
+	static u32 PinMainThreadAndGetNumWorkers(const WorkerLayout& layout)
+	{
+		if (layout.mainThreadCpu >= 0 && !utils::PinThreadToCpu((u32)layout.mainThreadCpu))
 		{
-			inDegree[task] = task->GetDependencies().size();
+			LOG_WARNING("Couldn't pin the main thread to CPU %d", layout.mainThreadCpu);
 		}
+		return layout.numWorkers;
+	}
+
+	// Orders tasks that touch the same resource type by registration order:
+	// a reader waits on the last writer, a writer waits on the last writer and every reader since.
+	void InferDependencies()
+	{
+		struct ResourceUsage
+		{
+			std::shared_ptr<TaskNode> lastWriter;
+			std::vector<std::shared_ptr<TaskNode>> readersSinceWrite;
+		};
+		std::unordered_map<ResourceTypeId, ResourceUsage> usages;
 
-		// Find all tasks with no dependencies (in-degree 0)
-		std::queue<std::shared_ptr<TaskNode>> ready;
 		for (auto& task : m_taskNodes)
 		{
-			if (inDegree[task] == 0)
+			task->ClearInferredDependencies();
+
+			for (const ResourceAccess& access : task->GetAccess().GetAccesses())
 			{
-				ready.push(task);
+				ResourceUsage& usage = usages[access.typeId];
+
+				if (usage.lastWriter)
+				{
+					task->AddInferredDependency(usage.lastWriter);
+				}
+
+				if (access.mode == AccessMode::Read)
+				{
+					usage.readersSinceWrite.push_back(task);
+				}
+				else
+				{
+					for (auto& reader : usage.readersSinceWrite)
+					{
+						task->AddInferredDependency(reader);
+					}
+					usage.readersSinceWrite.clear();
+					usage.lastWriter = task;
+				}
 			}
 		}
+	}
+
+	void AddTaskNode(const std::shared_ptr<TaskNode>& task)
+	{
+		AssertMsg(!IsTaskGraphRunning(), "Can't change the task graph while it is in flight");
 
-		// Process layer by layer
-		while (!ready.empty())
+		task->SetGraphListener(this);
+		task->SetGraphIndex((u32)m_taskNodes.size());
+		m_taskNodes.push_back(task);
+
+		// No dependencies yet, the first layer until an edge says otherwise
+		if (m_bPlanValid)
 		{
-			// Current layer: all tasks that are ready now
-			std::vector<std::shared_ptr<TaskNode>> currentLayer;
-			u64 layerSize = ready.size();
+			task->SetLevel(0);
+			AddToLayer(task);
+		}
+	}
 
-			for (u64 i = 0; i < layerSize; i++)
+	void AddToLayer(const std::shared_ptr<TaskNode>& task)
+	{
+		if (m_executionPlan.size() <= task->GetLevel())
+		{
+			m_executionPlan.resize(task->GetLevel() + 1);
+		}
+		m_executionPlan[task->GetLevel()].push_back(task);
+	}
+
+	std::shared_ptr<TaskNode> RemoveFromLayer(TaskNode& task)
+	{
+		auto& layer = m_executionPlan[task.GetLevel()];
+		for (u64 i = 0; i < layer.size(); i++)
+		{
+			if (layer[i].get() == &task)
 			{
-				auto task = ready.front();
-				ready.pop();
-				currentLayer.push_back(task);
+				std::shared_ptr<TaskNode> removed = std::move(layer[i]);
+				layer[i] = std::move(layer.back());
+				layer.pop_back();
+				return removed;
+			}
+		}
+		AssertMsg(false, "Task missing from its layer");
+		return nullptr;
+	}
 
-				// Reduce in-degree of dependent tasks
-				for (auto& dependent : GetDependentTasks(task))
+	// Edges always go from a lower to a higher level. When a new one doesn't, the task
+	// and everything below it moves down, unless the dependency is among them (cycle).
+	bool OnDependencyAdded(TaskNode& task, TaskNode& dependency) override
+	{
+		AssertMsg(!IsTaskGraphRunning(), "Can't change the task graph while it is in flight");
+
+		if (&task == &dependency)
+		{
+			LOG_ERROR("Task '%s' can't depend on itself", task.GetName().c_str());
+			return false;
+		}
+
+		if (!m_bPlanValid || task.GetLevel() > dependency.GetLevel())
+		{
+			return true;
+		}
+
+		if (IsReachable(task, dependency))
+		{
+			LOG_ERROR("Dependency '%s' -> '%s' would create a cycle, ignored",
+				task.GetName().c_str(), dependency.GetName().c_str());
+			return false;
+		}
+
+		RaiseLevel(task, dependency.GetLevel() + 1);
+		return true;
+	}
+
+	// Same rules as InferDependencies, applied to one task against its neighbours in registration order
+	void OnAccessDeclared(TaskNode& task, std::initializer_list<ResourceAccess> accesses) override
+	{
+		if (!m_bPlanValid)
+		{
+			return;
+		}
+
+		const std::shared_ptr<TaskNode>& self = m_taskNodes[task.GetGraphIndex()];
+		for (const ResourceAccess& access : accesses)
+		{
+			// Earlier tasks: a read waits on the last writer, a write also on the readers since
+			for (u32 i = task.GetGraphIndex(); i-- > 0;)
+			{
+				const std::shared_ptr<TaskNode>& other = m_taskNodes[i];
+				const bool bOtherWrites = other->GetAccess().Allows(access.typeId, AccessMode::Write);
+				if (bOtherWrites || (access.mode == AccessMode::Write && other->GetAccess().Allows(access.typeId, AccessMode::Read)))
+				{
+					task.AddInferredDependency(other);
+				}
+				if (bOtherWrites) { break; }
+			}
+
+			// Later tasks: mirrored, up to the next writer
+			for (u32 i = task.GetGraphIndex() + 1; i < m_taskNodes.size(); i++)
+			{
+				const std::shared_ptr<TaskNode>& other = m_taskNodes[i];
+				const bool bOtherWrites = other->GetAccess().Allows(access.typeId, AccessMode::Write);
+				if (bOtherWrites || (access.mode == AccessMode::Write && other->GetAccess().Allows(access.typeId, AccessMode::Read)))
+				{
+					other->AddInferredDependency(self);
+				}
+				if (bOtherWrites) { break; }
+			}
+		}
+	}
+
+	// Levels strictly increase along edges, so the search never goes below the target's level
+	bool IsReachable(TaskNode& from, TaskNode& to)
+	{
+		const u32 mark = ++m_visitMark;
+		std::vector<TaskNode*> stack = { &from };
+		from.SetVisitMark(mark);
+
+		while (!stack.empty())
+		{
+			TaskNode* pNode = stack.back();
+			stack.pop_back();
+			if (pNode == &to)
+			{
+				return true;
+			}
+
+			for (TaskNode* pDependent : pNode->GetDependents())
+			{
+				if (pDependent->GetVisitMark() != mark && pDependent->GetLevel() <= to.GetLevel())
 				{
-					inDegree[dependent]--;
-					if (inDegree[dependent] == 0)
+					pDependent->SetVisitMark(mark);
+					stack.push_back(pDependent);
+				}
+			}
+		}
+		return false;
+	}
+
+	void RaiseLevel(TaskNode& task, u32 level)
+	{
+		std::vector<std::pair<TaskNode*, u32>> stack = { { &task, level } };
+		while (!stack.empty())
+		{
+			auto [pNode, newLevel] = stack.back();
+			stack.pop_back();
+			if (pNode->GetLevel() >= newLevel)
+			{
+				continue;
+			}
+
+			std::shared_ptr<TaskNode> node = RemoveFromLayer(*pNode);
+			pNode->SetLevel(newLevel);
+			AddToLayer(node);
+
+			for (TaskNode* pDependent : pNode->GetDependents())
+			{
+				stack.push_back({ pDependent, newLevel + 1 });
+			}
+		}
+	}
+
+	// Kahn's algorithm over the adjacency lists, one layer per level. O(V + E).
+	bool TopologicalSort()
+	{
+		m_executionPlan.clear();
+
+		const u32 numTasks = (u32)m_taskNodes.size();
+		std::vector<u32> inDegree(numTasks);
+		std::vector<u32> currentLayer;
+		std::vector<u32> nextLayer;
+
+		for (u32 i = 0; i < numTasks; i++)
+		{
+			m_taskNodes[i]->SetGraphIndex(i);
+			inDegree[i] = m_taskNodes[i]->GetNumDependencies();
+			if (inDegree[i] == 0)
+			{
+				currentLayer.push_back(i);
+			}
+		}
+
+		u32 numSorted = 0;
+		while (!currentLayer.empty())
+		{
+			std::vector<std::shared_ptr<TaskNode>> layer;
+			layer.reserve(currentLayer.size());
+
+			for (u32 index : currentLayer)
+			{
+				const std::shared_ptr<TaskNode>& task = m_taskNodes[index];
+				task->SetLevel((u32)m_executionPlan.size());
+				layer.push_back(task);
+				numSorted++;
+
+				for (TaskNode* pDependent : task->GetDependents())
+				{
+					if (--inDegree[pDependent->GetGraphIndex()] == 0)
 					{
-						ready.push(dependent);
+						nextLayer.push_back(pDependent->GetGraphIndex());
 					}
 				}
 			}
 
-			layers.push_back(std::move(currentLayer));
+			m_executionPlan.push_back(std::move(layer));
+			currentLayer.swap(nextLayer);
+			nextLayer.clear();
+		}
+
+		if (numSorted != numTasks)
+		{
+			// Whatever is left waits on itself through a cycle
+			std::string cycleTasks;
+			for (u32 i = 0; i < numTasks; i++)
+			{
+				if (inDegree[i] > 0)
+				{
+					cycleTasks += (cycleTasks.empty() ? "'" : ", '") + m_taskNodes[i]->GetName() + "'";
+				}
+			}
+			LOG_ERROR("Task graph has a cycle, can't build the execution plan. Tasks involved: %s", cycleTasks.c_str());
+			AssertMsg(false, "Cycle in task graph");
+
+			m_executionPlan.clear();
+			return false;
 		}
 
-		return layers;
+		return true;
 	}
 
-	void ExecuteLayer(const std::vector<std::shared_ptr<TaskNode>>& layer, float dt)
+	void KickLayer(u32 layerIndex, float dt)
 	{
-		if (layer.empty()) return;
+		while (true)
+		{
+			// Incremental updates may leave a level empty
+			while (layerIndex < m_executionPlan.size() && m_executionPlan[layerIndex].empty())
+			{
+				layerIndex++;
+			}
 
-		std::atomic<u64> completedTasks{0};
-		const u64 totalTasks = layer.size();
+			if (layerIndex >= m_executionPlan.size())
+			{
+				PublishCompletedTimings();
+				m_bGraphRunning.store(false, std::memory_order_release);
+				return;
+			}
 
-		// Submit all tasks in this layer
-		for (auto& task : layer)
-		{
-			m_threadPool.Enqueue(TaskPayload(
-				[task, &completedTasks](float dt)
+			const auto& layer = m_executionPlan[layerIndex];
+
+			// +1 keeps the layer open until every task is queued, disabled ones are settled below
+			m_layerTasksRemaining.store(layer.size() + 1, std::memory_order_relaxed);
+
+			// Submit all tasks in this layer
+			u64 numSkipped = 0;
+			for (auto& task : layer)
+			{
+				if (!task->ShouldRun())
 				{
-					PROFILE_SCOPE(task->GetName().c_str());
-					task->Execute(dt);
-					completedTasks.fetch_add(1, std::memory_order_relaxed);
-				}, // task
-				dt // deltatime
-			));
+					numSkipped++;
+					continue;
+				}
+
+				// Time since this task last ran, not since last frame
+				const float runDeltaTime = task->GetRunDeltaTime();
+
+				if (task->IsCoroutine())
+				{
+					LaunchTask(m_threadPool, ExecuteCoroutineTask(task, layerIndex, runDeltaTime, dt), task->GetPriority(), task->GetAffinity(),
+						task->GetTaskContext());
+					continue;
+				}
+
+				if (task->IsSpawning())
+				{
+					task->GetSpawner().Begin(m_threadPool, runDeltaTime, task->GetPriority(), &task->GetAccess(), [this, pTask = task.get(), layerIndex, dt]() {
+						pTask->EndTiming();
+						pTask->MarkCompleted();
+						OnTaskCompleted(layerIndex, dt);
+					});
+				}
+
+				m_threadPool.Enqueue(TaskPayload(
+					[this, task, layerIndex, dt](float taskDeltaTime)
+					{
+						task->BeginTiming();
+						{
+							PROFILE_SCOPE_ID(task->GetProfilerScopeId());
+							if (task->IsSpawning())
+							{
+								task->ExecuteSpawning(taskDeltaTime);
+							}
+							else
+							{
+								task->Execute(taskDeltaTime);
+							}
+						}
+
+						if (task->IsSpawning())
+						{
+							// Completes here or with the last child
+							task->GetSpawner().Release();
+						}
+						else
+						{
+							task->EndTiming();
+							OnTaskCompleted(layerIndex, dt);
+						}
+					}, // task
+					runDeltaTime, // deltatime
+					task->GetPriority(),
+					task->GetAffinity(),
+					task->GetProfilerScopeId()
+				));
+			}
+
+			// Once per layer, outside the queue lock: per push / pop would flood the counter ring
+			PROFILE_PLOT("Job Queue Depth", m_threadPool.GetNumPendingTasks());
+
+			// Every enabled task already finished (or there were none): carry on with the next layer here
+			if (m_layerTasksRemaining.fetch_sub(numSkipped + 1, std::memory_order_acq_rel) != numSkipped + 1)
+			{
+				return;
+			}
+			layerIndex++;
+		}
+	}
+
+	// By whoever finishes the graph. Node durations and wall time go out together, under the lock
+	// CaptureGraphSnapshot reads them with, so a snapshot never mixes two frames.
+	void PublishCompletedTimings()
+	{
+		const u64 graphTimeNs = utils::GetTimeNs() - m_graphStartNs.load(std::memory_order_relaxed);
+
+		std::lock_guard<std::mutex> lock(m_completedTimingMutex);
+		m_completedDurationsNs.resize(m_taskNodes.size());
+		for (const auto& task : m_taskNodes)
+		{
+			m_completedDurationsNs[task->GetGraphIndex()] = task->GetLastDurationNs();
 		}
+		m_lastGraphTimeNs.store(graphTimeNs, std::memory_order_relaxed);
+	}
 
-		// Wait for all tasks in this layer to complete
-		while (completedTasks.load(std::memory_order_relaxed) < totalTasks)
+	// The last task of a layer kicks the next one
+	void OnTaskCompleted(u32 layerIndex, float dt)
+	{
+		if (m_layerTasksRemaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
 		{
-			std::this_thread::yield();
+			KickLayer(layerIndex + 1, dt);
 		}
 	}
 
+	Task<void> ExecuteCoroutineTask(std::shared_ptr<TaskNode> task, u32 layerIndex, float taskDeltaTime, float dt)
+	{
+		task->BeginTiming();
+		co_await task->ExecuteAsync(taskDeltaTime);
+		task->EndTiming();
+		OnTaskCompleted(layerIndex, dt);
+	}
+
 	// Same topological sort and execute layer methods...
 	ThreadPool m_threadPool;
+	// After the pool: shut down first, it queues completions on the pool
+	IoLane m_ioLane{ m_threadPool };
 	std::vector<std::shared_ptr<TaskNode>> m_taskNodes;
 	std::vector<std::vector<std::shared_ptr<TaskNode>>> m_executionPlan;
+
+	bool m_bPlanValid = false;
+	u32 m_visitMark = 0;
+
+	u64 m_frameIndex = 0;
+	u32 m_numStaggeredTasks = 0;
+
+	std::atomic<u64> m_graphStartNs{ 0 };
+
+	// Last finished graph, see PublishCompletedTimings. Durations by graph index, 0 for skipped tasks.
+	mutable std::mutex m_completedTimingMutex;
+	std::vector<u64> m_completedDurationsNs;
+	std::atomic<u64> m_lastGraphTimeNs{ 0 };
+
+	std::vector<TimeSlicedTask> m_timeSlicedJobs;
+
+	std::atomic<u64> m_layerTasksRemaining{ 0 };
+	std::atomic<bool> m_bGraphRunning{ false };
 };
+
+#if COMPILE_DEMO
+
+#include <vector>
+
+// Frame time spread of a synthetic graph (4 layers, two fixed-cost tasks per worker each) under
+// different worker placements. What it checks: pinning should show in the tail rather than the
+// mean, with p99 and standard deviation dropping once workers stop migrating and sharing a core
+// with the main thread. Only meaningful on a multi-core machine with SMT, run it there before
+// changing the default placement.
+inline void BenchmarkWorkerPlacement(u32 numFrames = 1000)
+{
+	struct Config
+	{
+		const char* name;
+		WorkerPlacement placement;
+	};
+
+	const Config configs[] = {
+		{ "Not pinned", { false, true, true, 0 } },
+		{ "Pinned, physical cores, main core reserved", { true, true, true, 0 } },
+		{ "Pinned, physical cores", { true, true, false, 0 } },
+		{ "Pinned, every logical CPU", { true, false, false, 0 } },
+	};
+
+	for (const Config& config : configs)
+	{
+		std::vector<f64> frameTimesMs;
+		{
+			TaskSchedulerSystem scheduler(config.placement);
+			const u32 tasksPerLayer = scheduler.GetThreadPool().GetNumThreads() * 2;
+
+			std::vector<std::shared_ptr<TaskNode>> previousLayer;
+			for (u32 layer = 0; layer < 4; layer++)
+			{
+				std::vector<std::shared_ptr<TaskNode>> currentLayer;
+				for (u32 i = 0; i < tasksPerLayer; i++)
+				{
+					auto task = scheduler.CreateTask("Work", [](float) {
+						volatile f64 value = 1.0;
+						for (u32 n = 0; n < 20'000; n++)
+						{
+							value = std::sqrt(value + n);
+						}
+					});
+					for (const auto& dependency : previousLayer)
+					{
+						task->AddDependency(dependency);
+					}
+					currentLayer.push_back(task);
+				}
+				previousLayer = std::move(currentLayer);
+			}
+			scheduler.CreateExecutionPlan();
+
+			frameTimesMs.reserve(numFrames);
+			for (u32 frame = 0; frame < numFrames; frame++)
+			{
+				const u64 start = utils::GetTimeNs();
+				scheduler.ExecuteTaskGraph(0.016f);
+				frameTimesMs.push_back((f64)(utils::GetTimeNs() - start) / 1'000'000.0);
+			}
+		}
+		utils::UnpinThread();
+
+		f64 mean = 0.0;
+		for (f64 frameTime : frameTimesMs)
+		{
+			mean += frameTime;
+		}
+		mean /= frameTimesMs.size();
+
+		f64 variance = 0.0;
+		for (f64 frameTime : frameTimesMs)
+		{
+			variance += (frameTime - mean) * (frameTime - mean);
+		}
+		variance /= frameTimesMs.size();
+
+		std::sort(frameTimesMs.begin(), frameTimesMs.end());
+		LOG_INFO("%s: mean %.3f ms, stddev %.3f ms, p99 %.3f ms, max %.3f ms", config.name,
+			mean, std::sqrt(variance), frameTimesMs[frameTimesMs.size() * 99 / 100], frameTimesMs.back());
+	}
+}
+
+#endif
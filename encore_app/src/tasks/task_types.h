@@ -0,0 +1,54 @@
+#pragma once
+
+#include "core/core_minimal.h"
+
+#include <functional>
+
+
+using TaskFunction = std::function<void(float dt)>;
+
+enum class TaskPriority : u8
+{
+	High,		// Frame-critical work, always picked first
+	Normal,
+	Background,	// Asset decode, pool compaction... yields to everything above
+
+	Count
+};
+
+enum class TaskAffinity : u8
+{
+	AnyThread,
+	MainThread,	// Work that touches the GL context or SDL
+
+	Count
+};
+
+// How often a task node runs. Skipped frames count as done for its dependents,
+// and the dt handed to the task is the time accumulated since its last run.
+struct TaskSchedule
+{
+	enum class Mode : u8
+	{
+		EveryFrame,
+		EveryNFrames,
+		FixedRate,
+	};
+
+	Mode mode = Mode::EveryFrame;
+	u32 frameInterval = 1;
+	f32 interval = 0.0f;	// Seconds between runs for FixedRate
+	f32 phase = -1.0f;		// [0, 1) offset within the period, negative lets the scheduler stagger it
+
+	static TaskSchedule EveryFrame() { return {}; }
+
+	static TaskSchedule EveryNFrames(u32 frames, f32 phase = -1.0f)
+	{
+		return { Mode::EveryNFrames, frames > 0 ? frames : 1, 0.0f, phase };
+	}
+
+	static TaskSchedule AtRate(f32 hz, f32 phase = -1.0f)
+	{
+		return { Mode::FixedRate, 1, hz > 0.0f ? 1.0f / hz : 0.0f, phase };
+	}
+};
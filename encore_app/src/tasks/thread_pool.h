@@ -2,40 +2,79 @@
 
 #include "core/core_minimal.h"
 
-#include "task_node.h"
+#include "task_types.h"
+
+#include <atomic>
 #include <thread>
 #include <queue>
 #include <mutex>
 #include <string>
 #include <format>
+#include <vector>
 
 #include <profiler/profiler.h>
+#include <profiler/profiler_section.h>
+#include <utils/utils_math.h>
 #include <utils/utils_thread.h>
+#include <utils/utils_time.h>
 
 
 struct TaskPayload
 {
 	TaskFunction func;
-	float deltaTime;
+	float deltaTime = 0.0f;
+	TaskPriority priority = TaskPriority::Normal;
+	TaskAffinity affinity = TaskAffinity::AnyThread;
+	ProfilerScopeId scopeId = ProfilerScopes::UNKNOWN_SCOPE;	// names the job in flow tracking, see ThreadPool::Enqueue
+	ProfilerJobStamp stamp;
+};
+
+// What an idle worker does before going to sleep.
+// It spins (cpu pause) first, then yields its time slice, then parks on an atomic wait (futex / WaitOnAddress).
+// Spinning catches the next burst of jobs without a wake-up, parking saves power between frames.
+// { 0, 0 } parks right away.
+struct WorkerParkingPolicy
+{
+	u32 spinIterations = 4096;
+	u32 yieldIterations = 16;
+};
+
+// Per worker counters, see ThreadPool::GetWorkerStats
+struct WorkerStats
+{
+	u64 jobsExecuted = 0;
+	u64 idleTimeNs = 0;			// spinning, yielding or parked
+	u64 parkCount = 0;
+	u64 wakeCount = 0;			// woken up with work to do
+	u64 totalWakeLatencyNs = 0;	// from the wake request to the worker running again
+	u64 maxWakeLatencyNs = 0;
+
+	f32 GetAverageWakeLatencyUs() const { return wakeCount > 0 ? NS_TO_US((f32)totalWakeLatencyNs / wakeCount) : 0.0f; }
 };
 
 class ThreadPool
 {
 public:
-	ThreadPool(u32 numThreads, const std::string& threadNamePrefix = "Worker")
+	// workerCpus: logical CPU to pin each worker to (see WorkerLayout), empty lets the OS place them
+	ThreadPool(u32 numThreads, const std::string& threadNamePrefix = "Worker", const std::vector<u32>& workerCpus = {})
 		: m_bStop(false)
+		, m_mainThreadId(std::this_thread::get_id())
+		, m_maxBackgroundWorkers(ClampBackgroundWorkers(numThreads / 2, numThreads))
+		, m_workerCounters(numThreads)
+		, m_parkingSlots(numThreads)
 	{
 		for (u32 i = 0; i < numThreads; i++)
 		{
 			std::string threadName = std::format("[{}] {}", i, threadNamePrefix);
-			m_workerThreads.emplace_back(&ThreadPool::DoWork, this, threadName);
+			const i32 cpu = i < workerCpus.size() ? (i32)workerCpus[i] : -1;
+			m_workerThreads.emplace_back(&ThreadPool::DoWork, this, threadName, i, cpu);
 		}
 	}
 
 	~ThreadPool()
 	{
 		m_bStop = true;
-		m_cv.notify_all();
+		while (WakeOne()) {}
 
 		for (std::thread& thread : m_workerThreads)
 		{
@@ -46,51 +85,360 @@ public:
 		}
 	}
 
-	void Enqueue(TaskPayload payload)
+	// False once the pool is shutting down, the job is dropped
+	bool Enqueue(TaskPayload payload)
+	{
+		if (m_bStop) { return false; }
+
+		// Queued here, the thread running it records the flow and the time it waited
+		PROFILE_JOB_ENQUEUE(payload.stamp);
+
+		if (payload.affinity == TaskAffinity::MainThread)
+		{
+			std::unique_lock<std::mutex> lock(m_mainThreadMutex);
+			m_mainThreadQueue.push(std::move(payload));
+			return true;
+		}
+
+		{
+			std::unique_lock<ProfiledMutex> lock(m_queueMutex);
+			const bool bBackground = payload.priority == TaskPriority::Background;
+			m_taskQueues[(u8)payload.priority].push(std::move(payload));
+			(bBackground ? m_pendingBackgroundTasks : m_pendingTasks).fetch_add(1);
+		}
+
+		// One job, at most one wake-up. A spinning worker will grab it on its own.
+		if (m_numSpinning.load() == 0 && m_numParked.load() > 0)
+		{
+			WakeOne();
+		}
+		return true;
+	}
+
+	// Runs every job queued for the main thread lane. Must be called from the thread that created the pool.
+	u32 ExecuteMainThreadTasks()
 	{
-		if (m_bStop) { return; }
-		std::unique_lock<std::mutex> lock(m_queueMutex);
-		m_taskQueue.push(payload);
-		m_cv.notify_one();
+		AssertMsg(IsMainThread(), "Main thread lane pumped from a worker");
+
+		u32 executed = 0;
+		while (true)
+		{
+			TaskPayload payload;
+			{
+				std::unique_lock<std::mutex> lock(m_mainThreadMutex);
+				if (m_mainThreadQueue.empty())
+				{
+					break;
+				}
+				payload = std::move(m_mainThreadQueue.front());
+				m_mainThreadQueue.pop();
+			}
+			{
+				PROFILE_JOB_RUN(payload.stamp, payload.scopeId);
+				payload.func(payload.deltaTime);
+			}
+			executed++;
+		}
+		return executed;
 	}
 
 	u32 GetQueueSize()
 	{
-		std::unique_lock<std::mutex> lock(m_queueMutex);
-		return (u32)m_taskQueue.size();
+		std::unique_lock<ProfiledMutex> lock(m_queueMutex);
+		u64 size = 0;
+		for (const auto& queue : m_taskQueues)
+		{
+			size += queue.size();
+		}
+		return (u32)size;
+	}
+
+	u32 GetQueueSize(TaskPriority priority)
+	{
+		std::unique_lock<ProfiledMutex> lock(m_queueMutex);
+		return (u32)m_taskQueues[(u8)priority].size();
+	}
+
+	// Lock free, may be a job off while workers push and pop
+	u32 GetNumPendingTasks() const { return m_pendingTasks.load(std::memory_order_relaxed) + m_pendingBackgroundTasks.load(std::memory_order_relaxed); }
+
+	u32 GetMainThreadQueueSize()
+	{
+		std::unique_lock<std::mutex> lock(m_mainThreadMutex);
+		return (u32)m_mainThreadQueue.size();
+	}
+
+	u32 GetNumThreads() const { return (u32)m_workerThreads.size(); }
+	bool IsMainThread() const { return std::this_thread::get_id() == m_mainThreadId; }
+
+	void SetMaxBackgroundWorkers(u32 maxWorkers) { m_maxBackgroundWorkers.store(ClampBackgroundWorkers(maxWorkers, GetNumThreads())); }
+
+	void SetParkingPolicy(const WorkerParkingPolicy& policy)
+	{
+		m_spinIterations.store(policy.spinIterations, std::memory_order_relaxed);
+		m_yieldIterations.store(policy.yieldIterations, std::memory_order_relaxed);
+	}
+
+	WorkerParkingPolicy GetParkingPolicy() const
+	{
+		return { m_spinIterations.load(std::memory_order_relaxed), m_yieldIterations.load(std::memory_order_relaxed) };
+	}
+
+	u32 GetNumParkedWorkers() const { return m_numParked.load(std::memory_order_relaxed); }
+
+	// Snapshot, counters keep running on the worker
+	WorkerStats GetWorkerStats(u32 workerIndex) const
+	{
+		AssertMsg(workerIndex < m_workerCounters.size(), "Invalid worker index");
+		const WorkerCounters& counters = m_workerCounters[workerIndex];
+
+		WorkerStats stats;
+		stats.jobsExecuted = counters.jobsExecuted.load(std::memory_order_relaxed);
+		stats.idleTimeNs = counters.idleTimeNs.load(std::memory_order_relaxed);
+		stats.parkCount = counters.parkCount.load(std::memory_order_relaxed);
+		stats.wakeCount = counters.wakeCount.load(std::memory_order_relaxed);
+		stats.totalWakeLatencyNs = counters.totalWakeLatencyNs.load(std::memory_order_relaxed);
+		stats.maxWakeLatencyNs = counters.maxWakeLatencyNs.load(std::memory_order_relaxed);
+		return stats;
+	}
+
+	void ResetWorkerStats()
+	{
+		for (WorkerCounters& counters : m_workerCounters)
+		{
+			counters.jobsExecuted.store(0, std::memory_order_relaxed);
+			counters.idleTimeNs.store(0, std::memory_order_relaxed);
+			counters.parkCount.store(0, std::memory_order_relaxed);
+			counters.wakeCount.store(0, std::memory_order_relaxed);
+			counters.totalWakeLatencyNs.store(0, std::memory_order_relaxed);
+			counters.maxWakeLatencyNs.store(0, std::memory_order_relaxed);
+		}
 	}
 
 private:
-	void DoWork(const std::string& threadName)
+	// Written only by the owning worker, own cache line so workers don't false share
+	struct alignas(CACHE_LINE_SIZE) WorkerCounters
+	{
+		std::atomic<u64> jobsExecuted{ 0 };
+		std::atomic<u64> idleTimeNs{ 0 };
+		std::atomic<u64> parkCount{ 0 };
+		std::atomic<u64> wakeCount{ 0 };
+		std::atomic<u64> totalWakeLatencyNs{ 0 };
+		std::atomic<u64> maxWakeLatencyNs{ 0 };
+	};
+
+	// A worker parks on its own slot. Claiming it swaps PARKED for the wake request time, so each
+	// worker's wake latency is measured from the request that woke it, not the latest one.
+	struct alignas(CACHE_LINE_SIZE) ParkingSlot
+	{
+		static constexpr u64 AWAKE = ~0ull;
+		static constexpr u64 PARKED = 0;
+
+		std::atomic<u64> state{ AWAKE };
+	};
+
+	// Lock free check used while spinning. Background jobs only count while a background slot is free.
+	bool HasPendingWork() const
+	{
+		return m_pendingTasks.load() > 0
+			|| (m_pendingBackgroundTasks.load() > 0 && m_activeBackgroundWorkers.load() < m_maxBackgroundWorkers.load());
+	}
+
+	// Claims a parked worker by writing the request time into its slot, then wakes that one.
+	// False if nobody is parked (whoever was about to is going to see the work on its own).
+	bool WakeOne()
+	{
+		for (ParkingSlot& slot : m_parkingSlots)
+		{
+			u64 expected = ParkingSlot::PARKED;
+			if (slot.state.load(std::memory_order_relaxed) == ParkingSlot::PARKED
+				&& slot.state.compare_exchange_strong(expected, utils::GetTimeNs()))
+			{
+				slot.state.notify_one();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Leaves at least one worker free for frame-critical work. A single worker pool has
+	// none to spare: background jobs still run there, interleaved with frame jobs.
+	static u32 ClampBackgroundWorkers(u32 maxWorkers, u32 numThreads)
+	{
+		return numThreads > 1 ? utils::Clamp(maxWorkers, 1u, numThreads - 1) : 1u;
+	}
+
+	// Highest priority first. Background jobs are only handed out while fewer than
+	// m_maxBackgroundWorkers are busy with one, so a long decode can't occupy every worker
+	// (except in a single worker pool, see ClampBackgroundWorkers).
+	bool PopTask(TaskPayload& outPayload)
+	{
+		for (u8 i = 0; i < (u8)TaskPriority::Count; i++)
+		{
+			if (m_taskQueues[i].empty()) { continue; }
+
+			if (i == (u8)TaskPriority::Background)
+			{
+				if (m_activeBackgroundWorkers.load() >= m_maxBackgroundWorkers.load()) { return false; }
+				m_activeBackgroundWorkers.fetch_add(1);
+				m_pendingBackgroundTasks.fetch_sub(1);
+			}
+			else
+			{
+				m_pendingTasks.fetch_sub(1);
+			}
+
+			outPayload = std::move(m_taskQueues[i].front());
+			m_taskQueues[i].pop();
+			return true;
+		}
+		return false;
+	}
+
+	bool TryPopTask(TaskPayload& outPayload)
+	{
+		if (!HasPendingWork()) { return false; }
+
+		std::unique_lock<ProfiledMutex> lock(m_queueMutex);
+		return PopTask(outPayload);
+	}
+
+	// Spin, then yield, then park until Enqueue wakes us up
+	void WaitForWork(WorkerCounters& counters, ParkingSlot& slot)
+	{
+		const u64 idleStart = utils::GetTimeNs();
+
+		bool bFoundWork = false;
+		m_numSpinning.fetch_add(1);
+		{
+			const u32 spinIterations = m_spinIterations.load(std::memory_order_relaxed);
+			for (u32 i = 0; i < spinIterations && !bFoundWork; i++)
+			{
+				utils::CpuRelax();
+				bFoundWork = HasPendingWork() || m_bStop.load();
+			}
+
+			const u32 yieldIterations = m_yieldIterations.load(std::memory_order_relaxed);
+			for (u32 i = 0; i < yieldIterations && !bFoundWork; i++)
+			{
+				std::this_thread::yield();
+				bFoundWork = HasPendingWork() || m_bStop.load();
+			}
+		}
+		m_numSpinning.fetch_sub(1);
+
+		if (!bFoundWork)
+		{
+			// Register as parked before the final check, Enqueue checks m_numParked after publishing the job
+			m_numParked.fetch_add(1);
+			slot.state.store(ParkingSlot::PARKED);
+			if (!HasPendingWork() && !m_bStop.load())
+			{
+				counters.parkCount.fetch_add(1, std::memory_order_relaxed);
+
+				// Whoever claims the slot leaves the time it asked for the wake-up in it
+				u64 wakeRequestTime;
+				while ((wakeRequestTime = slot.state.load()) == ParkingSlot::PARKED)
+				{
+					slot.state.wait(ParkingSlot::PARKED);
+				}
+
+				const u64 now = utils::GetTimeNs();
+				if (now > wakeRequestTime && HasPendingWork() && !m_bStop.load())
+				{
+					const u64 latency = now - wakeRequestTime;
+					counters.wakeCount.fetch_add(1, std::memory_order_relaxed);
+					counters.totalWakeLatencyNs.fetch_add(latency, std::memory_order_relaxed);
+					if (latency > counters.maxWakeLatencyNs.load(std::memory_order_relaxed))
+					{
+						counters.maxWakeLatencyNs.store(latency, std::memory_order_relaxed);
+					}
+				}
+			}
+			// Also drops a claim that came in after the final check found work, this worker takes it
+			slot.state.store(ParkingSlot::AWAKE);
+			m_numParked.fetch_sub(1);
+		}
+
+		counters.idleTimeNs.fetch_add(utils::GetTimeNs() - idleStart, std::memory_order_relaxed);
+	}
+
+	void DoWork(const std::string& threadName, u32 workerIndex, i32 cpu)
 	{
 		// Set thread name
 		utils::NameThread(threadName);
 
+		if (cpu >= 0 && !utils::PinThreadToCpu((u32)cpu))
+		{
+			LOG_WARNING("Couldn't pin %s to CPU %d", threadName.c_str(), cpu);
+		}
+
 		PROFILE_SET_THREAD_NAME(threadName.c_str());
 
-		while (!m_bStop.load())
+		WorkerCounters& counters = m_workerCounters[workerIndex];
+		ParkingSlot& parkingSlot = m_parkingSlots[workerIndex];
+
+		while (true)
 		{
 			TaskPayload payload;
+			if (!TryPopTask(payload))
 			{
-				std::unique_lock<std::mutex> lock(m_queueMutex);
-				m_cv.wait(lock, [this]() { return m_bStop.load() || !m_taskQueue.empty(); });
-
-				if (m_bStop.load() && m_taskQueue.empty())
+				// Drain the queues before leaving
+				if (m_bStop.load())
 				{
 					return;
 				}
 
-				payload = std::move(m_taskQueue.front());
-				m_taskQueue.pop();
+				WaitForWork(counters, parkingSlot);
+				continue;
+			}
+
+			// More work queued and nobody looking for it: pass the wake-up on
+			if (m_numSpinning.load() == 0 && m_numParked.load() > 0 && HasPendingWork())
+			{
+				WakeOne();
+			}
+
+			{
+				PROFILE_JOB_RUN(payload.stamp, payload.scopeId);
+				payload.func(payload.deltaTime);
+			}
+			counters.jobsExecuted.fetch_add(1, std::memory_order_relaxed);
+
+			if (payload.priority == TaskPriority::Background)
+			{
+				m_activeBackgroundWorkers.fetch_sub(1);
+				// A background slot freed up, someone may be waiting on it
+				if (m_numParked.load() > 0 && HasPendingWork())
+				{
+					WakeOne();
+				}
 			}
-			payload.func(payload.deltaTime);
 		}
 	}
 
 private:
 	std::vector<std::thread> m_workerThreads;
-	std::queue<TaskPayload> m_taskQueue;
-	std::mutex m_queueMutex;
-	std::condition_variable m_cv;
+	std::queue<TaskPayload> m_taskQueues[(u8)TaskPriority::Count];
+	ProfiledMutex m_queueMutex{ "ThreadPool Queue" };
 	std::atomic<bool> m_bStop;
+
+	// Main thread lane, pumped by ExecuteMainThreadTasks
+	std::queue<TaskPayload> m_mainThreadQueue;
+	std::mutex m_mainThreadMutex;
+	std::thread::id m_mainThreadId;
+
+	std::atomic<u32> m_maxBackgroundWorkers;
+	std::atomic<u32> m_activeBackgroundWorkers{ 0 };
+
+	// Parking. Job counts mirror the queues so idle workers can poll without the mutex.
+	std::atomic<u32> m_pendingTasks{ 0 };
+	std::atomic<u32> m_pendingBackgroundTasks{ 0 };
+	std::atomic<u32> m_numSpinning{ 0 };
+	std::atomic<u32> m_numParked{ 0 };
+	std::atomic<u32> m_spinIterations{ WorkerParkingPolicy{}.spinIterations };
+	std::atomic<u32> m_yieldIterations{ WorkerParkingPolicy{}.yieldIterations };
+
+	std::vector<WorkerCounters> m_workerCounters;
+	std::vector<ParkingSlot> m_parkingSlots;
 };
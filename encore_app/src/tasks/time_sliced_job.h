@@ -0,0 +1,151 @@
+#pragma once
+
+#include "core/core_minimal.h"
+
+#include "task_node.h"
+
+#include <utils/utils_math.h>
+#include <utils/utils_time.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+// Long running work (pool defragmentation, spatial index rebuilds, asset post-processing) spread
+// over several frames. Each frame the job runs steps until its budget is spent and picks up from
+// there the next frame. It lives in the task graph (TaskSchedulerSystem::CreateTimeSlicedTask),
+// so it gets ordered against other tasks through DeclareAccess like any other node.
+//
+//	auto job = TimeSlicedJob::ForEach(pool.GetCapacity(), [&](u32 index) { CompactSlot(index); }, 0.5f);
+//	scheduler.CreateTimeSlicedTask("Pool Defrag", job);
+//	...
+//	job->Start(); // queue another pass once this one is done
+class TimeSlicedJob
+{
+public:
+	// One unit of work, returns false once there is nothing left
+	using StepFunction = std::function<bool()>;
+
+	struct Stats
+	{
+		u64 slicesRun = 0;
+		u64 stepsRun = 0;
+		u64 passesCompleted = 0;
+		u64 overrunCount = 0;		// slices that went over budget (a step much longer than the average)
+		u64 worstOverrunNs = 0;
+		u64 lastSliceNs = 0;
+	};
+
+	TimeSlicedJob(StepFunction step, f32 budgetMs)
+		: m_step(std::move(step))
+		, m_budgetNs((u64)(budgetMs * 1'000'000.0f))
+		, m_condition(std::make_shared<TaskCondition>(true))
+	{
+	}
+
+	NO_COPY(TimeSlicedJob);
+	NO_MOVE(TimeSlicedJob);
+
+	// Works through [0, count), the cursor is kept between frames
+	static std::shared_ptr<TimeSlicedJob> ForEach(u32 count, std::function<void(u32 index)> func, f32 budgetMs)
+	{
+		auto cursor = std::make_shared<u32>(0);
+		return std::make_shared<TimeSlicedJob>([cursor, count, func = std::move(func)]() {
+			if (*cursor < count)
+			{
+				func((*cursor)++);
+			}
+			if (*cursor < count)
+			{
+				return true;
+			}
+			*cursor = 0; // ready for the next pass
+			return false;
+		}, budgetMs);
+	}
+
+	// Runs steps until the work is done or the next step wouldn't fit in the budget (going by the
+	// average step cost so far). Always makes progress, at least one step per slice.
+	void RunSlice()
+	{
+		const u64 start = utils::GetTimeNs();
+		u64 elapsed = 0;
+
+		while (true)
+		{
+			const bool bMoreWork = m_step();
+			m_counters.stepsRun.fetch_add(1, std::memory_order_relaxed);
+
+			const u64 now = utils::GetTimeNs() - start;
+			const u64 stepNs = now - elapsed;
+			elapsed = now;
+			m_averageStepNs = m_averageStepNs == 0 ? stepNs : (m_averageStepNs * 7 + stepNs) / 8;
+
+			if (!bMoreWork)
+			{
+				m_counters.passesCompleted.fetch_add(1, std::memory_order_relaxed);
+				m_condition->SetEnabled(false);
+				break;
+			}
+
+			if (elapsed + m_averageStepNs > m_budgetNs)
+			{
+				break;
+			}
+		}
+
+		m_counters.slicesRun.fetch_add(1, std::memory_order_relaxed);
+		m_counters.lastSliceNs.store(elapsed, std::memory_order_relaxed);
+		if (elapsed > m_budgetNs)
+		{
+			m_counters.overrunCount.fetch_add(1, std::memory_order_relaxed);
+			if (elapsed - m_budgetNs > m_counters.worstOverrunNs.load(std::memory_order_relaxed))
+			{
+				m_counters.worstOverrunNs.store(elapsed - m_budgetNs, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Resumes a paused job, or starts the next pass of a finished one. Main thread, between frames.
+	void Start() { m_condition->SetEnabled(true); }
+	// Stops after the current slice, Start picks up where it stopped
+	void Pause() { m_condition->SetEnabled(false); }
+	bool IsRunning() const { return m_condition->IsEnabled(); }
+
+	void SetBudgetMs(f32 budgetMs) { m_budgetNs = (u64)(budgetMs * 1'000'000.0f); }
+	f32 GetBudgetMs() const { return (f32)m_budgetNs / 1'000'000.0f; }
+
+	// Snapshot, any thread. The counters keep running if a slice is in flight (pipelined frames).
+	Stats GetStats() const
+	{
+		Stats stats;
+		stats.slicesRun = m_counters.slicesRun.load(std::memory_order_relaxed);
+		stats.stepsRun = m_counters.stepsRun.load(std::memory_order_relaxed);
+		stats.passesCompleted = m_counters.passesCompleted.load(std::memory_order_relaxed);
+		stats.overrunCount = m_counters.overrunCount.load(std::memory_order_relaxed);
+		stats.worstOverrunNs = m_counters.worstOverrunNs.load(std::memory_order_relaxed);
+		stats.lastSliceNs = m_counters.lastSliceNs.load(std::memory_order_relaxed);
+		return stats;
+	}
+
+	// Shared with the task node, a finished job costs one flag check per frame
+	const std::shared_ptr<TaskCondition>& GetCondition() const { return m_condition; }
+
+private:
+	// Written only by the worker running the slice, one slice at a time
+	struct Counters
+	{
+		std::atomic<u64> slicesRun{ 0 };
+		std::atomic<u64> stepsRun{ 0 };
+		std::atomic<u64> passesCompleted{ 0 };
+		std::atomic<u64> overrunCount{ 0 };
+		std::atomic<u64> worstOverrunNs{ 0 };
+		std::atomic<u64> lastSliceNs{ 0 };
+	};
+
+	StepFunction m_step;
+	u64 m_budgetNs;
+	u64 m_averageStepNs = 0;
+	std::shared_ptr<TaskCondition> m_condition;
+	Counters m_counters;
+};
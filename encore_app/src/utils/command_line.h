@@ -0,0 +1,70 @@
+#pragma once
+
+#include "core/core_minimal.h"
+#include "manager/base_singleton.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Flags passed to the executable, "--name" or "--name=value".
+// Filled once by main before the engine starts, read-only after that.
+class CommandLine
+{
+	DECLARE_SINGLETON(CommandLine);
+
+public:
+	void Init(i32 argc, char* argv[])
+	{
+		m_args.clear();
+		for (i32 i = 1; i < argc; i++)
+		{
+			m_args.emplace_back(argv[i]);
+		}
+	}
+
+	bool HasFlag(const char* name) const
+	{
+		return FindValue(name) != nullptr;
+	}
+
+	// Value of --name=value, pDefault if the flag is missing or has no value
+	const char* GetString(const char* name, const char* pDefault = nullptr) const
+	{
+		const char* pValue = FindValue(name);
+		return pValue && *pValue ? pValue : pDefault;
+	}
+
+	u32 GetU32(const char* name, u32 defaultValue) const
+	{
+		const char* pValue = GetString(name);
+		return pValue ? (u32)std::strtoul(pValue, nullptr, 10) : defaultValue;
+	}
+
+private:
+	// Points at the value (empty string for a bare flag), null if not passed
+	const char* FindValue(const char* name) const
+	{
+		const u64 nameLength = std::strlen(name);
+		for (const std::string& arg : m_args)
+		{
+			if (arg.size() < nameLength + 2 || arg.compare(0, 2, "--") != 0 || arg.compare(2, nameLength, name) != 0)
+			{
+				continue;
+			}
+
+			if (arg.size() == nameLength + 2)
+			{
+				return arg.c_str() + arg.size();
+			}
+			if (arg[nameLength + 2] == '=')
+			{
+				return arg.c_str() + nameLength + 3;
+			}
+		}
+		return nullptr;
+	}
+
+	std::vector<std::string> m_args;
+};
@@ -1,14 +1,22 @@
 #pragma once
 
+#include "core/core_minimal.h"
+
 // Platform-specific includes for thread naming
 #ifdef _WIN32
 #include <windows.h>
 #include <processthreadsapi.h>
 #elif defined(__linux__) || defined(__APPLE__)
 #include <pthread.h>
+#include <sched.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
 #endif
 
 #include <string>
+#include <thread>
 
 namespace utils {
 	static void NameThread(const std::string& name)
@@ -23,6 +31,59 @@ namespace utils {
 #elif defined(__APPLE__)
 		// macOS implementation
 		pthread_setname_np(name.c_str());
+#endif
+	}
+
+	// Spin-wait hint, frees the pipeline for the sibling hyperthread
+	static void CpuRelax()
+	{
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+		_mm_pause();
+#elif defined(__aarch64__)
+		__asm__ __volatile__("yield");
+#endif
+	}
+
+	// Pins the calling thread to one logical CPU. Returns false if the OS refused (or can't do it).
+	static bool PinThreadToCpu(u32 cpu)
+	{
+#ifdef _WIN32
+		// Processor group 0 only, that's every CPU on machines with up to 64 of them
+		if (cpu >= 64)
+		{
+			return false;
+		}
+		return SetThreadAffinityMask(GetCurrentThread(), 1ull << cpu) != 0;
+#elif defined(__linux__)
+		cpu_set_t cpuSet;
+		CPU_ZERO(&cpuSet);
+		CPU_SET(cpu, &cpuSet);
+		return pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) == 0;
+#else
+		// macOS only takes affinity hints through thread_policy_set
+		return false;
+#endif
+	}
+
+	// Lets the calling thread run anywhere again
+	static void UnpinThread()
+	{
+#ifdef _WIN32
+		DWORD_PTR processMask = 0;
+		DWORD_PTR systemMask = 0;
+		if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+		{
+			SetThreadAffinityMask(GetCurrentThread(), processMask);
+		}
+#elif defined(__linux__)
+		cpu_set_t cpuSet;
+		CPU_ZERO(&cpuSet);
+		const u32 numCpus = std::thread::hardware_concurrency();
+		for (u32 cpu = 0; cpu < numCpus && cpu < CPU_SETSIZE; cpu++)
+		{
+			CPU_SET(cpu, &cpuSet);
+		}
+		pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
 #endif
 	}
 }
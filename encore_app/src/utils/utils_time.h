@@ -3,8 +3,16 @@
 #include "core/core_minimal.h"
 #include "utils/string_factory.h"
 
+#include <chrono>
+
 namespace utils
 {
+	// Monotonic clock for measuring durations
+	static u64 GetTimeNs()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
 	static const char* FormatDuration(u64 duration, bool bShowMicroseconds)
 	{
 		if(bShowMicroseconds)
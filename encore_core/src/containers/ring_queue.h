@@ -0,0 +1,336 @@
+#pragma once
+
+#include "core/core_minimal.h"
+
+#include <atomic>
+#include <utility>
+
+#define COMPILE_DEMO 0
+
+// Bounded lock-free queues for messages between threads, such as RenderSystem's main to render
+// thread command queue. Capacity is fixed at compile time and must be a power of two.
+// TryPush / TryPop never block: a full queue refuses the push and the caller decides whether to
+// retry, drop or fall back to something else.
+//
+// The read and write cursors live on separate cache lines, so a producer and a consumer running
+// side by side don't keep stealing the same line from each other.
+
+// One producer thread, one consumer thread. Each side keeps a cached copy of the other side's
+// cursor and only reloads it when the queue looks full (or empty), most operations touch no shared line.
+template<typename T, u32 Capacity>
+class SpscRingQueue
+{
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+	SpscRingQueue() = default;
+
+	NO_COPY(SpscRingQueue);
+	NO_MOVE(SpscRingQueue);
+
+	// Producer thread only
+	template<typename U>
+	bool TryPush(U&& value)
+	{
+		const u64 write = m_producer.write.load(std::memory_order_relaxed);
+		if (write - m_producer.cachedRead == Capacity)
+		{
+			m_producer.cachedRead = m_consumer.read.load(std::memory_order_acquire);
+			if (write - m_producer.cachedRead == Capacity)
+			{
+				return false;
+			}
+		}
+
+		m_items[write & MASK] = std::forward<U>(value);
+		m_producer.write.store(write + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer thread only
+	bool TryPop(T& rOutValue)
+	{
+		const u64 read = m_consumer.read.load(std::memory_order_relaxed);
+		if (read == m_consumer.cachedWrite)
+		{
+			m_consumer.cachedWrite = m_producer.write.load(std::memory_order_acquire);
+			if (read == m_consumer.cachedWrite)
+			{
+				return false;
+			}
+		}
+
+		rOutValue = std::move(m_items[read & MASK]);
+		m_consumer.read.store(read + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Approximate when the other side is running
+	u32 GetSize() const
+	{
+		const u64 write = m_producer.write.load(std::memory_order_acquire);
+		const u64 read = m_consumer.read.load(std::memory_order_acquire);
+		return (u32)(write - read);
+	}
+
+	bool IsEmpty() const { return GetSize() == 0; }
+	static constexpr u32 GetCapacity() { return Capacity; }
+
+private:
+	static constexpr u64 MASK = Capacity - 1;
+
+	struct alignas(CACHE_LINE_SIZE) Producer
+	{
+		std::atomic<u64> write{ 0 };
+		u64 cachedRead = 0;
+	};
+
+	struct alignas(CACHE_LINE_SIZE) Consumer
+	{
+		std::atomic<u64> read{ 0 };
+		u64 cachedWrite = 0;
+	};
+
+	Producer m_producer;
+	Consumer m_consumer;
+	alignas(CACHE_LINE_SIZE) T m_items[Capacity];
+};
+
+// Any number of producers and consumers. Every slot carries a sequence number telling whose turn
+// it is: a producer claims a slot by moving the write cursor forward with a CAS, fills it, then
+// publishes it by bumping the slot's sequence. Consumers do the same on the read cursor.
+// Threads only contend on the cursor they move, and on a slot when the queue is nearly full or empty.
+template<typename T, u32 Capacity>
+class MpmcRingQueue
+{
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+	MpmcRingQueue()
+	{
+		for (u32 i = 0; i < Capacity; i++)
+		{
+			m_slots[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	NO_COPY(MpmcRingQueue);
+	NO_MOVE(MpmcRingQueue);
+
+	template<typename U>
+	bool TryPush(U&& value)
+	{
+		u64 write = m_write.load(std::memory_order_relaxed);
+		while (true)
+		{
+			Slot& slot = m_slots[write & MASK];
+			const u64 sequence = slot.sequence.load(std::memory_order_acquire);
+			const i64 diff = (i64)sequence - (i64)write;
+
+			if (diff == 0)
+			{
+				// Slot is free for this lap, claim it
+				if (m_write.compare_exchange_weak(write, write + 1, std::memory_order_relaxed))
+				{
+					slot.value = std::forward<U>(value);
+					slot.sequence.store(write + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0)
+			{
+				// Still holds last lap's item, the queue is full
+				return false;
+			}
+			else
+			{
+				// Another producer got here first
+				write = m_write.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	bool TryPop(T& rOutValue)
+	{
+		u64 read = m_read.load(std::memory_order_relaxed);
+		while (true)
+		{
+			Slot& slot = m_slots[read & MASK];
+			const u64 sequence = slot.sequence.load(std::memory_order_acquire);
+			const i64 diff = (i64)sequence - (i64)(read + 1);
+
+			if (diff == 0)
+			{
+				if (m_read.compare_exchange_weak(read, read + 1, std::memory_order_relaxed))
+				{
+					rOutValue = std::move(slot.value);
+					// Free for the producers' next lap
+					slot.sequence.store(read + Capacity, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0)
+			{
+				// Not written yet, the queue is empty
+				return false;
+			}
+			else
+			{
+				read = m_read.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Approximate when other threads are running
+	u32 GetSize() const
+	{
+		const u64 write = m_write.load(std::memory_order_relaxed);
+		const u64 read = m_read.load(std::memory_order_relaxed);
+		return write > read ? (u32)(write - read) : 0;
+	}
+
+	bool IsEmpty() const { return GetSize() == 0; }
+	static constexpr u32 GetCapacity() { return Capacity; }
+
+private:
+	static constexpr u64 MASK = Capacity - 1;
+
+	// Neighbouring slots are written by different threads, one line each
+	struct alignas(CACHE_LINE_SIZE) Slot
+	{
+		std::atomic<u64> sequence{ 0 };
+		T value{};
+	};
+
+	alignas(CACHE_LINE_SIZE) std::atomic<u64> m_write{ 0 };
+	alignas(CACHE_LINE_SIZE) std::atomic<u64> m_read{ 0 };
+	Slot m_slots[Capacity];
+};
+
+#if COMPILE_DEMO
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Contention benchmark: N producers push numItems each while N consumers drain, reports
+// throughput for the lock-free queues against the std::queue + mutex they replace.
+namespace ring_queue_demo
+{
+	// Same interface as the ring queues, for comparison
+	class MutexQueue
+	{
+	public:
+		bool TryPush(u64 value)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_queue.push(value);
+			return true;
+		}
+
+		bool TryPop(u64& rOutValue)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_queue.empty())
+			{
+				return false;
+			}
+			rOutValue = m_queue.front();
+			m_queue.pop();
+			return true;
+		}
+
+	private:
+		std::queue<u64> m_queue;
+		std::mutex m_mutex;
+	};
+
+	template<typename TQueue>
+	f64 Run(TQueue& queue, u32 numProducers, u32 numConsumers, u64 numItems)
+	{
+		std::atomic<u64> consumed{ 0 };
+		std::atomic<u64> checksum{ 0 };
+		const u64 total = numItems * numProducers;
+
+		const auto start = std::chrono::steady_clock::now();
+
+		std::vector<std::thread> threads;
+		for (u32 p = 0; p < numProducers; p++)
+		{
+			threads.emplace_back([&queue, numItems]() {
+				for (u64 i = 1; i <= numItems; i++)
+				{
+					while (!queue.TryPush(i))
+					{
+						std::this_thread::yield();
+					}
+				}
+			});
+		}
+
+		for (u32 c = 0; c < numConsumers; c++)
+		{
+			threads.emplace_back([&queue, &consumed, &checksum, total]() {
+				u64 value = 0;
+				u64 localSum = 0;
+				while (consumed.load(std::memory_order_relaxed) < total)
+				{
+					if (queue.TryPop(value))
+					{
+						localSum += value;
+						consumed.fetch_add(1, std::memory_order_relaxed);
+					}
+					else
+					{
+						std::this_thread::yield();
+					}
+				}
+				checksum.fetch_add(localSum);
+			});
+		}
+
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+
+		const f64 seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+
+		const u64 expected = numProducers * (numItems * (numItems + 1) / 2);
+		if (checksum.load() != expected)
+		{
+			LOG_ERROR("Queue lost or duplicated items (checksum %llu, expected %llu)", checksum.load(), expected);
+		}
+
+		return (f64)total / seconds / 1'000'000.0;
+	}
+}
+
+// Only meaningful on a machine with at least as many cores as threads: time sliced on fewer cores,
+// producers and consumers rarely touch the queue at the same time and it mostly measures call cost.
+inline void BenchmarkRingQueues(u64 numItems = 1'000'000)
+{
+	using namespace ring_queue_demo;
+
+	static constexpr u32 CAPACITY = 4096;
+
+	{
+		MutexQueue mutexQueue;
+		auto pSpsc = std::make_unique<SpscRingQueue<u64, CAPACITY>>();
+		LOG_INFO("1 producer / 1 consumer: mutex %.2f M/s, spsc %.2f M/s",
+			Run(mutexQueue, 1, 1, numItems), Run(*pSpsc, 1, 1, numItems));
+	}
+
+	for (u32 numThreads : { 1u, 2u, 4u })
+	{
+		MutexQueue mutexQueue;
+		auto pMpmc = std::make_unique<MpmcRingQueue<u64, CAPACITY>>();
+		LOG_INFO("%u producers / %u consumers: mutex %.2f M/s, mpmc %.2f M/s", numThreads, numThreads,
+			Run(mutexQueue, numThreads, numThreads, numItems), Run(*pMpmc, numThreads, numThreads, numItems));
+	}
+}
+
+#endif
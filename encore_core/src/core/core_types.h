@@ -128,6 +128,9 @@ using f64 = double;
 
 #define BIT(b) (1 << (b))
 
+// Keeps data written by different threads on separate lines (false sharing)
+#define CACHE_LINE_SIZE 64
+
 #define NO_COPY(Type)						\
 	Type(const Type&) = delete;				\
 	Type& operator=(const Type&) = delete
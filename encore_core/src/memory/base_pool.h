@@ -206,6 +206,10 @@ public:
 		return m_capacity > 0 ? ((float)(m_capacity - m_freeCount) / (float)m_capacity * 100.0f) : 0.0f;
 	}
 
+	// Raw slot access for splitting [0, GetCapacity()) into ranges, null for free slots
+	T* GetSlot(u32 index) { return index < m_capacity && m_pActive[index] ? &m_pItems[index] : nullptr; }
+	const T* GetSlot(u32 index) const { return index < m_capacity && m_pActive[index] ? &m_pItems[index] : nullptr; }
+
 	// Iterator support
 	class Iterator
 	{
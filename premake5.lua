@@ -236,7 +236,7 @@ project "encore_app"
         }
 
     filter "configurations:Release"
-        defines { "ENC_RELEASE" }
+        defines { "ENC_RELEASE", "PROFILER_ENABLED=0" }
         runtime "Release"
         symbols "off"
         optimize "full"